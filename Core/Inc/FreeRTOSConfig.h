@@ -165,6 +165,10 @@ standard names. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+/* Tickless idle with the application's own vPortSuppressTicksAndSleep (lowPower.c) */
+#define configUSE_TICKLESS_IDLE                  2
+/* Check the stack pattern on every switch; vApplicationStackOverflowHook (freertos.c) freezes the black box */
+#define configCHECK_FOR_STACK_OVERFLOW           2
 /* USER CODE END Defines */
 
 #endif /* FREERTOS_CONFIG_H */
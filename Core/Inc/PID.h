@@ -12,7 +12,7 @@ template <class T>
 class PIDController
 {
 public:
-  PIDController(double p, double i, double d, T (*pidSource)(), void (*pidOutput)(T output));
+  PIDController(float p, float i, float d, T (*pidSource)(), void (*pidOutput)(T output));
   void tick();
   void setTarget(T t);
   T getTarget();
@@ -21,6 +21,7 @@ public:
   T getError();
   void setEnabled(bool e);
   bool isEnabled();
+  void reset();
   T getProportionalComponent();
   T getIntegralComponent();
   T getDerivativeComponent();
@@ -44,20 +45,20 @@ public:
   T getFeedbackWrapLowerBound();
   T getFeedbackWrapUpperBound();
 
-  void setPID(double p, double i, double d);
-  void setP(double p);
-  void setI(double i);
-  void setD(double d);
-  double getP();
-  double getI();
-  double getD();
+  void setPID(float p, float i, float d);
+  void setP(float p);
+  void setI(float i);
+  void setD(float d);
+  float getP();
+  float getI();
+  float getD();
   void setPIDSource(T (*pidSource)());
   void setPIDOutput(void (*pidOutput)(T output));
   void registerTimeFunction(unsigned long (*getSystemTime)());
 private:
-  double _p;
-  double _i;
-  double _d;
+  float _p;
+  float _i;
+  float _d;
   T target;
   T output;
   bool enabled;
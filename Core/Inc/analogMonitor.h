@@ -0,0 +1,53 @@
+/*
+ * analogMonitor.h
+ *
+ * Background battery and temperature monitoring.  ADC1 scans the battery
+ * divider, VREFINT and the internal temperature sensor on every TIM6 update
+ * with 4x hardware oversampling, and DMA stores the results in a circular
+ * buffer.  Each half of the buffer is averaged and low-pass filtered in the
+ * DMA interrupt, which is the only CPU work, and the converted readings are
+ * published as a snapshot that tasks read without locking.
+ *
+ * PA11 and PA12, where the board routes the thermistor and the battery
+ * divider, have no ADC input on the STM32L432.  They stay in analog mode,
+ * the lowest-leakage state, so they do not load either network.  The divider
+ * is wired to PA0 (ADC1_IN5) instead, and the chip's own temperature sensor
+ * stands in for the thermistor.  Every other ADC pin is taken by the servos,
+ * buttons or the VCP.  On the Nucleo-32 the ST-LINK drives its MCO clock onto
+ * PA0, so the MCO solder bridge to PA0 must be opened on boards that read the
+ * battery.
+ */
+
+#ifndef __ANALOGMONITOR_H
+#define __ANALOGMONITOR_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define ANALOG_BATT_CHANNEL 5       //PA0, batt_adc_Pin
+#define ANALOG_BATT_DIVIDER 2       //battery voltage / ADC pin voltage
+#define ANALOG_SCANS_PER_HALF 8     //scans averaged per DMA half-transfer
+#define ANALOG_FILTER_SHIFT 2       //IIR weight of a new block is 1/4
+
+typedef struct {
+  uint16_t battMv;       //battery voltage, millivolts
+  uint16_t vddaMv;       //analog supply computed from VREFINT, millivolts
+  int16_t mcuTempDeciC;  //die temperature, tenths of a degree Celsius
+  uint32_t tick;         //HAL tick of the last update
+  uint32_t updates;      //number of updates published, 0 until the first
+} analog_snapshot_t;
+
+void analogMonitor_init(void);
+void analogMonitor_read(analog_snapshot_t *out);
+void analogMonitor_dmaIrq(void);
+void analogMonitor_suspend(void);
+void analogMonitor_resume(void);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __ANALOGMONITOR_H */
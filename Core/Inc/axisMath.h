@@ -0,0 +1,55 @@
+/*
+ * axisMath.h
+ *
+ * The per-axis arithmetic of the control path, kept free of globals and
+ * hardware so the same code runs in the firmware and in the benchmarks.
+ */
+
+#ifndef __AXISMATH_H
+#define __AXISMATH_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+/**
+ * Maps a 0..turn heading onto the side of the yaw travel the servo is
+ * already on.  Past the hysteresis band around mid, a heading that crossed
+ * the half turn keeps its sign so the controller does not reverse across the
+ * end stop; inside the band it is taken as -turn/2..turn/2.
+ * @param heading The heading in 0..turn.
+ * @param ccr The current yaw pulse width, in timer counts.
+ * @param mid The pulse width of the centre position.
+ * @param hysteresis Counts either side of mid treated as the centre.
+ * @param turn One full turn in heading units.
+ */
+static inline float axis_unwrapYaw(float heading, int ccr, int mid, int hysteresis, float turn) {
+  //rotated clockwise past the band: a small heading is a large positive angle
+  if (ccr > mid + hysteresis && heading < turn / 2) {
+    return heading;
+  }
+  //rotated counter clockwise past the band: a large heading is negative
+  if (ccr < mid - hysteresis && heading > turn / 2) {
+    return heading - turn;
+  }
+  return (heading < turn / 2) ? heading : heading - turn;
+}
+
+/**
+ * Clamps a pulse width to the travel limits of a servo.
+ */
+static inline int axis_clampPulse(int ccr, int low, int high) {
+  if (ccr < low) {
+    return low;
+  }
+  if (ccr > high) {
+    return high;
+  }
+  return ccr;
+}
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __AXISMATH_H */
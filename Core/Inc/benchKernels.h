@@ -0,0 +1,40 @@
+/*
+ * benchKernels.h
+ *
+ * Registry of the small, hot functions of the control path, each wrapped as
+ * a kernel that runs it a given number of times over fixed inputs.  The
+ * kernels touch no hardware, so the same table is timed on a host with
+ * Tools/bench_host.cpp and on the target.
+ *
+ * Inputs come from a fixed-seed generator, so every build sees the same
+ * sequence.  Results are folded into bench_checksum() to keep the compiler
+ * from dropping the work; it also tells two builds apart if they compute
+ * different things.
+ */
+
+#ifndef __BENCHKERNELS_H
+#define __BENCHKERNELS_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define BENCH_INPUTS 64   //input table length, a power of two
+
+typedef struct {
+  const char *name;
+  void (*run)(uint32_t iterations);
+} bench_kernel_t;
+
+void bench_init(void);
+uint8_t bench_count(void);
+const bench_kernel_t *bench_get(uint8_t index);
+uint32_t bench_checksum(void);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __BENCHKERNELS_H */
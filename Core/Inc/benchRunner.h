@@ -0,0 +1,36 @@
+/*
+ * benchRunner.h
+ *
+ * Times the kernels of benchKernels.h on the target with the DWT cycle
+ * counter, at CLOCK_FULL as in STABILIZE, and prints the results over
+ * USART2 as a table:
+ *
+ *   # bench sysclk=80000000 iterations=1000 ramfunc=1
+ *   name,cycles_per_op,checksum
+ *   pid_plain,112.40,5d0c33a1
+ *   ...
+ *   # end
+ *
+ * Each kernel runs BENCH_REPEATS times with interrupts masked and the
+ * fastest run is reported, less the cost of calling the kernel.  The counts
+ * include flash wait states, so compare builds at the same clock and with
+ * the same RAMFUNC_ENABLED.  Tools/bench_compare.py diffs two tables.
+ */
+
+#ifndef __BENCHRUNNER_H
+#define __BENCHRUNNER_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#define BENCH_ITERATIONS 1000
+#define BENCH_REPEATS 5
+
+void benchRunner_run(void);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __BENCHRUNNER_H */
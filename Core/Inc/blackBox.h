@@ -0,0 +1,79 @@
+/*
+ * blackBox.h
+ *
+ * Flight recorder for the control loop.  Every BB_DECIMATION-th control
+ * tick stores one packed sample in a ring buffer in SRAM2; its cycle count
+ * is the longest of the ticks since the previous sample, so an overrun is
+ * never skipped.  The buffer lives in a section the startup code neither
+ * copies nor clears, so after a warm reset the last samples before the
+ * reset are still there.
+ *
+ * SRAM2 is shared with the RAMFUNC code, which limits the buffer to
+ * BB_CAPACITY samples.  At the default 3 ms control period they cover
+ * 280 * 4 * 3 ms = 3.4 s before the freeze, and more while the loop runs
+ * at its idle period.
+ *
+ * Recording stops when the recorder is frozen: on a fault, when the
+ * previous reset was caused by a watchdog, or on request.  A frozen record
+ * is kept across resets until blackbox_rearm() is called.
+ */
+
+#ifndef __BLACKBOX_H
+#define __BLACKBOX_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BB_CAPACITY 280         //samples; 280 * 40 bytes leaves SRAM2 room for RAMFUNC code
+#define BB_DECIMATION 4         //control ticks per sample
+#define BB_ANGLE_SCALE 100.0f   //angles are stored in 1/100 degree
+#define BB_PID_SCALE 10.0f      //PID components are stored in 1/10 CCR count
+
+//Freeze reasons
+#define BB_RUNNING 0
+#define BB_FREEZE_FAULT 1       //the state machine entered FAULT
+#define BB_FREEZE_HARDFAULT 2
+#define BB_FREEZE_WATCHDOG 3    //the last reset came from a watchdog
+#define BB_FREEZE_BUTTON 4
+#define BB_FREEZE_COMMAND 5     //requested over the tuning link
+#define BB_FREEZE_DEADLINE 6    //a task missed its deadline
+#define BB_FREEZE_STACK 7       //a task overflowed its stack
+
+typedef struct __attribute__((packed)) {
+  uint16_t tick;            //HAL tick, low 16 bits
+  uint16_t cycles;          //longest control tick since the last sample, CPU cycles / 16
+  int16_t orientation[3];   //yaw, pitch, roll feedback
+  int16_t target[3];
+  int16_t p[3];             //PID components, yaw, pitch, roll
+  int16_t i[3];
+  int16_t d[3];
+  uint16_t ccr[3];          //CCR1, CCR2, CCR4
+} bb_sample_t;
+
+typedef struct {
+  uint8_t reason;           //BB_RUNNING or a freeze reason
+  uint16_t count;           //valid samples, at most BB_CAPACITY
+  uint32_t written;         //samples written since the recorder was armed
+  uint32_t freezeTick;      //HAL tick when frozen
+  uint8_t bootsFrozen;      //resets survived while frozen
+  uint8_t decimation;       //control ticks per sample
+} bb_info_t;
+
+void blackbox_init(uint32_t resetFlags);
+bool blackbox_due(uint16_t cycles, uint16_t *maxCycles);
+void blackbox_record(const bb_sample_t *sample);
+void blackbox_freeze(uint8_t reason);
+void blackbox_rearm(void);
+void blackbox_getInfo(bb_info_t *out);
+bool blackbox_getSample(uint16_t index, bb_sample_t *out);
+int16_t blackbox_pack(float value, float scale);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __BLACKBOX_H */
@@ -220,10 +220,10 @@ typedef struct {
 } bno055_calibration_data_t;
 
 typedef struct {
-  double w;
-  double x;
-  double y;
-  double z;
+  float w;
+  float x;
+  float y;
+  float z;
 } bno055_vector_t;
 
 typedef struct {
@@ -270,8 +270,8 @@ enum bno055_axis_map_sign_t {
   BNO055_AXIS_SIGN_NEGATIVE = 0x01
 };
 
-void bno055_writeData(uint8_t reg, uint8_t data);
-void bno055_readData(uint8_t reg, uint8_t *data, uint8_t len);
+bool bno055_writeData(uint8_t reg, uint8_t data);
+bool bno055_readData(uint8_t reg, uint8_t *data, uint8_t len);
 void bno055_delay(int time);
 
 void bno055_reset();
@@ -301,6 +301,7 @@ bno055_vector_t bno055_getVectorEuler();
 bno055_vector_t bno055_getVectorLinearAccel();
 bno055_vector_t bno055_getVectorGravity();
 bno055_vector_t bno055_getVectorQuaternion();
+bno055_vector_t bno055_decodeVector(uint8_t vec, const uint8_t *buffer);
 void bno055_setAxisMap(bno055_axis_map_t axis);
 
 #ifdef __cplusplus
@@ -0,0 +1,23 @@
+/*
+ * bno055Imu.h
+ *
+ * ImuSource backend for the BNO055 on I2C, in NDOF fusion mode.
+ */
+
+#ifndef INC_BNO055IMU_H_
+#define INC_BNO055IMU_H_
+
+#include "stm32l4xx_hal.h"
+#include "imuSource.h"
+
+class Bno055Imu : public ImuSource<Bno055Imu>
+{
+public:
+  explicit Bno055Imu(I2C_HandleTypeDef *i2c);
+  bool begin();
+  bool read(uint32_t nowMs, bno055_vector_t *out);
+private:
+  I2C_HandleTypeDef *i2c;
+};
+
+#endif /* INC_BNO055IMU_H_ */
@@ -0,0 +1,55 @@
+/*
+ * clockGovernor.h
+ *
+ * Switches SYSCLK between operating points and re-times every peripheral
+ * whose settings depend on it: the FreeRTOS SysTick, the HAL time base,
+ * TIM2 (servo PWM), I2C1 (IMU) and USART2.  Servo pulse widths in TIM2 counts
+ * are only preserved at CLOCK_NORMAL and CLOCK_FULL; at CLOCK_LOW the timer
+ * cannot reach its 8 MHz count rate, so only the frame period is kept and the
+ * servos are expected to be off.
+ */
+
+#ifndef __CLOCKGOVERNOR_H
+#define __CLOCKGOVERNOR_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "stm32l4xx_hal.h"
+
+enum {
+  CLOCK_LOW,      //MSI 4 MHz, voltage range 2
+  CLOCK_NORMAL,   //PLL 32 MHz, the reset configuration
+  CLOCK_FULL,     //PLL 80 MHz, voltage range 1
+  CLOCK_NUM_PROFILES
+};
+
+#define CLOCK_TIM2_COUNT_HZ 8000000UL
+#define CLOCK_IDLE_WAIT_MS 20   //longest wait for I2C1/USART2 to finish a transfer
+#define CLOCK_RETRY_MS 10       //period of clock_retry() while a switch is deferred
+
+typedef struct {
+  uint32_t switches;
+  uint32_t failedSwitches;
+  uint32_t deferredSwitches;  //a transfer was still running after CLOCK_IDLE_WAIT_MS
+  uint32_t lastSwitchUs;
+  uint32_t maxSwitchUs;
+  uint32_t residencyMs[CLOCK_NUM_PROFILES];
+  uint64_t mhzMs;         //integral of SYSCLK over time, a proxy for run current
+} clock_stats_t;
+
+void clock_init(I2C_HandleTypeDef *i2c, TIM_HandleTypeDef *pwm, UART_HandleTypeDef *uart);
+bool clock_setProfile(uint8_t profile);
+uint8_t clock_profile(void);
+bool clock_pending(void);
+bool clock_retry(void);
+void clock_getStats(clock_stats_t *out);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __CLOCKGOVERNOR_H */
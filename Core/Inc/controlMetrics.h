@@ -0,0 +1,74 @@
+/*
+ * controlMetrics.h
+ *
+ * Control quality of one axis, accumulated from the target, feedback and
+ * pulse width of every control tick.  The same code measures a live
+ * STABILIZE session on the target and the scenarios of Tools/control_sim.cpp,
+ * so both report the same numbers:
+ *
+ *   settle time   from ctrlMetrics_start() until the error last entered the
+ *                 settle band, or CTRL_NEVER_SETTLED
+ *   overshoot     the largest excursion past the target, on the far side
+ *                 from where the feedback started
+ *   steady error  mean absolute error since settling
+ *   jitter        RMS deviation of the error from its mean since settling
+ *   travel        total pulse width movement, in timer counts
+ *
+ * An axis that is outside the band at the end reports the steady error and
+ * jitter of the whole run instead.  The whole-run values are also reported
+ * on their own, for runs under a continuous disturbance where settling has
+ * no meaning.
+ */
+
+#ifndef __CONTROLMETRICS_H
+#define __CONTROLMETRICS_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CTRL_SETTLE_BAND_DEG 1.0f
+#define CTRL_NEVER_SETTLED UINT32_MAX
+
+typedef struct {
+  uint32_t count;
+  float sum;          //signed error
+  float sumAbs;
+  float sumSq;
+} ctrl_error_sums_t;
+
+typedef struct {
+  uint32_t startMs;
+  uint32_t settledAtMs;
+  bool started;
+  bool settled;
+  float startError;
+  float overshoot;
+  int lastCcr;
+  uint32_t travel;
+  ctrl_error_sums_t all;
+  ctrl_error_sums_t tail;   //since the error last entered the band
+} ctrl_metrics_t;
+
+typedef struct {
+  uint32_t settleMs;
+  float overshootDeg;
+  float steadyErrorDeg;
+  float jitterDeg;
+  float runErrorDeg;      //mean absolute error of the whole run
+  float runJitterDeg;     //RMS deviation of the error over the whole run
+  uint32_t travelCounts;
+} ctrl_metrics_report_t;
+
+void ctrlMetrics_start(ctrl_metrics_t *m, uint32_t nowMs);
+void ctrlMetrics_update(ctrl_metrics_t *m, uint32_t nowMs, float target, float feedback, int ccr);
+void ctrlMetrics_report(const ctrl_metrics_t *m, ctrl_metrics_report_t *out);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __CONTROLMETRICS_H */
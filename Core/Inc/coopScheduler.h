@@ -0,0 +1,96 @@
+/*
+ * coopScheduler.h
+ *
+ * Stackless cooperative routines (protothreads) that all share the stack of a
+ * single RTOS task.  A routine is a plain function taking a coop_ctx_t that
+ * uses the COOP_* macros to suspend itself; execution resumes at the same
+ * point the next time the scheduler calls it.
+ *
+ * Because routines share one stack, local variables do NOT survive a
+ * COOP_YIELD/COOP_DELAY/COOP_WAIT_UNTIL.  Keep state in statics or globals,
+ * and never call blocking RTOS functions from inside a routine.
+ */
+
+#ifndef __COOPSCHEDULER_H
+#define __COOPSCHEDULER_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define COOP_MAX_ROUTINES 8
+#define COOP_POLL_TICKS   10   //re-check period of COOP_WAIT_UNTIL conditions
+#define COOP_NOTIFY_FLAG  0x01
+
+#define COOP_WAITING 0
+#define COOP_ENDED   1
+
+typedef struct {
+  uint16_t lc;        //resume point (source line of the last suspension)
+  uint32_t timer;     //deadline of the current COOP_DELAY
+  uint32_t wakeTick;  //tick at which the scheduler should run the routine again
+} coop_ctx_t;
+
+typedef uint8_t (*coop_routine_t)(coop_ctx_t *ctx);
+
+uint32_t coop_now(void);
+
+#define COOP_BEGIN(ctx) switch ((ctx)->lc) { case 0:
+
+#define COOP_END(ctx) } (ctx)->lc = 0; return COOP_ENDED
+
+#define COOP_WAIT_UNTIL(ctx, cond)                                             \
+  do {                                                                         \
+    (ctx)->lc = __LINE__; case __LINE__:                                       \
+    if (!(cond)) {                                                             \
+      (ctx)->wakeTick = coop_now() + COOP_POLL_TICKS;                          \
+      return COOP_WAITING;                                                     \
+    }                                                                          \
+  } while (0)
+
+#define COOP_DELAY(ctx, ticks)                                                 \
+  do {                                                                         \
+    (ctx)->timer = coop_now() + (ticks);                                       \
+    (ctx)->lc = __LINE__; case __LINE__:                                       \
+    if ((int32_t)(coop_now() - (ctx)->timer) < 0) {                            \
+      (ctx)->wakeTick = (ctx)->timer;                                          \
+      return COOP_WAITING;                                                     \
+    }                                                                          \
+  } while (0)
+
+/*
+ * Waits until cond holds or ticks have passed.  Unlike COOP_WAIT_UNTIL, cond
+ * is not polled: it is re-checked only when someone calls coop_notify(), so
+ * the scheduler can sleep for the whole timeout.
+ */
+#define COOP_WAIT_NOTIFIED(ctx, cond, ticks)                                   \
+  do {                                                                         \
+    (ctx)->timer = coop_now() + (ticks);                                       \
+    (ctx)->lc = __LINE__; case __LINE__:                                       \
+    if (!(cond) && (int32_t)(coop_now() - (ctx)->timer) < 0) {                 \
+      (ctx)->wakeTick = (ctx)->timer;                                          \
+      return COOP_WAITING;                                                     \
+    }                                                                          \
+  } while (0)
+
+#define COOP_YIELD(ctx)                                                        \
+  do {                                                                         \
+    (ctx)->wakeTick = coop_now();                                              \
+    (ctx)->lc = __LINE__; return COOP_WAITING; case __LINE__:;                 \
+  } while (0)
+
+void coop_register(uint8_t id, coop_routine_t routine, void (*onStop)(void));
+void coop_start(uint8_t id);
+void coop_stop(uint8_t id);
+bool coop_isRunning(uint8_t id);
+void coop_notify(void);
+void coop_run(void);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __COOPSCHEDULER_H */
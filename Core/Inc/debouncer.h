@@ -0,0 +1,32 @@
+/*
+ * debouncer.h
+ *
+ * Timer-sampled debouncer for all gimbal buttons.  The pins are polled from
+ * the 1 kHz time base and filtered bit-parallel with a two-bit vertical
+ * counter, so every button is debounced by the same handful of logic
+ * operations.  Clean press, release, long-press and repeat events are
+ * queued to the input task through the input event ring.
+ */
+
+#ifndef __DEBOUNCER_H
+#define __DEBOUNCER_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define DEBOUNCE_SAMPLE_MS 2     //a level must hold for 4 samples to be accepted
+#define LONG_PRESS_MS 800
+#define REPEAT_MS 150
+
+void debouncer_init(void);
+void debouncer_sample(void);
+uint8_t debouncer_pressed(void);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __DEBOUNCER_H */
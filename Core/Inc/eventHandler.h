@@ -3,11 +3,22 @@
 #define __EVENTHANDLER_H
 
 #include "cmsis_os.h"
+#include "gimbalStates.h"
 
-void setpointButtons();
-void modeChangeButton();
+#ifdef __cplusplus
+  extern "C" {
+#endif
 
-osEventFlagsId_t setPointButtonEvents;
-osEventFlagsId_t stateMachineEvents;
+#define STATE_EVENT_QUEUE_LEN 8
+#define INPUT_EVENT_FLAG 0x50
+
+void postStateEvent(uint8_t event);
+
+extern osEventFlagsId_t setPointButtonEvents;
+extern osMessageQueueId_t stateEventQueue;
+
+#ifdef __cplusplus
+  }
+#endif
 
 #endif /* __EVENTHANDLER_H*/
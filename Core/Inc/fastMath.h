@@ -0,0 +1,164 @@
+/*
+ * fastMath.h
+ *
+ * Single-precision replacements for the libm functions used on attitude
+ * data, for the Cortex-M4F: everything is float arithmetic the FPU does in
+ * hardware, with no calls, no double and no errno handling.  Each function
+ * states its largest absolute error over its input range; the bounds are
+ * checked by Tools/fastmath_accuracy.cpp and the speed against newlib by
+ * the fast_* and *_libm kernels of benchKernels.h.
+ *
+ * Angles are in radians unless the name says degrees.
+ */
+
+#ifndef __FASTMATH_H
+#define __FASTMATH_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define FAST_PI 3.14159265f
+#define FAST_HALF_PI 1.57079633f
+#define FAST_TWO_PI 6.28318531f
+#define FAST_RAD_TO_DEG 57.2957795f
+
+//Largest absolute errors, radians (the sqrt functions are relative).
+#define FAST_ATAN2_MAX_ERR 1.5e-5f
+#define FAST_ASIN_MAX_ERR 3.0e-5f
+#define FAST_SIN_MAX_ERR 5.0e-7f
+#define FAST_INV_SQRT_MAX_REL_ERR 2.0e-7f
+
+/**
+ * Square root with the VSQRT instruction.  Unlike sqrtf() it never sets
+ * errno, so it has no slow path; negative inputs give NaN.
+ */
+static inline float fast_sqrtf(float x) {
+#if defined(__ARM_FP) && !defined(__SOFTFP__)
+  float r;
+  __asm__ ("vsqrt.f32 %0, %1" : "=t" (r) : "t" (x));
+  return r;
+#else
+  return __builtin_sqrtf(x);
+#endif
+}
+
+/**
+ * 1/sqrt(x) as VSQRT then VDIV, about 28 cycles and correct to a couple of
+ * ulps.  On an M4F this beats the integer bit trick, which needs Newton
+ * steps to get close.
+ */
+static inline float fast_invSqrtf(float x) {
+  return 1.0f / fast_sqrtf(x);
+}
+
+/**
+ * Largest integer not greater than x, for |x| < 2^31.  A compare and an
+ * IT block rather than the floorf() call.
+ */
+static inline float fast_floorf(float x) {
+  float t = (float)(int32_t)x;
+  return t - (t > x ? 1.0f : 0.0f);
+}
+
+/**
+ * Wraps an angle in degrees to [-180, 180).
+ */
+static inline float fast_wrap180(float deg) {
+  return deg - 360.0f * fast_floorf((deg + 180.0f) * (1.0f / 360.0f));
+}
+
+/**
+ * Wraps an angle in degrees to [0, 360).
+ */
+static inline float fast_wrap360(float deg) {
+  return deg - 360.0f * fast_floorf(deg * (1.0f / 360.0f));
+}
+
+/**
+ * atan(x) for |x| <= 1, degree 9 minimax polynomial (Hastings).
+ */
+static inline float fast_atanUnit(float x) {
+  float x2 = x * x;
+  return x * (0.99986600f + x2 * (-0.33029950f + x2 * (0.18014100f
+           + x2 * (-0.08513300f + x2 * 0.02083510f))));
+}
+
+/**
+ * atan2(y, x) in (-pi, pi], within FAST_ATAN2_MAX_ERR.  atan2(0, 0) is 0.
+ */
+static inline float fast_atan2f(float y, float x) {
+  float ax = __builtin_fabsf(x);
+  float ay = __builtin_fabsf(y);
+  float big = (ax > ay) ? ax : ay;
+  float small = (ax > ay) ? ay : ax;
+  if (big == 0.0f) {
+    return 0.0f;
+  }
+  float a = fast_atanUnit(small / big);
+  a = (ay > ax) ? FAST_HALF_PI - a : a;
+  a = (x < 0.0f) ? FAST_PI - a : a;
+  return __builtin_copysignf(a, y);
+}
+
+/**
+ * asin(x) for |x| <= 1, within FAST_ASIN_MAX_ERR; larger inputs are clamped.
+ */
+static inline float fast_asinf(float x) {
+  x = (x > 1.0f) ? 1.0f : (x < -1.0f) ? -1.0f : x;
+  return fast_atan2f(x, fast_sqrtf(1.0f - x * x));
+}
+
+/**
+ * sin(x) within FAST_SIN_MAX_ERR for |x| <= 4 pi; the error grows slowly
+ * beyond.  Reduced to [-pi, pi) in two steps (Cody-Waite), folded to
+ * [-pi/2, pi/2] and evaluated with the degree 11 Taylor polynomial, whose
+ * truncation error there is below 6e-8.
+ */
+static inline float fast_sinf(float x) {
+  float k = fast_floorf(x * (1.0f / FAST_TWO_PI) + 0.5f);
+  x = (x - k * 6.28125f) - k * 1.9353072e-3f;   //6.28125 is exact in float
+  float folded = __builtin_copysignf(FAST_PI, x) - x;
+  x = (__builtin_fabsf(x) > FAST_HALF_PI) ? folded : x;
+  float x2 = x * x;
+  return x * (1.0f + x2 * (-1.6666667e-1f + x2 * (8.3333333e-3f + x2 * (-1.9841270e-4f
+           + x2 * (2.7557319e-6f + x2 * -2.5052108e-8f)))));
+}
+
+static inline float fast_cosf(float x) {
+  return fast_sinf(x + FAST_HALF_PI);
+}
+
+/**
+ * Hamilton product a * b of quaternions stored w, x, y, z: the rotation b
+ * followed by a.  out may alias neither input.
+ */
+static inline void fast_quatMultiply(const float *a, const float *b, float *out) {
+  out[0] = a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3];
+  out[1] = a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2];
+  out[2] = a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1];
+  out[3] = a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0];
+}
+
+/**
+ * Unit quaternion (w, x, y, z) to yaw, pitch and roll in degrees, Z-Y-X
+ * order.  Pitch is clamped to +-90 at the singularity.
+ * @param q The quaternion.
+ * @param euler Receives yaw, pitch, roll.
+ */
+static inline void fast_quatToEuler(const float *q, float *euler) {
+  float sinp = 2.0f * (q[0] * q[2] - q[3] * q[1]);
+  euler[0] = FAST_RAD_TO_DEG * fast_atan2f(2.0f * (q[0] * q[3] + q[1] * q[2]),
+                                           1.0f - 2.0f * (q[2] * q[2] + q[3] * q[3]));
+  euler[1] = FAST_RAD_TO_DEG * fast_asinf(sinp);
+  euler[2] = FAST_RAD_TO_DEG * fast_atan2f(2.0f * (q[0] * q[1] + q[2] * q[3]),
+                                           1.0f - 2.0f * (q[1] * q[1] + q[2] * q[2]));
+}
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __FASTMATH_H */
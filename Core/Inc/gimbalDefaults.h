@@ -0,0 +1,41 @@
+/*
+ * gimbalDefaults.h
+ *
+ * Gains, servo limits and task periods the gimbal starts from, before the
+ * parameter store overrides them (see gimbalParams.h).  The host control
+ * simulation, Tools/control_sim.cpp, includes this header too, so it always
+ * runs what the firmware ships with.
+ *
+ * Pulse widths are TIM2 counts at 8 MHz; periods are ms.
+ */
+
+#ifndef __GIMBALDEFAULTS_H
+#define __GIMBALDEFAULTS_H
+
+#define PWM_HIGH 20315.85f
+#define PWM_LOW 6500
+#define PWM_MID 12000
+#define PWM_HIGH_Y 18000
+#define PWM_LOW_Y 8000
+#define PWM_HYSTERESIS 3000       //yaw pulse band around mid where the heading is not unwrapped
+#define SERVO_DEG_PER_COUNT (180.0f / (PWM_HIGH - PWM_LOW))   //full pulse range is half a turn
+#define ROTATIONOFFSET 360        //heading units in a turn
+
+#define KP_y 2.3f
+#define KI_y 0.0005f
+#define KD_y 0.008f
+#define KP_p 3.1f
+#define KI_p 0.0005f
+#define KD_p 0.008f
+#define KP_r 3.1f
+#define KI_r 0.0005f
+#define KD_r 0.008f
+
+#define CONTROL_FREQ 3
+#define IMU_FREQ 3
+#define UNIQUE_FREQ 10            //cinematic yaw sweep step
+#define STABILIZE_PITCH_OFFSET 1500   //enterSTABILIZE() starts pitch this far below mid
+#define CINEMATIC_PITCH_OFFSET -1500
+#define CINEMATIC_ROLL_OFFSET 1300
+
+#endif /* __GIMBALDEFAULTS_H */
@@ -0,0 +1,59 @@
+/*
+ * gimbalParams.h
+ *
+ * Keys of the tunable gimbal settings kept in the parameter store.  Their
+ * defaults are in gimbalDefaults.h.  Keys are stored in flash, so only
+ * append new ones at the end.
+ *
+ * Every key has a range of accepted values.  Values read back from flash are
+ * checked against it at boot, as are values sent over the tuning link, so a
+ * corrupted or mistyped setting cannot stall a task or drive a servo past
+ * its stops.
+ */
+
+#ifndef __GIMBALPARAMS_H
+#define __GIMBALPARAMS_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PARAM_GAIN_MAX 100.0f
+#define PARAM_PULSE_MIN 4000      //TIM2 counts at 8 MHz, 0.5 ms
+#define PARAM_PULSE_MAX 24000     //3 ms
+#define PARAM_PERIOD_MAX 1000     //ms
+#define PARAM_OFFSET_MAX 8000     //TIM2 counts either side of PWM_MID
+
+enum {
+  PARAM_KP_YAW,             //float
+  PARAM_KI_YAW,             //float
+  PARAM_KD_YAW,             //float
+  PARAM_KP_PITCH,           //float
+  PARAM_KI_PITCH,           //float
+  PARAM_KD_PITCH,           //float
+  PARAM_KP_ROLL,            //float
+  PARAM_KI_ROLL,            //float
+  PARAM_KD_ROLL,            //float
+  PARAM_PWM_LOW,            //TIM2 counts, pitch and roll
+  PARAM_PWM_HIGH,
+  PARAM_PWM_LOW_YAW,
+  PARAM_PWM_HIGH_YAW,
+  PARAM_CONTROL_PERIOD,     //ms
+  PARAM_IMU_PERIOD,         //ms
+  PARAM_CINEMATIC_PERIOD,   //ms between yaw sweep steps
+  PARAM_CINEMATIC_PITCH,    //TIM2 counts, signed offset from PWM_MID
+  PARAM_CINEMATIC_ROLL,     //TIM2 counts, signed offset from PWM_MID
+  PARAM_COUNT
+};
+
+bool gimbalParams_inRange(uint8_t key, uint32_t value);
+uint8_t gimbalParams_sanitize(const uint32_t *defaults);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __GIMBALPARAMS_H */
@@ -0,0 +1,61 @@
+/*
+ * gimbalStates.h
+ *
+ * States, events and transition table of the gimbal state machine.  The
+ * tables only name the entry, exit, guard and transition actions; main.cpp
+ * defines them, and Tools/state_machine_host.cpp replaces them with
+ * recording stubs to check the table on a host.
+ */
+
+#ifndef __GIMBALSTATES_H
+#define __GIMBALSTATES_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include "stateMachine.h"
+
+/* States of the gimbal state machine */
+enum {
+  GIMBAL_OFF,
+  GIMBAL_ACTIVE,      //parent of every state that powers the servos
+  GIMBAL_BOOTING,
+  GIMBAL_STABILIZE,
+  GIMBAL_CINEMATIC,
+  GIMBAL_FAULT,
+  GIMBAL_NUM_STATES
+};
+
+/* Events delivered to the gimbal state machine */
+enum {
+  EV_MODE_BUTTON,
+  EV_LOW_BATTERY,
+  EV_IMU_FAULT,
+  EV_CALIBRATION_DONE,
+  EV_DEADLINE_MISS,
+  EV_NUM_EVENTS
+};
+
+void enterOFF(void);
+void enterACTIVE(void);
+void exitACTIVE(void);
+void enterBOOTING(void);
+void exitBOOTING(void);
+void enterSTABILIZE(void);
+void exitSTABILIZE(void);
+void enterCINEMATIC(void);
+void exitCINEMATIC(void);
+void enterFAULT(void);
+bool modeChangeAllowed(void);
+void markModeChange(void);
+
+extern const sm_state_t gimbalStates[GIMBAL_NUM_STATES];
+extern const sm_transition_t gimbalTransitions[GIMBAL_NUM_STATES][EV_NUM_EVENTS];
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __GIMBALSTATES_H */
@@ -0,0 +1,79 @@
+/*
+ * i2cBus.h
+ *
+ * I2C master transport with error recovery.  Every transfer is classified;
+ * a bus or timeout error is followed by a bus clear (up to nine SCL pulses
+ * and a STOP, bit-banged on the pins) and a re-init of the peripheral
+ * before the transfer is retried.
+ *
+ * Retries are drawn from a budget that is refilled by i2cbus_newCycle() at
+ * the start of each cycle of the calling task.  Once a cycle has used up
+ * its budget, further transfers in that cycle fail at once without touching
+ * the bus, so a broken bus costs a bounded amount of time per cycle.
+ *
+ * Register reads are one combined transaction with a repeated START.  The
+ * bit times every attempt occupies the bus are counted from a model of the
+ * transaction framing (START, 9 bits per byte with ACK, repeated START,
+ * STOP), not measured.
+ */
+
+#ifndef __I2CBUS_H
+#define __I2CBUS_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "stm32l4xx_hal.h"
+
+#define I2CBUS_TIMEOUT_MS 5       //per HAL call; 22 bytes take about 2.5 ms at 100 kHz
+#define I2CBUS_RETRY_BUDGET 2     //retries per cycle, including the recoveries
+#define I2CBUS_SCL_PORT GPIOA
+#define I2CBUS_SCL_PIN GPIO_PIN_9
+#define I2CBUS_SDA_PORT GPIOA
+#define I2CBUS_SDA_PIN GPIO_PIN_10
+#define I2CBUS_CLEAR_PULSES 9
+#define I2CBUS_HALF_BIT_US 5      //bit-banged clock of 100 kHz
+#define I2CBUS_BUS_HZ 100000      //standard mode, as set up by the clock governor
+
+typedef enum {
+  I2CBUS_OK,
+  I2CBUS_NACK,        //the device did not acknowledge; retried without recovery
+  I2CBUS_BUS_ERROR,   //misplaced START/STOP or lost arbitration
+  I2CBUS_TIMEOUT,
+  I2CBUS_BUSY,        //the peripheral still saw the bus busy
+  I2CBUS_SKIPPED      //not attempted, the cycle's retry budget is used up
+} i2cbus_result_t;
+
+typedef struct {
+  uint32_t transfers;
+  uint32_t failures;        //transfers that failed after all retries
+  uint32_t nacks;
+  uint32_t busErrors;
+  uint32_t timeouts;
+  uint32_t busy;
+  uint32_t retries;
+  uint32_t busClears;       //recoveries that found SDA held low
+  uint32_t stuckBus;        //recoveries that could not release the bus
+  uint32_t reinits;
+  uint32_t budgetExhausted; //cycles that used up their retry budget
+  uint32_t skipped;
+  uint32_t busBits;         //modelled bus time of all attempts, in SCL periods
+} i2cbus_stats_t;
+
+void i2cbus_init(I2C_HandleTypeDef *hi2c);
+void i2cbus_newCycle(void);
+bool i2cbus_cycleOk(void);
+i2cbus_result_t i2cbus_write(uint8_t addr, const uint8_t *data, uint16_t len);
+i2cbus_result_t i2cbus_writeRead(uint8_t addr, uint8_t reg, uint8_t *data, uint16_t len);
+void i2cbus_getStats(i2cbus_stats_t *out);
+uint32_t i2cbus_writeBits(uint16_t len);
+uint32_t i2cbus_writeReadBits(uint16_t len);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __I2CBUS_H */
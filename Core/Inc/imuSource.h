@@ -0,0 +1,90 @@
+/*
+ * imuSource.h
+ *
+ * Orientation sources for the IMU task.  ImuSource is a static interface:
+ * a backend derives from ImuSource<Backend> and provides
+ *
+ *   bool begin();                                   //bring the source up
+ *   bool read(uint32_t nowMs, bno055_vector_t *out); //Euler angles, degrees
+ *
+ * and code that consumes orientation takes an ImuSource<Backend>&, so the
+ * backend is picked at compile time and every call is resolved statically.
+ * read() returns false if no fresh sample could be had; *out is then
+ * unchanged.
+ *
+ * The hardware backend, Bno055Imu, is in bno055Imu.h.  SyntheticImu and
+ * ReplayImu need nothing but this header and imuSource.cpp, so the control
+ * pipeline can be driven on a host at the real input rate.
+ */
+
+#ifndef INC_IMUSOURCE_H_
+#define INC_IMUSOURCE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bno055.h"
+
+template <class Backend>
+class ImuSource
+{
+public:
+  bool begin() { return self().begin(); }
+  bool read(uint32_t nowMs, bno055_vector_t *out) { return self().read(nowMs, out); }
+private:
+  Backend &self() { return *static_cast<Backend *>(this); }
+};
+
+/*
+ * Sinusoidal motion on each Euler axis around a fixed attitude, with
+ * optional noise.  Axes are in the BNO055's order: x heading, y, z.
+ */
+class SyntheticImu : public ImuSource<SyntheticImu>
+{
+public:
+  struct Axis {
+    float center;       //degrees
+    float amplitude;    //degrees
+    float periodMs;
+  };
+  SyntheticImu(Axis x, Axis y, Axis z, float noiseDeg);
+  bool begin();
+  bool read(uint32_t nowMs, bno055_vector_t *out);
+private:
+  float noise();
+  Axis axes[3];
+  float noiseDeg;
+  uint32_t seed;
+  uint32_t startMs;
+  bool started;
+};
+
+//One recorded set of Euler angles as the BNO055 reports them, tMs after the start.
+typedef struct {
+  uint32_t tMs;
+  float x;
+  float y;
+  float z;
+} imu_replay_sample_t;
+
+/*
+ * Plays back a recording at its original timing, e.g. one converted from a
+ * flight recorder dump with Tools/imu_replay_header.py.  Each read returns
+ * the latest sample that is due, so the recording may be sparser than the
+ * read rate.
+ */
+class ReplayImu : public ImuSource<ReplayImu>
+{
+public:
+  ReplayImu(const imu_replay_sample_t *samples, size_t count, bool loop);
+  bool begin();
+  bool read(uint32_t nowMs, bno055_vector_t *out);
+private:
+  const imu_replay_sample_t *samples;
+  size_t count;
+  size_t next;
+  bool loop;
+  uint32_t startMs;
+  bool started;
+};
+
+#endif /* INC_IMUSOURCE_H_ */
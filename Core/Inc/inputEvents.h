@@ -0,0 +1,65 @@
+/*
+ * inputEvents.h
+ *
+ * Lock-free single-producer/single-consumer ring of timestamped button
+ * events.  The producer is the debouncer in the time base interrupt and the
+ * consumer is the input task.
+ */
+
+#ifndef __INPUTEVENTS_H
+#define __INPUTEVENTS_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define INPUT_QUEUE_LEN 16   //must be a power of two
+
+/* Button identities */
+enum {
+  BUTTON_MODE,
+  BUTTON_UP,
+  BUTTON_DOWN,
+  BUTTON_LEFT,
+  BUTTON_RIGHT,
+  BUTTON_CAPTURE,
+  NUM_BUTTONS
+};
+
+/* Edge kinds */
+enum {
+  EDGE_PRESS,
+  EDGE_RELEASE,
+  EDGE_LONG_PRESS,
+  EDGE_REPEAT
+};
+
+typedef struct {
+  uint8_t button;
+  uint8_t edge;
+  uint32_t stamp;   //DWT cycle count when the event was generated
+} input_event_t;
+
+typedef struct {
+  uint32_t count;
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint32_t totalUs;
+} input_latency_t;
+
+extern volatile uint32_t inputEventsDropped;
+extern input_latency_t inputLatency[NUM_BUTTONS];
+
+void inputEvents_init(void);
+bool inputEvents_push(uint8_t button, uint8_t edge);
+bool inputEvents_pop(input_event_t *ev);
+void inputEvents_recordLatency(const input_event_t *ev);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __INPUTEVENTS_H */
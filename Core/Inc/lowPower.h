@@ -0,0 +1,63 @@
+/*
+ * lowPower.h
+ *
+ * FreeRTOS tickless idle with STOP2.  When STOP is allowed and every task is
+ * blocked, the idle task stops the RTOS and HAL ticks and enters STOP2 with
+ * LPTIM1, clocked from the LSE, set to wake it at the next RTOS deadline.
+ * The on/off button (PA4) is armed as an EXTI wake source for the duration
+ * of the stop.  Otherwise the idle task only sleeps until the next interrupt.
+ *
+ * USART2 is not clocked in STOP2, so STOP is held off during a tuning link
+ * session.  To let a session start on a stopped gimbal, the USART2 RX pin
+ * (PA15) is armed as a wake source too: the first frame is lost, but the
+ * wake holds off STOP for LOWPOWER_RX_WAKE_MS, long enough for the host to
+ * resend it.
+ *
+ * A wake by the button holds off STOP for LOWPOWER_BUTTON_WAKE_MS, and then
+ * for as long as the debouncer sees the button held: the debouncer samples
+ * on the HAL time base, which does not run in STOP2.
+ *
+ * STOP is only entered at CLOCK_LOW, where SYSCLK is the MSI that the chip
+ * wakes up on, so no clock restore is needed.
+ */
+
+#ifndef __LOWPOWER_H
+#define __LOWPOWER_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "debouncer.h"
+
+#define LOWPOWER_LSE_HZ 32768
+#define LOWPOWER_MAX_STOP_TICKS 1900   //the 16-bit LPTIM wraps after 2 s
+#define LOWPOWER_RX_WAKE_MS 2000
+#define LOWPOWER_BUTTON_WAKE_MS (5 * DEBOUNCE_SAMPLE_MS)   //four debounce samples and the divider's phase
+
+typedef struct {
+  uint32_t stopEntries;
+  uint32_t stopMs;              //total time spent in STOP2
+  uint32_t buttonWakes;
+  uint32_t rxWakes;
+  uint32_t lastRestoreUs;       //from wake-up until tasks can run again
+  uint32_t maxRestoreUs;
+  uint32_t lastWakeToActiveMs;  //from a button wake until the servos power up
+  uint32_t maxWakeToActiveMs;
+} lowpower_stats_t;
+
+void lowPower_init(void);
+void lowPower_allowStop(bool allow);
+void lowPower_markActive(void);
+void lowPower_getStats(lowpower_stats_t *out);
+void lowPower_lptimIrq(void);
+void lowPower_extiIrq(void);
+void lowPower_rxWakeIrq(void);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __LOWPOWER_H */
@@ -59,28 +59,22 @@ void Error_Handler(void);
 /* USER CODE END EFP */
 
 /* Private defines -----------------------------------------------------------*/
-#define MCO_Pin GPIO_PIN_0
-#define MCO_GPIO_Port GPIOA
+#define batt_adc_Pin GPIO_PIN_0
+#define batt_adc_GPIO_Port GPIOA
 #define VCP_TX_Pin GPIO_PIN_2
 #define VCP_TX_GPIO_Port GPIOA
 #define on_off_mode_Pin GPIO_PIN_4
 #define on_off_mode_GPIO_Port GPIOA
-#define on_off_mode_EXTI_IRQn EXTI4_IRQn
 #define button_down_Pin GPIO_PIN_6
 #define button_down_GPIO_Port GPIOA
-#define button_down_EXTI_IRQn EXTI9_5_IRQn
 #define button_up_Pin GPIO_PIN_7
 #define button_up_GPIO_Port GPIOA
-#define button_up_EXTI_IRQn EXTI9_5_IRQn
 #define button_right_Pin GPIO_PIN_0
 #define button_right_GPIO_Port GPIOB
-#define button_right_EXTI_IRQn EXTI0_IRQn
 #define button_left_Pin GPIO_PIN_1
 #define button_left_GPIO_Port GPIOB
-#define button_left_EXTI_IRQn EXTI1_IRQn
 #define button_capture_Pin GPIO_PIN_8
 #define button_capture_GPIO_Port GPIOA
-#define button_capture_EXTI_IRQn EXTI9_5_IRQn
 #define temperature_Pin GPIO_PIN_11
 #define temperature_GPIO_Port GPIOA
 #define batt_voltage_Pin GPIO_PIN_12
@@ -0,0 +1,32 @@
+/*
+ * motionProfile.h
+ *
+ * Rate- and acceleration-limited setpoint generator for one axis.  The
+ * caller commands a velocity every control tick and the profile moves its
+ * position towards it, so setpoints change smoothly instead of in steps.
+ */
+
+#ifndef __MOTIONPROFILE_H
+#define __MOTIONPROFILE_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+typedef struct {
+  float position;     //current profiled setpoint, degrees
+  float velocity;     //degrees per second
+  float maxVelocity;  //degrees per second
+  float maxAccel;     //degrees per second squared
+} motion_profile_t;
+
+void motionProfile_init(motion_profile_t *mp, float position, float maxVelocity, float maxAccel);
+void motionProfile_reset(motion_profile_t *mp, float position);
+float motionProfile_stepVelocity(motion_profile_t *mp, float command, float dt);
+float motionProfile_clamp(motion_profile_t *mp, float low, float high);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __MOTIONPROFILE_H */
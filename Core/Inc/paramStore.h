@@ -0,0 +1,50 @@
+/*
+ * paramStore.h
+ *
+ * Persistent 32-bit parameters in the last flash pages (the PARAMS region of
+ * the linker script).  Writes are appended as 8-byte records, each with a
+ * CRC, to the one active page; when it fills up the latest values are
+ * compacted into the next page and the old one is erased, so erases rotate
+ * over all pages.  All values live in a RAM table, so reads are a plain
+ * array lookup and only params_set() and params_commit() touch flash.
+ * params_stage() changes a value in RAM only, for trying settings out.
+ *
+ * Programming and erasing stall every fetch from flash (a page erase takes
+ * about 22 ms), so do not write to flash while stabilizing.
+ */
+
+#ifndef __PARAMSTORE_H
+#define __PARAMSTORE_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PARAM_MAX_KEYS 32
+#define PARAM_STORE_PAGES 2
+
+typedef struct {
+  uint32_t records;      //records in the active page
+  uint32_t compactions;
+  uint32_t badRecords;   //records skipped at boot for a bad CRC or key
+  uint32_t scanUs;       //duration of the boot scan
+  uint32_t writeErrors;
+} param_store_stats_t;
+
+void params_init(const uint32_t *defaults, uint8_t count);
+uint32_t params_get(uint8_t key);
+float params_getFloat(uint8_t key);
+bool params_set(uint8_t key, uint32_t value);
+bool params_setFloat(uint8_t key, float value);
+bool params_stage(uint8_t key, uint32_t value);
+bool params_commit(void);
+void params_getStats(param_store_stats_t *out);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __PARAMSTORE_H */
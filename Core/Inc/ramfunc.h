@@ -0,0 +1,27 @@
+/*
+ * ramfunc.h
+ *
+ * RAMFUNC places a function in SRAM2, which the core fetches from over the
+ * I-Code bus with no flash wait states.  The startup code copies the .ram2
+ * section there from flash before main() runs, and the linker adds veneers
+ * for calls between flash and SRAM2.  Use it on the control path and the
+ * interrupt handlers that run every millisecond; SRAM2 is 16 KB.
+ *
+ * Build with RAMFUNC_ENABLED 0 to leave everything in flash, e.g. to compare
+ * the control tick cycle counts.
+ */
+
+#ifndef __RAMFUNC_H
+#define __RAMFUNC_H
+
+#ifndef RAMFUNC_ENABLED
+#define RAMFUNC_ENABLED 1
+#endif
+
+#if RAMFUNC_ENABLED
+#define RAMFUNC __attribute__((section(".ram2.text"), noinline))
+#else
+#define RAMFUNC
+#endif
+
+#endif /* __RAMFUNC_H */
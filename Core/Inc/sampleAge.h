@@ -0,0 +1,48 @@
+/*
+ * sampleAge.h
+ *
+ * Freshness of the samples a consumer picks up from a producer running at
+ * its own rate.  The producer stamps each sample with timestamp_us() and a
+ * sequence number; the consumer passes both to sampleAge_update() every
+ * time it uses a sample, which counts reused samples (duplicates) and
+ * samples it never saw (dropouts) and adds the sample's age to a
+ * histogram.
+ *
+ * timestamp_us() counts microseconds from the HAL tick and the TIM6
+ * timebase counter, which runs at 1 MHz.  It wraps after about 71 minutes,
+ * so only differences are meaningful.
+ */
+
+#ifndef __SAMPLEAGE_H
+#define __SAMPLEAGE_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define AGE_HIST_BINS 10      //bin 0 is below 256 us, bin n below 256 << n us, the last is open
+#define AGE_HIST_BASE_SHIFT 8
+
+typedef struct {
+  uint32_t fresh;         //samples used for the first time
+  uint32_t duplicates;    //updates that saw the same sample again
+  uint32_t dropouts;      //samples published but never seen
+  uint32_t lastAgeUs;
+  uint32_t maxAgeUs;
+  uint32_t hist[AGE_HIST_BINS];
+  uint32_t lastSeq;
+  bool seen;
+} sample_age_t;
+
+uint32_t timestamp_us(void);
+void sampleAge_init(sample_age_t *age);
+void sampleAge_update(sample_age_t *age, uint32_t seq, uint32_t stampUs, uint32_t nowUs);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __SAMPLEAGE_H */
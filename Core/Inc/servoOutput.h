@@ -0,0 +1,62 @@
+/*
+ * servoOutput.h
+ *
+ * The one place that drives the servo PWM outputs on TIM2: CH1 yaw, CH2
+ * pitch, CH4 roll.  Keeping every compare write and channel start/stop
+ * behind these calls gives the application a single seam to the timer, and
+ * lets writes be traced.
+ *
+ * The trace is one-shot: servo_traceArm() clears it and the next
+ * SERVO_TRACE_LEN events are stored with their timestamp_us() time, then
+ * tracing stops, so a timeline starting at a chosen moment can be read out
+ * at leisure.
+ */
+
+#ifndef __SERVOOUTPUT_H
+#define __SERVOOUTPUT_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "stm32l4xx_hal.h"
+
+#define SERVO_TRACE_LEN 128
+
+enum {
+  SERVO_YAW,
+  SERVO_PITCH,
+  SERVO_ROLL,
+  SERVO_COUNT
+};
+
+//Trace event kinds
+#define SERVO_EVENT_WRITE 0
+#define SERVO_EVENT_START 1
+#define SERVO_EVENT_STOP 2
+
+typedef struct {
+  uint32_t stampUs;
+  uint16_t ccr;       //value written, or the compare value at a start/stop
+  uint8_t axis;
+  uint8_t event;
+} servo_trace_t;
+
+void servo_init(TIM_HandleTypeDef *pwm);
+void servo_set(uint8_t axis, uint32_t ccr);
+uint32_t servo_get(uint8_t axis);
+void servo_start(uint8_t axis);
+void servo_stop(uint8_t axis);
+void servo_startAll(void);
+void servo_stopAll(void);
+void servo_traceArm(void);
+uint16_t servo_traceCount(void);
+bool servo_traceGet(uint16_t index, servo_trace_t *out);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __SERVOOUTPUT_H */
@@ -0,0 +1,45 @@
+/*
+ * socEstimator.h
+ *
+ * Battery state-of-charge estimate from terminal voltage and an estimate of
+ * the load current.  The battery is modelled as an open-circuit voltage
+ * source behind a series resistance R0 and one RC polarization pair, so the
+ * voltage sag while the servos draw current is added back before the
+ * open-circuit voltage is looked up in the discharge curve.
+ */
+
+#ifndef __SOCESTIMATOR_H
+#define __SOCESTIMATOR_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SOC_CELLS 1
+#define SOC_R0_MOHM 120.0f         //ohmic resistance of the pack
+#define SOC_R1_MOHM 80.0f          //polarization resistance
+#define SOC_TAU_MS 20000.0f        //polarization time constant R1*C1
+#define SOC_FILTER_MS 10000.0f     //smoothing of the reported SoC
+#define SOC_LOW_PERCENT 10
+#define SOC_LOW_CLEAR_PERCENT 15
+#define SOC_LOW_SAMPLES 10         //consecutive low estimates before flagging
+
+typedef struct {
+  float vrcMv;        //voltage across the RC pair
+  float soc;          //filtered state of charge, 0..100
+  uint8_t lowCount;
+  bool low;
+  bool seeded;
+} soc_estimator_t;
+
+void soc_init(soc_estimator_t *est);
+uint8_t soc_update(soc_estimator_t *est, uint16_t battMv, float loadMa, uint32_t dtMs);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __SOCESTIMATOR_H */
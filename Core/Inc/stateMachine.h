@@ -0,0 +1,57 @@
+/*
+ * stateMachine.h
+ *
+ * Table-driven hierarchical state machine.  States and transitions are plain
+ * const tables, so a machine costs no RAM beyond its current state and the
+ * engine has no hardware dependencies.
+ *
+ * The transition table has one row per state and one column per event.  An
+ * event is looked up in the row of the current state first; if that cell has
+ * no target the parent state's row is tried, and so on up to a top-level
+ * state.  Transition targets should be leaf states.
+ */
+
+#ifndef __STATEMACHINE_H
+#define __STATEMACHINE_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SM_NONE (-1)
+#define SM_MAX_DEPTH 4
+
+typedef struct {
+  int8_t parent;          //SM_NONE for a top-level state
+  void (*onEntry)(void);  //NULL if none
+  void (*onExit)(void);   //NULL if none
+} sm_state_t;
+
+typedef struct {
+  int8_t target;          //SM_NONE if the event is not handled in this state
+  bool (*guard)(void);    //NULL if the transition is unconditional
+  void (*action)(void);   //runs after the exit and before the entry actions
+} sm_transition_t;
+
+typedef struct {
+  const sm_state_t *states;
+  const sm_transition_t *transitions;  //numStates rows of numEvents cells
+  uint8_t numStates;
+  uint8_t numEvents;
+  int8_t current;
+} sm_machine_t;
+
+void sm_init(sm_machine_t *sm, const sm_state_t *states,
+             const sm_transition_t *transitions, uint8_t numStates,
+             uint8_t numEvents, int8_t initial);
+bool sm_dispatch(sm_machine_t *sm, uint8_t event);
+bool sm_isIn(const sm_machine_t *sm, int8_t state);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __STATEMACHINE_H */
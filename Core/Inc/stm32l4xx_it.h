@@ -53,13 +53,13 @@ void MemManage_Handler(void);
 void BusFault_Handler(void);
 void UsageFault_Handler(void);
 void DebugMon_Handler(void);
-void EXTI0_IRQHandler(void);
-void EXTI1_IRQHandler(void);
-void EXTI4_IRQHandler(void);
-void EXTI9_5_IRQHandler(void);
 void TIM6_DAC_IRQHandler(void);
 /* USER CODE BEGIN EFP */
-
+void DMA1_Channel1_IRQHandler(void);
+void EXTI4_IRQHandler(void);
+void EXTI15_10_IRQHandler(void);
+void LPTIM1_IRQHandler(void);
+void USART2_IRQHandler(void);
 /* USER CODE END EFP */
 
 #ifdef __cplusplus
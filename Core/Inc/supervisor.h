@@ -0,0 +1,54 @@
+/*
+ * supervisor.h
+ *
+ * Deadline supervisor and independent watchdog.  Each supervised task
+ * calls supervisor_beat() once per cycle.  supervisor_check(), run
+ * periodically from a low-priority context, compares the time since every
+ * armed task's last beat against its deadline, counts the misses and
+ * reloads the IWDG only if every armed task is on time.  If the checking
+ * context itself stops running, the IWDG resets the chip.
+ *
+ * A late task can starve the check, run again and beat before the check
+ * sees it late.  So supervisor_beat() also compares the gap since the last
+ * beat with the deadline and reports a miss the check has not counted; the
+ * task then enters the safe state itself.
+ *
+ * The IWDG keeps running in STOP2, so its timeout must be longer than the
+ * longest sleep; supervisor_setTimeout() changes it at run time.
+ */
+
+#ifndef __SUPERVISOR_H
+#define __SUPERVISOR_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SUP_MAX_TASKS 4
+#define SUP_LSI_HZ 32000        //nominal; the LSI is only accurate to about 10%
+
+typedef struct {
+  uint32_t deadlineMs;    //longest allowed gap between beats, 0 while disarmed
+  uint32_t beats;
+  uint32_t misses;        //deadlines missed, counted once per late period
+  uint32_t maxGapMs;      //longest gap between beats while armed
+} sup_task_stats_t;
+
+void supervisor_init(uint32_t timeoutMs);
+void supervisor_setTimeout(uint32_t timeoutMs);
+void supervisor_arm(uint8_t task, uint32_t deadlineMs);
+void supervisor_setDeadline(uint8_t task, uint32_t deadlineMs);
+void supervisor_disarm(uint8_t task);
+bool supervisor_beat(uint8_t task);
+uint32_t supervisor_check(void);
+void supervisor_getStats(uint8_t task, sup_task_stats_t *out);
+uint32_t supervisor_withheldFeeds(void);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __SUPERVISOR_H */
@@ -0,0 +1,96 @@
+/*
+ * tuningLink.h
+ *
+ * Binary command link on USART2 for tuning a running gimbal.  Bytes are
+ * received in the USART2 interrupt and assembled into frames there; a
+ * complete, checked frame is handed over through a one-frame mailbox and
+ * the cooperative scheduler is woken to handle it.  Replies and telemetry
+ * are sent from task context.
+ *
+ * Frame: TUNING_SYNC, command, payload length, payload, CRC-8 (poly 0x07)
+ * over command, length and payload.  Multi-byte fields are little-endian.
+ *
+ * A session lasts from a good frame until TUNING_SESSION_MS pass without
+ * one.  During a session printf output, which shares USART2, is dropped so
+ * it cannot break up frames, and the chip stays out of STOP2, in which
+ * USART2 cannot receive (see lowPower.h for how a stopped gimbal is woken).
+ */
+
+#ifndef __TUNINGLINK_H
+#define __TUNINGLINK_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "stm32l4xx_hal.h"
+
+#define TUNING_SYNC 0xA5
+#define TUNING_MAX_PAYLOAD 48
+#define TUNING_SESSION_MS 30000
+#define TUNING_REPLY 0x80       //replies carry the command code with this bit set
+
+//Commands
+#define TUNING_CMD_GET 0x01     //key -> key, value, status
+#define TUNING_CMD_SET 0x02     //key, value -> key, value, status
+#define TUNING_CMD_SAVE 0x03    //-> status
+#define TUNING_CMD_STREAM 0x04  //period ms (u16, 0 = off) -> status
+#define TUNING_CMD_RECORDER 0x05  //op -> status, flight recorder info
+#define TUNING_CMD_HEALTH 0x06  //-> deadline supervisor statistics
+#define TUNING_CMD_SAMPLE_AGE 0x07  //-> orientation age statistics
+#define TUNING_CMD_SERVO_TRACE 0x08 //op, index (u16) -> status, index, count, entries
+#define TUNING_CMD_CONTROL_METRICS 0x09 //op -> status, per-axis control quality
+#define TUNING_CMD_STACKS 0x0A  //-> per-task stack size and high-water mark
+#define TUNING_CMD_CLOCK 0x0B   //-> clock governor statistics
+#define TUNING_TELEMETRY 0x90   //unsolicited telemetry frame
+#define TUNING_RECORDER_DATA 0x91 //recorder sample: index (u16), sample; index 0xFFFF ends a dump
+
+//TUNING_CMD_RECORDER operations
+#define TUNING_RECORDER_INFO 0
+#define TUNING_RECORDER_FREEZE 1
+#define TUNING_RECORDER_DUMP 2  //freezes, then streams every sample, oldest first
+#define TUNING_RECORDER_REARM 3
+
+//TUNING_CMD_SERVO_TRACE operations
+#define TUNING_SERVO_TRACE_ARM 0
+#define TUNING_SERVO_TRACE_READ 1   //up to 5 entries from index
+
+//TUNING_CMD_CONTROL_METRICS operations
+#define TUNING_METRICS_READ 0
+#define TUNING_METRICS_RESTART 1    //measure settling from the next control tick
+
+//Status codes
+#define TUNING_OK 0
+#define TUNING_BAD_KEY 1
+#define TUNING_BUSY 2
+#define TUNING_BAD_COMMAND 3
+#define TUNING_FLASH_ERROR 4
+#define TUNING_BAD_VALUE 5
+
+typedef struct {
+  uint8_t cmd;
+  uint8_t len;
+  uint8_t payload[TUNING_MAX_PAYLOAD];
+} tuning_frame_t;
+
+typedef struct {
+  uint32_t frames;
+  uint32_t crcErrors;
+  uint32_t dropped;      //frames that arrived while the mailbox was full
+  uint32_t overruns;
+} tuning_stats_t;
+
+void tuning_init(UART_HandleTypeDef *uart);
+void tuning_uartIrq(void);
+bool tuning_receive(tuning_frame_t *out);
+void tuning_send(uint8_t cmd, const uint8_t *payload, uint8_t len);
+bool tuning_sessionActive(void);
+void tuning_getStats(tuning_stats_t *out);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __TUNINGLINK_H */
@@ -1,4 +1,5 @@
 #include "PID.h"
+#include "ramfunc.h"
 
 /**
  * Constructs the PIDController object with PID Gains and function pointers
@@ -12,7 +13,7 @@
  * @param (*pidOutput) The function pointer for delivering system output.
  */
 template <class T>
-PIDController<T>::PIDController(double p, double i, double d, T (*pidSource)(), void (*pidOutput)(T output))
+PIDController<T>::PIDController(float p, float i, float d, T (*pidSource)(), void (*pidOutput)(T output))
 {
   _p = p;
   _i = i;
@@ -51,7 +52,7 @@ PIDController<T>::PIDController(double p, double i, double d, T (*pidSource)(),
  * resolution of control (for example, to be placed in the loop() method).
  */
 template <class T>
-void PIDController<T>::tick()
+RAMFUNC void PIDController<T>::tick()
 {
   if(enabled)
   {
@@ -125,14 +126,18 @@ void PIDController<T>::tick()
       //Calculate time since last tick() cycle.
       long deltaTime = currentTime - lastTime;
 
-      //Calculate the integral of the feedback data since last cycle.
-      int cycleIntegral = (lastError + error / 2) * deltaTime;
+      //A tick in the same millisecond as the last one, e.g. right after reset(), has no time step.
+      if(deltaTime > 0)
+      {
+        //Calculate the integral of the feedback data since last cycle.
+        int cycleIntegral = (lastError + error / 2) * deltaTime;
 
-      //Add this cycle's integral to the integral cumulation.
-      integralCumulation += cycleIntegral;
+        //Add this cycle's integral to the integral cumulation.
+        integralCumulation += cycleIntegral;
 
-      //Calculate the slope of the line with data from the current and last cycles.
-      cycleDerivative = (error - lastError) / deltaTime;
+        //Calculate the slope of the line with data from the current and last cycles.
+        cycleDerivative = (error - lastError) / deltaTime;
+      }
 
       //Save time data for next iteration.
       lastTime = currentTime;
@@ -235,6 +240,24 @@ void PIDController<T>::setEnabled(bool e)
   enabled = e;
 }
 
+/**
+ * Clears the integral cumulation and the error history, and restarts the
+ * time step from now, so that the next tick() does not integrate or
+ * differentiate over the time this PIDController was not ticked.
+ */
+template <class T>
+void PIDController<T>::reset()
+{
+  output = 0;
+  integralCumulation = 0;
+  lastError = 0;
+  cycleDerivative = 0;
+  if(timeFunctionRegistered)
+  {
+    lastTime = _getSystemTime();
+  }
+}
+
 /**
  * Tells whether this PIDController is enabled.
  * @return True for enabled, false for disabled.
@@ -504,7 +527,7 @@ T PIDController<T>::getFeedbackWrapUpperBound()
  * @param d The new derivative gain.
  */
 template <class T>
-void PIDController<T>::setPID(double p, double i, double d)
+void PIDController<T>::setPID(float p, float i, float d)
 {
   _p = p;
   _i = i;
@@ -516,7 +539,7 @@ void PIDController<T>::setPID(double p, double i, double d)
  * @param p The new proportional gain.
  */
 template <class T>
-void PIDController<T>::setP(double p)
+void PIDController<T>::setP(float p)
 {
   _p = p;
 }
@@ -526,7 +549,7 @@ void PIDController<T>::setP(double p)
  * @param i The new integral gain.
  */
 template <class T>
-void PIDController<T>::setI(double i)
+void PIDController<T>::setI(float i)
 {
   _i = i;
 }
@@ -536,7 +559,7 @@ void PIDController<T>::setI(double i)
  * @param d The new derivative gain.
  */
 template <class T>
-void PIDController<T>::setD(double d)
+void PIDController<T>::setD(float d)
 {
   _d = d;
 }
@@ -546,7 +569,7 @@ void PIDController<T>::setD(double d)
  * @return The proportional gain.
  */
 template <class T>
-double PIDController<T>::getP()
+float PIDController<T>::getP()
 {
   return _p;
 }
@@ -556,7 +579,7 @@ double PIDController<T>::getP()
  * @return The integral gain.
  */
 template <class T>
-double PIDController<T>::getI()
+float PIDController<T>::getI()
 {
   return _i;
 }
@@ -566,7 +589,7 @@ double PIDController<T>::getI()
  * @return The derivative gain.
  */
 template <class T>
-double PIDController<T>::getD()
+float PIDController<T>::getD()
 {
   return _d;
 }
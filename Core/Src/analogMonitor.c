@@ -0,0 +1,189 @@
+#include "analogMonitor.h"
+#include "stm32l4xx_hal.h"
+#include "ramfunc.h"
+
+//Factory calibration values, measured with VDDA = 3.0 V (RM0394, DS11451).
+#define VREFINT_CAL (*(const uint16_t *)0x1FFF75AAUL)
+#define TS_CAL1 (*(const uint16_t *)0x1FFF75A8UL)   //30 degC
+#define TS_CAL2 (*(const uint16_t *)0x1FFF75CAUL)   //130 degC
+#define CAL_VDDA_MV 3000
+
+#define ADC_CH_VREFINT 0
+#define ADC_CH_TEMP 17
+#define ADC_EXTSEL_TIM6_TRGO 13
+#define ADC_SMP_247 6    //247.5 cycles, enough for the battery divider
+#define ADC_SMP_640 7    //640.5 cycles, the temperature sensor needs >= 5 us
+
+enum {
+  SLOT_VREFINT,
+  SLOT_TEMP,
+  SLOT_BATT,
+  NUM_SLOTS        //conversions per scan, in sequence order
+};
+
+static uint16_t dmaBuffer[2 * ANALOG_SCANS_PER_HALF * NUM_SLOTS];
+static uint32_t filtered[NUM_SLOTS];   //raw counts << 4
+static analog_snapshot_t snapshot;
+static volatile uint32_t sequence;     //odd while the snapshot is being written
+
+/*
+ * Points DMA1 channel 1 at the start of the buffer.  The ADC sequence must
+ * be stopped, so its next conversion is SQ1 and lands in slot 0.
+ */
+static void startDma(void) {
+  DMA1_Channel1->CCR &= ~DMA_CCR_EN;
+  DMA1->IFCR = DMA_IFCR_CGIF1;
+  DMA1_Channel1->CPAR = (uint32_t)&ADC1->DR;
+  DMA1_Channel1->CMAR = (uint32_t)dmaBuffer;
+  DMA1_Channel1->CNDTR = sizeof(dmaBuffer) / sizeof(dmaBuffer[0]);
+  DMA1_Channel1->CCR = DMA_CCR_PL_0 | DMA_CCR_MSIZE_0 | DMA_CCR_PSIZE_0 | DMA_CCR_MINC
+                     | DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_EN;
+}
+
+/**
+ * Powers up, calibrates and starts ADC1 and its DMA channel.  Conversions are
+ * triggered by TIM6, so the HAL time base must already be running, and the
+ * battery pin is put in analog mode by MX_GPIO_Init().
+ */
+void analogMonitor_init(void) {
+  __HAL_RCC_ADC_CLK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  //synchronous clock HCLK/1, VREFINT and temperature sensor on
+  ADC1_COMMON->CCR = ADC_CCR_CKMODE_0 | ADC_CCR_VREFEN | ADC_CCR_TSEN;
+
+  ADC1->CR &= ~ADC_CR_DEEPPWD;
+  ADC1->CR |= ADC_CR_ADVREGEN;
+  HAL_Delay(1);   //regulator start-up is 20 us
+
+  ADC1->CR |= ADC_CR_ADCAL;
+  while (ADC1->CR & ADC_CR_ADCAL);
+
+  ADC1->ISR = ADC_ISR_ADRDY;
+  ADC1->CR |= ADC_CR_ADEN;
+  while (!(ADC1->ISR & ADC_ISR_ADRDY));
+
+  ADC1->SQR1 = ((NUM_SLOTS - 1) << ADC_SQR1_L_Pos)
+             | (ADC_CH_VREFINT << ADC_SQR1_SQ1_Pos)
+             | (ADC_CH_TEMP << ADC_SQR1_SQ2_Pos)
+             | (ANALOG_BATT_CHANNEL << ADC_SQR1_SQ3_Pos);
+  ADC1->SMPR1 = (ADC_SMP_640 << ADC_SMPR1_SMP0_Pos)
+              | (ADC_SMP_247 << (ANALOG_BATT_CHANNEL * 3));
+  ADC1->SMPR2 = ADC_SMP_640 << ADC_SMPR2_SMP17_Pos;
+
+  //4x oversampling shifted right by 2 keeps 12-bit results
+  ADC1->CFGR2 = ADC_CFGR2_ROVSE | (1 << ADC_CFGR2_OVSR_Pos) | (2 << ADC_CFGR2_OVSS_Pos);
+  ADC1->CFGR = ADC_CFGR_DMAEN | ADC_CFGR_DMACFG | ADC_CFGR_OVRMOD
+             | ADC_CFGR_EXTEN_0 | (ADC_EXTSEL_TIM6_TRGO << ADC_CFGR_EXTSEL_Pos);
+
+  //DMA1 channel 1, request 0 is ADC1
+  DMA1_CSELR->CSELR &= ~DMA_CSELR_C1S;
+  startDma();
+  HAL_NVIC_SetPriority(DMA1_Channel1_IRQn, 6, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+
+  //TIM6 update events trigger the scans
+  TIM6->CR2 = (TIM6->CR2 & ~TIM_CR2_MMS) | TIM_CR2_MMS_1;
+  ADC1->CR |= ADC_CR_ADSTART;
+}
+
+/**
+ * Stops conversions and disables ADC1 and the internal channels before the
+ * chip enters STOP.  The stop can fall in the middle of a scan; the scans
+ * in the unfinished half of the buffer are dropped on resume.
+ */
+void analogMonitor_suspend(void) {
+  if (ADC1->CR & ADC_CR_ADSTART) {
+    ADC1->CR |= ADC_CR_ADSTP;
+    while (ADC1->CR & ADC_CR_ADSTP);
+  }
+  ADC1->CR |= ADC_CR_ADDIS;
+  while (ADC1->CR & ADC_CR_ADEN);
+  ADC1_COMMON->CCR &= ~(ADC_CCR_VREFEN | ADC_CCR_TSEN);
+}
+
+/**
+ * Undoes analogMonitor_suspend().  The ADC restarts its sequence at SQ1, so
+ * the DMA is rewound to the start of the buffer to keep every conversion in
+ * its slot.
+ */
+void analogMonitor_resume(void) {
+  ADC1_COMMON->CCR |= ADC_CCR_VREFEN | ADC_CCR_TSEN;
+  ADC1->ISR = ADC_ISR_ADRDY;
+  ADC1->CR |= ADC_CR_ADEN;
+  while (!(ADC1->ISR & ADC_ISR_ADRDY));
+  startDma();
+  ADC1->CR |= ADC_CR_ADSTART;
+}
+
+static void publish(void) {
+  uint32_t vdda = CAL_VDDA_MV * VREFINT_CAL * 16UL / filtered[SLOT_VREFINT];
+  uint32_t batt = filtered[SLOT_BATT] * vdda / (4095UL * 16) * ANALOG_BATT_DIVIDER;
+  //temperature reading rescaled to the calibration supply
+  int32_t ts = (int32_t)(filtered[SLOT_TEMP] * vdda / (CAL_VDDA_MV * 16UL));
+  int32_t temp = (ts - TS_CAL1) * 1000 / (TS_CAL2 - TS_CAL1) + 300;
+
+  sequence++;
+  __DMB();
+  snapshot.battMv = batt;
+  snapshot.vddaMv = vdda;
+  snapshot.mcuTempDeciC = temp;
+  snapshot.tick = HAL_GetTick();
+  snapshot.updates++;
+  __DMB();
+  sequence++;
+}
+
+static void processBlock(const uint16_t *block) {
+  uint32_t sum[NUM_SLOTS] = {0};
+
+  for (uint32_t scan = 0; scan < ANALOG_SCANS_PER_HALF; ++scan) {
+    for (uint32_t slot = 0; slot < NUM_SLOTS; ++slot) {
+      sum[slot] += block[scan * NUM_SLOTS + slot];
+    }
+  }
+
+  for (uint32_t slot = 0; slot < NUM_SLOTS; ++slot) {
+    uint32_t mean = (sum[slot] << 4) / ANALOG_SCANS_PER_HALF;
+    if (snapshot.updates == 0) {
+      filtered[slot] = mean;
+    }
+    else {
+      filtered[slot] += ((int32_t)(mean - filtered[slot])) >> ANALOG_FILTER_SHIFT;
+    }
+  }
+
+  if (filtered[SLOT_VREFINT] != 0) {
+    publish();
+  }
+}
+
+/**
+ * Call from DMA1_Channel1_IRQHandler.  Filters whichever half of the buffer
+ * the DMA has just finished.
+ */
+RAMFUNC void analogMonitor_dmaIrq(void) {
+  uint32_t isr = DMA1->ISR;
+  DMA1->IFCR = DMA_IFCR_CGIF1;
+
+  if (isr & DMA_ISR_HTIF1) {
+    processBlock(&dmaBuffer[0]);
+  }
+  if (isr & DMA_ISR_TCIF1) {
+    processBlock(&dmaBuffer[ANALOG_SCANS_PER_HALF * NUM_SLOTS]);
+  }
+}
+
+/**
+ * Copies the latest readings.  Lock-free: retries if the DMA interrupt
+ * published new readings during the copy.
+ */
+void analogMonitor_read(analog_snapshot_t *out) {
+  uint32_t seq;
+  do {
+    seq = sequence;
+    __DMB();
+    *out = snapshot;
+    __DMB();
+  } while ((seq & 1) || seq != sequence);
+}
@@ -0,0 +1,323 @@
+#include "benchKernels.h"
+#include "PID.h"
+#include "axisMath.h"
+#include "bno055.h"
+#include "fastMath.h"
+#include "gimbalDefaults.h"
+#include "motionProfile.h"
+#include "socEstimator.h"
+#include <math.h>
+#include <string.h>
+
+static float angles[BENCH_INPUTS];        //-180..180 degrees
+static float headings[BENCH_INPUTS];      //0..360 degrees
+static int pulses[BENCH_INPUTS];          //servo travel plus some overshoot
+static uint8_t euler[BENCH_INPUTS][6];    //raw BNO055 register blocks
+static uint8_t quaternion[BENCH_INPUTS][8];
+static float unitQuaternion[BENCH_INPUTS][4];   //w, x, y, z
+static uint16_t battMv[BENCH_INPUTS];
+
+static uint32_t seed;
+static uint32_t inputIndex;
+static unsigned long fakeClock;
+static uint32_t checksum;
+
+static uint32_t nextRandom() {
+  seed = seed * 1664525u + 1013904223u;
+  return seed;
+}
+
+//Uniform in [low, high).
+static float randomIn(float low, float high) {
+  return low + (high - low) * (float)(nextRandom() >> 8) / (float)(1u << 24);
+}
+
+static void fold(uint32_t value) {
+  checksum = ((checksum << 5) | (checksum >> 27)) ^ value;
+}
+
+static void foldFloat(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  fold(bits);
+}
+
+static float pidSource() {
+  inputIndex = (inputIndex + 1) & (BENCH_INPUTS - 1);
+  return angles[inputIndex];
+}
+
+static float pidOutput;
+
+static void pidSink(float output) {
+  pidOutput = output;
+}
+
+//One control task period a tick.
+static unsigned long benchClock() {
+  fakeClock += CONTROL_FREQ;
+  return fakeClock;
+}
+
+static PIDController<float> pidPlain(KP_p, KI_p, KD_p, pidSource, pidSink);
+static PIDController<float> pidWrapped(KP_p, KI_p, KD_p, pidSource, pidSink);
+static PIDController<float> pidBounded(KP_p, KI_p, KD_p, pidSource, pidSink);
+static PIDController<float> pidTimed(KP_p, KI_p, KD_p, pidSource, pidSink);
+static PIDController<float> pidFull(KP_p, KI_p, KD_p, pidSource, pidSink);
+
+static void runPid(PIDController<float> &pid, uint32_t iterations) {
+  for (uint32_t n = 0; n < iterations; n++) {
+    pid.tick();
+  }
+  foldFloat(pidOutput);
+  foldFloat(pid.getIntegralCumulation());
+}
+
+static void benchPidPlain(uint32_t iterations) { runPid(pidPlain, iterations); }
+static void benchPidWrapped(uint32_t iterations) { runPid(pidWrapped, iterations); }
+static void benchPidBounded(uint32_t iterations) { runPid(pidBounded, iterations); }
+static void benchPidTimed(uint32_t iterations) { runPid(pidTimed, iterations); }
+static void benchPidFull(uint32_t iterations) { runPid(pidFull, iterations); }
+
+static void benchDecodeEuler(uint32_t iterations) {
+  float sum = 0;
+  for (uint32_t n = 0; n < iterations; n++) {
+    bno055_vector_t v = bno055_decodeVector(BNO055_VECTOR_EULER, euler[n & (BENCH_INPUTS - 1)]);
+    sum += v.x;
+  }
+  foldFloat(sum);
+}
+
+static void benchDecodeQuaternion(uint32_t iterations) {
+  float sum = 0;
+  for (uint32_t n = 0; n < iterations; n++) {
+    bno055_vector_t v = bno055_decodeVector(BNO055_VECTOR_QUATERNION, quaternion[n & (BENCH_INPUTS - 1)]);
+    sum += v.w;
+  }
+  foldFloat(sum);
+}
+
+static void benchYawUnwrap(uint32_t iterations) {
+  float sum = 0;
+  for (uint32_t n = 0; n < iterations; n++) {
+    uint32_t i = n & (BENCH_INPUTS - 1);
+    sum += axis_unwrapYaw(headings[i], pulses[i], PWM_MID, PWM_HYSTERESIS, ROTATIONOFFSET);
+  }
+  foldFloat(sum);
+}
+
+//The pulse update of pitchPWM(): add the PID output, then clamp.
+static void benchPulseClamp(uint32_t iterations) {
+  int ccr = PWM_MID;
+  for (uint32_t n = 0; n < iterations; n++) {
+    ccr = axis_clampPulse(ccr + (int)angles[n & (BENCH_INPUTS - 1)] * 40, PWM_LOW, PWM_HIGH);
+  }
+  fold((uint32_t)ccr);
+}
+
+//One control tick of the setpoint profile, commanded by the joystick.
+static void benchMotionProfile(uint32_t iterations) {
+  static motion_profile_t mp;
+  motionProfile_init(&mp, 0, 90, 360);
+  for (uint32_t n = 0; n < iterations; n++) {
+    motionProfile_stepVelocity(&mp, angles[n & (BENCH_INPUTS - 1)], 0.003f);
+  }
+  foldFloat(mp.position);
+}
+
+static void benchSocUpdate(uint32_t iterations) {
+  static soc_estimator_t est;
+  uint8_t soc = 0;
+  soc_init(&est);
+  for (uint32_t n = 0; n < iterations; n++) {
+    uint32_t i = n & (BENCH_INPUTS - 1);
+    soc = soc_update(&est, battMv[i], headings[i], 50);
+  }
+  fold(soc);
+}
+
+//Quaternion to yaw, pitch and roll in degrees with newlib's float functions.
+static void benchQuatEuler(uint32_t iterations) {
+  float sum = 0;
+  for (uint32_t n = 0; n < iterations; n++) {
+    const float *q = unitQuaternion[n & (BENCH_INPUTS - 1)];
+    float sinp = 2 * (q[0] * q[2] - q[3] * q[1]);
+    if (sinp > 1) sinp = 1;
+    if (sinp < -1) sinp = -1;
+    float yaw = atan2f(2 * (q[0] * q[3] + q[1] * q[2]), 1 - 2 * (q[2] * q[2] + q[3] * q[3]));
+    float pitch = asinf(sinp);
+    float roll = atan2f(2 * (q[0] * q[1] + q[2] * q[3]), 1 - 2 * (q[1] * q[1] + q[2] * q[2]));
+    sum += (yaw + pitch + roll) * 57.2957795f;
+  }
+  foldFloat(sum);
+}
+
+static void benchQuatEulerFast(uint32_t iterations) {
+  float sum = 0;
+  float euler[3];
+  for (uint32_t n = 0; n < iterations; n++) {
+    fast_quatToEuler(unitQuaternion[n & (BENCH_INPUTS - 1)], euler);
+    sum += euler[0] + euler[1] + euler[2];
+  }
+  foldFloat(sum);
+}
+
+/*
+ * libm against fastMath.h, one function each.  The inputs are the same
+ * tables, so the pairs differ only in the function called.
+ */
+static void benchAtan2Libm(uint32_t iterations) {
+  float sum = 0;
+  for (uint32_t n = 0; n < iterations; n++) {
+    uint32_t i = n & (BENCH_INPUTS - 1);
+    sum += atan2f(angles[i], headings[i] - 180);
+  }
+  foldFloat(sum);
+}
+
+static void benchAtan2Fast(uint32_t iterations) {
+  float sum = 0;
+  for (uint32_t n = 0; n < iterations; n++) {
+    uint32_t i = n & (BENCH_INPUTS - 1);
+    sum += fast_atan2f(angles[i], headings[i] - 180);
+  }
+  foldFloat(sum);
+}
+
+static void benchSinLibm(uint32_t iterations) {
+  float sum = 0;
+  for (uint32_t n = 0; n < iterations; n++) {
+    sum += sinf(angles[n & (BENCH_INPUTS - 1)] * 0.0174532925f);
+  }
+  foldFloat(sum);
+}
+
+static void benchSinFast(uint32_t iterations) {
+  float sum = 0;
+  for (uint32_t n = 0; n < iterations; n++) {
+    sum += fast_sinf(angles[n & (BENCH_INPUTS - 1)] * 0.0174532925f);
+  }
+  foldFloat(sum);
+}
+
+static void benchInvSqrtLibm(uint32_t iterations) {
+  float sum = 0;
+  for (uint32_t n = 0; n < iterations; n++) {
+    sum += 1.0f / sqrtf(headings[n & (BENCH_INPUTS - 1)] + 1);
+  }
+  foldFloat(sum);
+}
+
+static void benchInvSqrtFast(uint32_t iterations) {
+  float sum = 0;
+  for (uint32_t n = 0; n < iterations; n++) {
+    sum += fast_invSqrtf(headings[n & (BENCH_INPUTS - 1)] + 1);
+  }
+  foldFloat(sum);
+}
+
+static void benchWrapLibm(uint32_t iterations) {
+  float sum = 0;
+  for (uint32_t n = 0; n < iterations; n++) {
+    sum += fmodf(angles[n & (BENCH_INPUTS - 1)] * 4 + 540, 360) - 180;
+  }
+  foldFloat(sum);
+}
+
+static void benchWrapFast(uint32_t iterations) {
+  float sum = 0;
+  for (uint32_t n = 0; n < iterations; n++) {
+    sum += fast_wrap180(angles[n & (BENCH_INPUTS - 1)] * 4);
+  }
+  foldFloat(sum);
+}
+
+static const bench_kernel_t kernels[] = {
+  { "pid_plain", benchPidPlain },
+  { "pid_wrapped", benchPidWrapped },
+  { "pid_bounded", benchPidBounded },
+  { "pid_timed", benchPidTimed },
+  { "pid_full", benchPidFull },
+  { "bno055_decode_euler", benchDecodeEuler },
+  { "bno055_decode_quat", benchDecodeQuaternion },
+  { "yaw_unwrap", benchYawUnwrap },
+  { "pulse_clamp", benchPulseClamp },
+  { "motion_profile", benchMotionProfile },
+  { "soc_update", benchSocUpdate },
+  { "quat_euler_libm", benchQuatEuler },
+  { "quat_euler_fast", benchQuatEulerFast },
+  { "atan2_libm", benchAtan2Libm },
+  { "atan2_fast", benchAtan2Fast },
+  { "sin_libm", benchSinLibm },
+  { "sin_fast", benchSinFast },
+  { "inv_sqrt_libm", benchInvSqrtLibm },
+  { "inv_sqrt_fast", benchInvSqrtFast },
+  { "wrap180_libm", benchWrapLibm },
+  { "wrap180_fast", benchWrapFast },
+};
+
+/**
+ * Fills the input tables and resets the controllers.  Call before every
+ * run that should be comparable with another.
+ */
+void bench_init(void) {
+  seed = 1;
+  inputIndex = 0;
+  fakeClock = 0;
+  checksum = 0;
+
+  for (uint32_t i = 0; i < BENCH_INPUTS; i++) {
+    angles[i] = randomIn(-180, 180);
+    headings[i] = randomIn(0, 360);
+    pulses[i] = (int)randomIn(PWM_LOW - 500, PWM_HIGH + 500);
+    for (uint8_t b = 0; b < sizeof(euler[i]); b++) {
+      euler[i][b] = (uint8_t)nextRandom();
+    }
+    for (uint8_t b = 0; b < sizeof(quaternion[i]); b++) {
+      quaternion[i][b] = (uint8_t)nextRandom();
+    }
+    float norm = 0;
+    for (uint8_t c = 0; c < 4; c++) {
+      unitQuaternion[i][c] = randomIn(-1, 1);
+      norm += unitQuaternion[i][c] * unitQuaternion[i][c];
+    }
+    norm = sqrtf(norm);
+    for (uint8_t c = 0; c < 4; c++) {
+      unitQuaternion[i][c] /= norm;
+    }
+    battMv[i] = (uint16_t)randomIn(3400, 4200);
+  }
+
+  PIDController<float> *all[] = { &pidPlain, &pidWrapped, &pidBounded, &pidTimed, &pidFull };
+  for (PIDController<float> *pid : all) {
+    pid->setTarget(0);
+    pid->setMaxIntegralCumulation(30000);
+    pid->setEnabled(true);
+  }
+  pidWrapped.setFeedbackWrapped(true);
+  pidWrapped.setFeedbackWrapBounds(-180, 180);
+  pidBounded.setInputBounded(true);
+  pidBounded.setInputBounds(-90, 90);
+  pidBounded.setOutputBounded(true);
+  pidBounded.setOutputBounds(-500, 500);
+  pidTimed.registerTimeFunction(benchClock);
+  pidFull.setFeedbackWrapped(true);
+  pidFull.setFeedbackWrapBounds(-180, 180);
+  pidFull.setInputBounded(true);
+  pidFull.setInputBounds(-90, 90);
+  pidFull.setOutputBounded(true);
+  pidFull.setOutputBounds(-500, 500);
+  pidFull.registerTimeFunction(benchClock);
+}
+
+uint8_t bench_count(void) {
+  return sizeof(kernels) / sizeof(kernels[0]);
+}
+
+const bench_kernel_t *bench_get(uint8_t index) {
+  return (index < bench_count()) ? &kernels[index] : NULL;
+}
+
+uint32_t bench_checksum(void) {
+  return checksum;
+}
@@ -0,0 +1,55 @@
+#include "benchRunner.h"
+#include "benchKernels.h"
+#include "clockGovernor.h"
+#include "ramfunc.h"
+#include "stm32l4xx_hal.h"
+#include <stdio.h>
+
+/**
+ * Cycles of one run of a kernel, with interrupts masked.  The cost of the
+ * call itself, measured as a run of zero iterations, is taken off.
+ */
+static uint32_t timeKernel(const bench_kernel_t *kernel, uint32_t iterations) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint32_t start = DWT->CYCCNT;
+  kernel->run(0);
+  uint32_t empty = DWT->CYCCNT - start;
+  start = DWT->CYCCNT;
+  kernel->run(iterations);
+  uint32_t cycles = DWT->CYCCNT - start;
+  __set_PRIMASK(primask);
+  return (cycles > empty) ? cycles - empty : 0;
+}
+
+/**
+ * Switches to CLOCK_FULL, the clock the control loop runs at in STABILIZE,
+ * then runs every kernel and prints the table.  Blocks for well under a
+ * second; call before the watchdog is started.
+ */
+void benchRunner_run(void) {
+  clock_setProfile(CLOCK_FULL);   //a failed switch leaves MSI; the header shows sysclk
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  printf("# bench sysclk=%lu iterations=%u ramfunc=%u\r\n",
+         SystemCoreClock, BENCH_ITERATIONS, RAMFUNC_ENABLED);
+  printf("name,cycles_per_op,checksum\r\n");
+
+  for (uint8_t k = 0; k < bench_count(); k++) {
+    const bench_kernel_t *kernel = bench_get(k);
+    uint32_t best = UINT32_MAX;
+
+    for (uint8_t r = 0; r < BENCH_REPEATS; r++) {
+      bench_init();
+      kernel->run(BENCH_ITERATIONS / 10);   //warm the cache and the controllers
+      uint32_t cycles = timeKernel(kernel, BENCH_ITERATIONS);
+      if (cycles < best) {
+        best = cycles;
+      }
+    }
+    printf("%s,%lu.%02lu,%08lx\r\n", kernel->name, best / BENCH_ITERATIONS,
+           (best % BENCH_ITERATIONS) * 100 / BENCH_ITERATIONS, bench_checksum());
+  }
+  printf("# end\r\n");
+}
@@ -0,0 +1,165 @@
+#include "blackBox.h"
+#include "stm32l4xx_hal.h"
+#include "ramfunc.h"
+
+#define BB_MAGIC 0x58424B42   //"BKBX"
+
+typedef struct {
+  uint32_t magic;
+  uint16_t sampleSize;        //layout check against a record left by another build
+  uint16_t capacity;
+  uint32_t written;
+  uint32_t freezeTick;
+  volatile uint8_t reason;
+  uint8_t bootsFrozen;
+  uint8_t decimation;
+  bb_sample_t samples[BB_CAPACITY];
+} bb_store_t;
+
+//Not copied or cleared by the startup code, see .ram2_noinit in the linker script.
+static bb_store_t store __attribute__((section(".ram2_noinit")));
+static uint8_t ticksToSample;
+static uint16_t maxTickCycles;
+
+static void clear(void) {
+  store.magic = BB_MAGIC;
+  store.sampleSize = sizeof(bb_sample_t);
+  store.capacity = BB_CAPACITY;
+  store.decimation = BB_DECIMATION;
+  store.written = 0;
+  store.freezeTick = 0;
+  store.bootsFrozen = 0;
+  store.reason = BB_RUNNING;
+}
+
+/**
+ * Takes over the record left in SRAM2 by the previous run, or starts a new
+ * one.  A frozen record is kept.  A running record is frozen if the reset
+ * came from a watchdog and discarded otherwise.  After a power-on the
+ * contents of SRAM2 are random, so they are always discarded.
+ * @param resetFlags RCC->CSR as read at boot, before the flags are cleared.
+ */
+void blackbox_init(uint32_t resetFlags) {
+  bool valid = store.magic == BB_MAGIC && store.sampleSize == sizeof(bb_sample_t)
+            && store.capacity == BB_CAPACITY && store.decimation == BB_DECIMATION
+            && store.reason <= BB_FREEZE_STACK;
+
+  if (!valid || (resetFlags & RCC_CSR_BORRSTF)) {
+    clear();
+  }
+  else if (store.reason != BB_RUNNING) {
+    if (store.bootsFrozen < UINT8_MAX) {
+      store.bootsFrozen++;
+    }
+  }
+  else if (resetFlags & (RCC_CSR_IWDGRSTF | RCC_CSR_WWDGRSTF)) {
+    store.freezeTick = 0;   //unknown, the tick counter restarted
+    store.bootsFrozen = 1;
+    store.reason = BB_FREEZE_WATCHDOG;
+  }
+  else {
+    clear();
+  }
+}
+
+/**
+ * Counts a control tick and tells whether this one is sampled.  Called from
+ * the control task before building the sample, so the ticks in between cost
+ * nothing.
+ * @param cycles Execution time of this tick, in the units of bb_sample_t.
+ * @param maxCycles Set to the longest tick since the last sample when
+ * returning true.
+ * @return True on every BB_DECIMATION-th tick, unless frozen.
+ */
+RAMFUNC bool blackbox_due(uint16_t cycles, uint16_t *maxCycles) {
+  if (store.reason != BB_RUNNING) {
+    return false;
+  }
+  if (cycles > maxTickCycles) {
+    maxTickCycles = cycles;
+  }
+  if (ticksToSample > 1) {
+    ticksToSample--;
+    return false;
+  }
+  *maxCycles = maxTickCycles;
+  maxTickCycles = 0;
+  ticksToSample = BB_DECIMATION;
+  return true;
+}
+
+/**
+ * Appends a sample, overwriting the oldest one once the buffer is full.
+ * Does nothing while frozen.  Called from the control task only.
+ */
+RAMFUNC void blackbox_record(const bb_sample_t *sample) {
+  if (store.reason != BB_RUNNING) {
+    return;
+  }
+  store.samples[store.written % BB_CAPACITY] = *sample;
+  store.written++;
+}
+
+/**
+ * Stops recording and keeps the current contents until blackbox_rearm().
+ * The first reason given is kept.  Safe to call from ISRs and fault
+ * handlers.
+ */
+void blackbox_freeze(uint8_t reason) {
+  if (store.reason != BB_RUNNING || reason == BB_RUNNING) {
+    return;
+  }
+  store.freezeTick = HAL_GetTick();
+  store.bootsFrozen = 0;
+  store.reason = reason;
+}
+
+/**
+ * Discards the record and starts recording again.
+ */
+void blackbox_rearm(void) {
+  store.reason = BB_FREEZE_COMMAND;   //keep the control task out while clearing
+  clear();
+}
+
+void blackbox_getInfo(bb_info_t *out) {
+  out->reason = store.reason;
+  out->written = store.written;
+  out->count = (store.written < BB_CAPACITY) ? store.written : BB_CAPACITY;
+  out->freezeTick = store.freezeTick;
+  out->bootsFrozen = store.bootsFrozen;
+  out->decimation = store.decimation;
+}
+
+/**
+ * Reads a sample, oldest first.  Freeze the recorder before reading the
+ * record out, otherwise samples may be overwritten while it is read.
+ * @param index 0 for the oldest sample, up to count - 1 from blackbox_getInfo().
+ * @return False if there is no such sample.
+ */
+bool blackbox_getSample(uint16_t index, bb_sample_t *out) {
+  uint32_t written = store.written;
+  uint32_t count = (written < BB_CAPACITY) ? written : BB_CAPACITY;
+  if (index >= count) {
+    return false;
+  }
+  uint32_t first = (written < BB_CAPACITY) ? 0 : written % BB_CAPACITY;
+  *out = store.samples[(first + index) % BB_CAPACITY];
+  return true;
+}
+
+/**
+ * Converts a value to fixed point for a sample, saturating at the int16
+ * range.
+ * @param scale Stored units per unit of value, e.g. BB_ANGLE_SCALE.
+ */
+RAMFUNC int16_t blackbox_pack(float value, float scale) {
+  float scaled = value * scale;
+  if (scaled >= INT16_MAX) {
+    return INT16_MAX;
+  }
+  if (scaled <= INT16_MIN) {
+    return INT16_MIN;
+  }
+  return (int16_t)(scaled + (scaled >= 0 ? 0.5f : -0.5f));
+}
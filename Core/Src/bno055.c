@@ -1,4 +1,5 @@
 #include "bno055.h"
+#include "ramfunc.h"
 #include <string.h>
 
 uint16_t accelScale = 100;
@@ -8,7 +9,15 @@ uint16_t eulerScale = 16;
 uint16_t magScale = 16;
 uint16_t quaScale = (1<<14);    // 2^14
 
-void bno055_setPage(uint8_t page) { bno055_writeData(BNO055_PAGE_ID, page); }
+// Page last written, -1 if unknown.  Skips the page write before every read.
+static int16_t currentPage = -1;
+
+void bno055_setPage(uint8_t page) {
+  if (page == currentPage) {
+    return;
+  }
+  currentPage = bno055_writeData(BNO055_PAGE_ID, page) ? page : -1;
+}
 
 bno055_opmode_t bno055_getOperationMode() {
   bno055_opmode_t mode;
@@ -46,6 +55,7 @@ void bno055_enableExternalCrystal() { bno055_setExternalCrystalUse(true); }
 void bno055_disableExternalCrystal() { bno055_setExternalCrystalUse(false); }
 
 void bno055_reset() {
+  currentPage = -1;
   bno055_writeData(BNO055_SYS_TRIGGER, 0x20);
   bno055_delay(700);
 }
@@ -169,7 +179,7 @@ void bno055_setCalibrationData(bno055_calibration_data_t calData) {
   bno055_setOperationMode(operationMode);
 }
 
-bno055_vector_t bno055_getVector(uint8_t vec) {
+RAMFUNC bno055_vector_t bno055_getVector(uint8_t vec) {
   bno055_setPage(0);
   uint8_t buffer[8];    // Quaternion need 8 bytes
 
@@ -178,7 +188,18 @@ bno055_vector_t bno055_getVector(uint8_t vec) {
   else
     bno055_readData(vec, buffer, 6);
 
-  double scale = 1;
+  return bno055_decodeVector(vec, buffer);
+}
+
+/**
+ * Converts the raw little-endian register block of a vector into its units.
+ * Split from bno055_getVector() so the conversion can be measured without
+ * the bus.
+ * @param vec The vector register the block was read from.
+ * @param buffer 8 bytes for a quaternion, 6 otherwise.
+ */
+RAMFUNC bno055_vector_t bno055_decodeVector(uint8_t vec, const uint8_t *buffer) {
+  float scale = 1.0f;
 
   if (vec == BNO055_VECTOR_MAGNETOMETER) {
     scale = magScale;
@@ -0,0 +1,42 @@
+#include "bno055Imu.h"
+#include "bno055_stm32.h"
+#include "i2cBus.h"
+#include "ramfunc.h"
+
+Bno055Imu::Bno055Imu(I2C_HandleTypeDef *i2c) : i2c(i2c) {}
+
+/**
+ * Resets the sensor and starts sensor fusion.  Sleeps for about 1.5 s.
+ * @return False if no BNO055 answers on the bus.
+ */
+bool Bno055Imu::begin()
+{
+  uint8_t id = 0;
+
+  bno055_assignI2C(i2c);
+  i2cbus_newCycle();
+  bno055_setup();
+  i2cbus_newCycle();
+  bno055_readData(BNO055_CHIP_ID, &id, 1);
+  if (id != BNO055_ID) {
+    return false;
+  }
+  bno055_setOperationModeNDOF();
+  return true;
+}
+
+/**
+ * Reads the Euler angles.  Each call is one I2C retry-budget cycle, and
+ * the sample is only returned if every transfer in it succeeded.
+ */
+RAMFUNC bool Bno055Imu::read(uint32_t nowMs, bno055_vector_t *out)
+{
+  (void)nowMs;
+  i2cbus_newCycle();
+  bno055_vector_t euler = bno055_getVectorEuler();
+  if (!i2cbus_cycleOk()) {
+    return false;
+  }
+  *out = euler;
+  return true;
+}
@@ -0,0 +1,29 @@
+#include "bno055_stm32.h"
+#include "i2cBus.h"
+
+#ifdef FREERTOS_ENABLED
+#include "FreeRTOS.h"
+#include "task.h"
+#include "cmsis_os.h"
+#endif
+
+void bno055_assignI2C(I2C_HandleTypeDef *hi2c_device) {
+  i2cbus_init(hi2c_device);
+}
+
+void bno055_delay(int time) {
+#ifdef FREERTOS_ENABLED
+  osDelay(time);
+#else
+  HAL_Delay(time);
+#endif
+}
+
+bool bno055_writeData(uint8_t reg, uint8_t data) {
+  uint8_t txdata[2] = {reg, data};
+  return i2cbus_write(BNO055_I2C_ADDR, txdata, sizeof(txdata)) == I2CBUS_OK;
+}
+
+bool bno055_readData(uint8_t reg, uint8_t *data, uint8_t len) {
+  return i2cbus_writeRead(BNO055_I2C_ADDR, reg, data, len) == I2CBUS_OK;
+}
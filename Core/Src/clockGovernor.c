@@ -0,0 +1,248 @@
+#include "clockGovernor.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "cmsis_os.h"
+
+typedef struct {
+  uint32_t hz;
+  uint32_t pllN;        //0 to run straight from MSI
+  uint32_t latency;
+  uint32_t voltageScale;
+} clock_profile_t;
+
+static const clock_profile_t profiles[CLOCK_NUM_PROFILES] = {
+  /* CLOCK_LOW    */ {  4000000,  0, FLASH_LATENCY_0, PWR_REGULATOR_VOLTAGE_SCALE2 },
+  /* CLOCK_NORMAL */ { 32000000, 16, FLASH_LATENCY_1, PWR_REGULATOR_VOLTAGE_SCALE1 },
+  /* CLOCK_FULL   */ { 80000000, 40, FLASH_LATENCY_4, PWR_REGULATOR_VOLTAGE_SCALE1 },
+};
+
+static I2C_HandleTypeDef *i2cHandle;
+static TIM_HandleTypeDef *pwmHandle;
+static UART_HandleTypeDef *uartHandle;
+static uint8_t current = CLOCK_NORMAL;
+static uint8_t wanted = CLOCK_NORMAL;   //differs from current while a switch is deferred
+static uint32_t profileSince;
+static clock_stats_t stats;
+
+/**
+ * Takes over the peripherals to re-time.  Call once after they are
+ * initialized, while SYSCLK is still at the reset configuration.
+ */
+void clock_init(I2C_HandleTypeDef *i2c, TIM_HandleTypeDef *pwm, UART_HandleTypeDef *uart) {
+  i2cHandle = i2c;
+  pwmHandle = pwm;
+  uartHandle = uart;
+  current = wanted = CLOCK_NORMAL;
+  profileSince = HAL_GetTick();
+}
+
+/*
+ * Standard-mode (100 kHz) I2C timing for an I2C kernel clock of hz:
+ * tLOW >= 4.7 us, tHIGH >= 4.0 us, data setup >= 250 ns, hold 0..3.45 us.
+ */
+static uint32_t i2cTiming(uint32_t hz) {
+  uint32_t presc = (hz + 3999999) / 4000000 - 1;
+  if (presc > 15) {
+    presc = 15;
+  }
+  uint32_t tPresNs = (presc + 1) * 1000 / (hz / 1000000);
+  uint32_t scll = (5000 + tPresNs - 1) / tPresNs - 1;
+  uint32_t sclh = (4000 + tPresNs - 1) / tPresNs - 1;
+  uint32_t scldel = (1250 + tPresNs - 1) / tPresNs - 1;
+  uint32_t sdadel = (500 + tPresNs - 1) / tPresNs;
+
+  return (presc << I2C_TIMINGR_PRESC_Pos) | (scldel << I2C_TIMINGR_SCLDEL_Pos)
+       | (sdadel << I2C_TIMINGR_SDADEL_Pos) | (sclh << I2C_TIMINGR_SCLH_Pos)
+       | (scll << I2C_TIMINGR_SCLL_Pos);
+}
+
+static void retimePeripherals(void) {
+  uint32_t pclk = HAL_RCC_GetPCLK1Freq();
+
+  //the RTOS tick; the HAL time base was redone by HAL_RCC_ClockConfig
+  SysTick->LOAD = SystemCoreClock / configTICK_RATE_HZ - 1;
+  SysTick->VAL = 0;
+
+  //keep TIM2 counting at 8 MHz, or keep its frame period if it cannot
+  if (pclk >= CLOCK_TIM2_COUNT_HZ) {
+    pwmHandle->Init.Prescaler = pclk / CLOCK_TIM2_COUNT_HZ - 1;
+    pwmHandle->Init.Period = 65535;
+  }
+  else {
+    pwmHandle->Init.Prescaler = 0;
+    pwmHandle->Init.Period = (uint32_t)(65536ULL * pclk / CLOCK_TIM2_COUNT_HZ) - 1;
+  }
+  __HAL_TIM_SET_PRESCALER(pwmHandle, pwmHandle->Init.Prescaler);
+  __HAL_TIM_SET_AUTORELOAD(pwmHandle, pwmHandle->Init.Period);
+
+  i2cHandle->Init.Timing = i2cTiming(pclk);
+  HAL_I2C_Init(i2cHandle);
+
+  //recomputes BRR from the new PCLK1; keep interrupts enabled outside the HAL
+  uint32_t uartIrqs = uartHandle->Instance->CR1 & (USART_CR1_RXNEIE | USART_CR1_PEIE);
+  HAL_UART_Init(uartHandle);
+  uartHandle->Instance->CR1 |= uartIrqs;
+}
+
+static bool peripheralsIdle(void) {
+  return HAL_I2C_GetState(i2cHandle) == HAL_I2C_STATE_READY
+      && uartHandle->gState == HAL_UART_STATE_READY;
+}
+
+/*
+ * Adds the time since the last mark to *us.  SystemCoreClock must still be
+ * the clock that ran since then, so a stage is marked just before every
+ * SYSCLK change; the few cycles of the change itself count at the new clock.
+ */
+static void markStage(uint32_t *stageStart, uint32_t *us) {
+  uint32_t now = DWT->CYCCNT;
+  *us += (now - *stageStart) / (SystemCoreClock / 1000000U);
+  *stageStart = now;
+}
+
+static bool switchClock(const clock_profile_t *to, uint32_t *us) {
+  RCC_OscInitTypeDef osc = {0};
+  RCC_ClkInitTypeDef clk = {0};
+  uint32_t stageStart = DWT->CYCCNT;
+
+  clk.ClockType = RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_SYSCLK | RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2;
+  clk.AHBCLKDivider = RCC_SYSCLK_DIV1;
+  clk.APB1CLKDivider = RCC_HCLK_DIV1;
+  clk.APB2CLKDivider = RCC_HCLK_DIV1;
+
+  if (to->voltageScale == PWR_REGULATOR_VOLTAGE_SCALE1
+      && HAL_PWREx_ControlVoltageScaling(PWR_REGULATOR_VOLTAGE_SCALE1) != HAL_OK) {
+    return false;
+  }
+
+  //the PLL cannot be changed while it drives SYSCLK, so pass through MSI
+  markStage(&stageStart, us);
+  clk.SYSCLKSource = RCC_SYSCLKSOURCE_MSI;
+  if (HAL_RCC_ClockConfig(&clk, FLASH_LATENCY_0) != HAL_OK) {
+    return false;
+  }
+
+  osc.OscillatorType = RCC_OSCILLATORTYPE_NONE;
+  osc.PLL.PLLState = RCC_PLL_OFF;
+  if (HAL_RCC_OscConfig(&osc) != HAL_OK) {
+    return false;
+  }
+
+  if (to->pllN != 0) {
+    osc.PLL.PLLState = RCC_PLL_ON;
+    osc.PLL.PLLSource = RCC_PLLSOURCE_MSI;
+    osc.PLL.PLLM = 1;
+    osc.PLL.PLLN = to->pllN;
+    osc.PLL.PLLP = RCC_PLLP_DIV7;
+    osc.PLL.PLLQ = RCC_PLLQ_DIV2;
+    osc.PLL.PLLR = RCC_PLLR_DIV2;
+    if (HAL_RCC_OscConfig(&osc) != HAL_OK) {
+      return false;
+    }
+
+    markStage(&stageStart, us);
+    clk.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+    if (HAL_RCC_ClockConfig(&clk, to->latency) != HAL_OK) {
+      return false;
+    }
+  }
+
+  if (to->voltageScale == PWR_REGULATOR_VOLTAGE_SCALE2
+      && HAL_PWREx_ControlVoltageScaling(PWR_REGULATOR_VOLTAGE_SCALE2) != HAL_OK) {
+    return false;
+  }
+
+  retimePeripherals();
+  markStage(&stageStart, us);
+  return true;
+}
+
+/**
+ * Moves SYSCLK to an operating point.  Waits briefly for I2C1 and USART2 to
+ * finish any transfer in progress, then switches with the scheduler
+ * suspended so no task runs while peripherals are being re-timed.
+ * Interrupts stay enabled.  If a transfer is still running after
+ * CLOCK_IDLE_WAIT_MS the switch is deferred rather than cutting it short;
+ * clock_pending() then reports it and clock_retry() tries again.
+ * @param profile One of CLOCK_LOW, CLOCK_NORMAL, CLOCK_FULL.
+ * @return False if the switch was deferred or failed; a failed switch
+ * leaves the clock at MSI.
+ */
+bool clock_setProfile(uint8_t profile) {
+  if (profile >= CLOCK_NUM_PROFILES) {
+    return false;
+  }
+  wanted = profile;
+  if (profile == current) {
+    return true;
+  }
+
+  bool running = (osKernelGetState() == osKernelRunning);
+  for (uint32_t waited = 0; running && !peripheralsIdle() && waited < CLOCK_IDLE_WAIT_MS; ++waited) {
+    osDelay(1);
+  }
+  if (running && !peripheralsIdle()) {
+    stats.deferredSwitches++;
+    return false;
+  }
+
+  if (running) {
+    vTaskSuspendAll();
+  }
+
+  uint32_t now = HAL_GetTick();
+  stats.residencyMs[current] += now - profileSince;
+  stats.mhzMs += (uint64_t)(now - profileSince) * (profiles[current].hz / 1000000U);
+  profileSince = now;
+
+  uint32_t us = 0;
+  bool ok = switchClock(&profiles[profile], &us);
+  if (ok) {
+    current = profile;
+    stats.switches++;
+    stats.lastSwitchUs = us;
+    if (us > stats.maxSwitchUs) {
+      stats.maxSwitchUs = us;
+    }
+  }
+  else {
+    stats.failedSwitches++;
+  }
+
+  if (running) {
+    xTaskResumeAll();
+  }
+  return ok;
+}
+
+uint8_t clock_profile(void) {
+  return current;
+}
+
+/**
+ * Tells whether a switch asked for by clock_setProfile() has not happened
+ * yet.
+ */
+bool clock_pending(void) {
+  return wanted != current;
+}
+
+/**
+ * Tries a deferred or failed switch again.  Call from the task that calls
+ * clock_setProfile() while clock_pending() is true.
+ * @return True if the clock is now at the profile last asked for.
+ */
+bool clock_retry(void) {
+  return clock_setProfile(wanted);
+}
+
+/**
+ * Copies the switch and residency statistics, including the time spent in
+ * the current profile so far.
+ */
+void clock_getStats(clock_stats_t *out) {
+  uint32_t now = HAL_GetTick();
+  *out = stats;
+  out->residencyMs[current] += now - profileSince;
+  out->mhzMs += (uint64_t)(now - profileSince) * (profiles[current].hz / 1000000U);
+}
@@ -0,0 +1,87 @@
+#include "controlMetrics.h"
+#include "ramfunc.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void addError(ctrl_error_sums_t *s, float error) {
+  s->count++;
+  s->sum += error;
+  s->sumAbs += fabsf(error);
+  s->sumSq += error * error;
+}
+
+/**
+ * Clears the metrics; settle time is measured from nowMs.
+ */
+void ctrlMetrics_start(ctrl_metrics_t *m, uint32_t nowMs) {
+  memset(m, 0, sizeof(*m));
+  m->startMs = nowMs;
+}
+
+/**
+ * Adds one control tick.
+ * @param m The metrics of the axis.
+ * @param nowMs The time of the tick.
+ * @param target The setpoint, degrees.
+ * @param feedback The measured angle, degrees.
+ * @param ccr The pulse width after the tick, timer counts.
+ */
+RAMFUNC void ctrlMetrics_update(ctrl_metrics_t *m, uint32_t nowMs, float target, float feedback, int ccr) {
+  float error = target - feedback;
+
+  if (!m->started) {
+    m->started = true;
+    m->startError = error;
+    m->lastCcr = ccr;
+  }
+
+  //past the target means the error changed sign from the one it started with
+  float past = (m->startError >= 0) ? -error : error;
+  if (past > m->overshoot) {
+    m->overshoot = past;
+  }
+
+  m->travel += (uint32_t)abs(ccr - m->lastCcr);
+  m->lastCcr = ccr;
+
+  if (fabsf(error) <= CTRL_SETTLE_BAND_DEG) {
+    if (!m->settled) {
+      m->settled = true;
+      m->settledAtMs = nowMs;
+      memset(&m->tail, 0, sizeof(m->tail));
+    }
+    addError(&m->tail, error);
+  }
+  else {
+    m->settled = false;
+  }
+  addError(&m->all, error);
+}
+
+//Mean absolute error and RMS deviation from the mean error.
+static void errorStats(const ctrl_error_sums_t *s, float *meanAbs, float *jitter) {
+  if (s->count == 0) {
+    *meanAbs = 0;
+    *jitter = 0;
+    return;
+  }
+  float mean = s->sum / s->count;
+  float variance = s->sumSq / s->count - mean * mean;
+  *meanAbs = s->sumAbs / s->count;
+  *jitter = (variance > 0) ? sqrtf(variance) : 0;
+}
+
+void ctrlMetrics_report(const ctrl_metrics_t *m, ctrl_metrics_report_t *out) {
+  out->settleMs = m->settled ? m->settledAtMs - m->startMs : CTRL_NEVER_SETTLED;
+  out->overshootDeg = m->overshoot;
+  out->travelCounts = m->travel;
+  errorStats(&m->all, &out->runErrorDeg, &out->runJitterDeg);
+  if (m->settled) {
+    errorStats(&m->tail, &out->steadyErrorDeg, &out->jitterDeg);
+  }
+  else {
+    out->steadyErrorDeg = out->runErrorDeg;
+    out->jitterDeg = out->runJitterDeg;
+  }
+}
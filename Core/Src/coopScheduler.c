@@ -0,0 +1,148 @@
+#include "coopScheduler.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "cmsis_os.h"
+
+#define COOP_IDLE_TICKS 1000   //longest sleep when no routine has a deadline
+
+typedef struct {
+  coop_routine_t routine;
+  void (*onStop)(void);
+  coop_ctx_t ctx;
+  bool active;
+} coop_slot_t;
+
+static coop_slot_t slots[COOP_MAX_ROUTINES];
+static volatile uint32_t startRequests;
+static volatile uint32_t stopRequests;
+static osThreadId_t coopThread;
+
+uint32_t coop_now(void) {
+  return osKernelGetTickCount();
+}
+
+/**
+ * Registers a routine under a fixed id.  Must be called before the scheduler
+ * task starts; a registered routine stays idle until coop_start().
+ * @param id The slot of the routine, less than COOP_MAX_ROUTINES.
+ * @param routine The routine body.
+ * @param onStop Optional cleanup run in the scheduler task when the routine is
+ * stopped with coop_stop(), NULL if none.
+ */
+void coop_register(uint8_t id, coop_routine_t routine, void (*onStop)(void)) {
+  if (id >= COOP_MAX_ROUTINES) {
+    return;
+  }
+  slots[id].routine = routine;
+  slots[id].onStop = onStop;
+  slots[id].active = false;
+}
+
+/**
+ * Requests that a routine (re)start from its beginning.  Safe to call from
+ * any task or ISR; the request is applied by the scheduler task.
+ */
+void coop_start(uint8_t id) {
+  UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+  startRequests |= (1UL << id);
+  stopRequests &= ~(1UL << id);
+  taskEXIT_CRITICAL_FROM_ISR(saved);
+  coop_notify();
+}
+
+/**
+ * Requests that a routine stop.  Its onStop cleanup runs in the scheduler
+ * task before any other routine is resumed.
+ */
+void coop_stop(uint8_t id) {
+  UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+  stopRequests |= (1UL << id);
+  startRequests &= ~(1UL << id);
+  taskEXIT_CRITICAL_FROM_ISR(saved);
+  coop_notify();
+}
+
+/**
+ * Tells whether a routine is running or about to run.
+ */
+bool coop_isRunning(uint8_t id) {
+  uint32_t bit = 1UL << id;
+  if (stopRequests & bit) {
+    return false;
+  }
+  return slots[id].active || (startRequests & bit);
+}
+
+/**
+ * Wakes the scheduler so that every routine re-evaluates its wait condition.
+ * Safe to call from ISRs.
+ */
+void coop_notify(void) {
+  if (coopThread != NULL) {
+    osThreadFlagsSet(coopThread, COOP_NOTIFY_FLAG);
+  }
+}
+
+static void applyRequests(void) {
+  UBaseType_t saved = taskENTER_CRITICAL_FROM_ISR();
+  uint32_t starts = startRequests;
+  uint32_t stops = stopRequests;
+  startRequests = 0;
+  stopRequests = 0;
+  taskEXIT_CRITICAL_FROM_ISR(saved);
+
+  for (uint8_t i = 0; i < COOP_MAX_ROUTINES; ++i) {
+    uint32_t bit = 1UL << i;
+    if ((stops & bit) && slots[i].active) {
+      slots[i].active = false;
+      if (slots[i].onStop != NULL) {
+        slots[i].onStop();
+      }
+    }
+    if ((starts & bit) && slots[i].routine != NULL) {
+      slots[i].ctx.lc = 0;
+      slots[i].ctx.wakeTick = coop_now();
+      slots[i].active = true;
+    }
+  }
+}
+
+/**
+ * Runs the registered routines forever.  Call this as the body of the one RTOS
+ * task that hosts them.  Between passes the task sleeps until the earliest
+ * routine deadline or until coop_notify() is called.
+ */
+void coop_run(void) {
+  bool pollAll = true;
+  coopThread = osThreadGetId();
+
+  for (;;) {
+    applyRequests();
+
+    uint32_t now = coop_now();
+    uint32_t nextWake = now + COOP_IDLE_TICKS;
+
+    for (uint8_t i = 0; i < COOP_MAX_ROUTINES; ++i) {
+      coop_slot_t *slot = &slots[i];
+      if (!slot->active) {
+        continue;
+      }
+      if (pollAll || (int32_t)(now - slot->ctx.wakeTick) >= 0) {
+        if (slot->routine(&slot->ctx) == COOP_ENDED) {
+          slot->active = false;
+          continue;
+        }
+      }
+      if ((int32_t)(slot->ctx.wakeTick - nextWake) < 0) {
+        nextWake = slot->ctx.wakeTick;
+      }
+    }
+
+    int32_t wait = (int32_t)(nextWake - coop_now());
+    pollAll = false;
+    if (wait > 0) {
+      uint32_t flags = osThreadFlagsWait(COOP_NOTIFY_FLAG, osFlagsWaitAny, (uint32_t)wait);
+      pollAll = ((flags & osFlagsError) == 0);
+    }
+  }
+}
@@ -0,0 +1,97 @@
+#include "debouncer.h"
+#include "main.h"
+#include "eventHandler.h"
+#include "inputEvents.h"
+#include "ramfunc.h"
+
+static volatile uint8_t state;   //debounced levels, one bit per button, 1 = pressed
+static uint8_t cnt0, cnt1;       //the two bit planes of the vertical counter
+static uint8_t divider;
+static uint16_t holdMs[NUM_BUTTONS];
+static uint16_t repeatMs[NUM_BUTTONS];
+static volatile uint8_t enabled;
+
+//Reads every button at once as a bit mask with 1 meaning pressed.
+static uint8_t readButtons(void) {
+  uint32_t a = GPIOA->IDR;
+  uint32_t b = GPIOB->IDR;
+  uint8_t raw = 0;
+
+  if (!(a & on_off_mode_Pin))   raw |= 1U << BUTTON_MODE;
+  if (!(a & button_up_Pin))     raw |= 1U << BUTTON_UP;
+  if (!(a & button_down_Pin))   raw |= 1U << BUTTON_DOWN;
+  if (!(b & button_left_Pin))   raw |= 1U << BUTTON_LEFT;
+  if (!(b & button_right_Pin))  raw |= 1U << BUTTON_RIGHT;
+  if (a & button_capture_Pin)   raw |= 1U << BUTTON_CAPTURE;
+
+  return raw;
+}
+
+/**
+ * Starts sampling.  Call after the button GPIOs are configured; buttons that
+ * are already held at this point do not produce a press.
+ */
+void debouncer_init(void) {
+  state = readButtons();
+  cnt0 = cnt1 = 0;
+  enabled = 1;
+}
+
+/**
+ * Call from the 1 kHz time base interrupt.
+ */
+RAMFUNC void debouncer_sample(void) {
+  if (!enabled || ++divider < DEBOUNCE_SAMPLE_MS) {
+    return;
+  }
+  divider = 0;
+
+  /*
+   * Vertical counter: each bit position counts consecutive samples that
+   * differ from the debounced level, and resets as soon as they agree.  The
+   * level toggles when a counter rolls over after four samples.
+   */
+  uint8_t delta = readButtons() ^ state;
+  cnt1 = (cnt1 ^ cnt0) & delta;
+  cnt0 = ~cnt0 & delta;
+  uint8_t toggle = delta & ~(cnt0 | cnt1);
+  state ^= toggle;
+
+  uint8_t queued = 0;
+
+  for (uint8_t bits = toggle; bits; bits &= bits - 1) {
+    uint8_t button = __builtin_ctz(bits);
+    holdMs[button] = 0;
+    repeatMs[button] = 0;
+    queued |= inputEvents_push(button, (state & (1U << button)) ? EDGE_PRESS : EDGE_RELEASE);
+  }
+
+  //Only buttons that are being held need hold timing.
+  for (uint8_t bits = state & ~toggle; bits; bits &= bits - 1) {
+    uint8_t button = __builtin_ctz(bits);
+    if (holdMs[button] < LONG_PRESS_MS) {
+      holdMs[button] += DEBOUNCE_SAMPLE_MS;
+      if (holdMs[button] >= LONG_PRESS_MS) {
+        queued |= inputEvents_push(button, EDGE_LONG_PRESS);
+      }
+    }
+    else {
+      repeatMs[button] += DEBOUNCE_SAMPLE_MS;
+      if (repeatMs[button] >= REPEAT_MS) {
+        repeatMs[button] = 0;
+        queued |= inputEvents_push(button, EDGE_REPEAT);
+      }
+    }
+  }
+
+  if (queued) {
+    osEventFlagsSet(setPointButtonEvents, INPUT_EVENT_FLAG);
+  }
+}
+
+/**
+ * Returns the debounced button levels, one bit per button id, 1 = pressed.
+ */
+uint8_t debouncer_pressed(void) {
+  return state;
+}
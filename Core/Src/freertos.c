@@ -25,6 +25,7 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "blackBox.h"
 
 /* USER CODE END Includes */
 
@@ -55,6 +56,21 @@
 
 /* Private application code --------------------------------------------------*/
 /* USER CODE BEGIN Application */
+/**
+ * Called by the kernel on a context switch when a task has run past the end
+ * of its stack.  Records the overflow in the black box and stops; the
+ * watchdog resets the chip.
+ * @param xTask the task that overflowed
+ * @param pcTaskName its name
+ */
+void vApplicationStackOverflowHook(TaskHandle_t xTask, char *pcTaskName)
+{
+  (void)xTask;
+  (void)pcTaskName;
+  blackbox_freeze(BB_FREEZE_STACK);
+  taskDISABLE_INTERRUPTS();
+  for( ;; );
+}
 
 /* USER CODE END Application */
 
@@ -0,0 +1,72 @@
+#include "gimbalParams.h"
+#include "paramStore.h"
+#include <math.h>
+#include <string.h>
+
+static bool isGain(uint8_t key) {
+  return key <= PARAM_KD_ROLL;
+}
+
+/**
+ * Tells whether a value is in the accepted range of its key.  Only the key
+ * itself is looked at; see gimbalParams_sanitize() for the limits that must
+ * also be ordered.
+ * @param key One of the PARAM_ keys.
+ * @param value The raw 32-bit value, float bits for the gains.
+ */
+bool gimbalParams_inRange(uint8_t key, uint32_t value) {
+  float gain;
+
+  if (isGain(key)) {
+    memcpy(&gain, &value, sizeof(gain));
+    return isfinite(gain) && gain >= 0.0f && gain <= PARAM_GAIN_MAX;
+  }
+  switch (key) {
+  case PARAM_PWM_LOW:
+  case PARAM_PWM_HIGH:
+  case PARAM_PWM_LOW_YAW:
+  case PARAM_PWM_HIGH_YAW:
+    return value >= PARAM_PULSE_MIN && value <= PARAM_PULSE_MAX;
+  case PARAM_CONTROL_PERIOD:
+  case PARAM_IMU_PERIOD:
+  case PARAM_CINEMATIC_PERIOD:
+    return value != 0 && value <= PARAM_PERIOD_MAX;
+  case PARAM_CINEMATIC_PITCH:
+  case PARAM_CINEMATIC_ROLL:
+    return (int32_t)value >= -PARAM_OFFSET_MAX && (int32_t)value <= PARAM_OFFSET_MAX;
+  default:
+    return false;
+  }
+}
+
+//Falls back to the defaults of a low/high pair that is out of order.
+static uint8_t sanitizePair(uint8_t low, uint8_t high, const uint32_t *defaults) {
+  if (params_get(low) < params_get(high)) {
+    return 0;
+  }
+  params_stage(low, defaults[low]);
+  params_stage(high, defaults[high]);
+  return 2;
+}
+
+/**
+ * Replaces every loaded value that is out of range, and both limits of a
+ * pulse range that is out of order, with its default.  The defaults are
+ * staged in RAM only, so flash is not written at boot; the next commit from
+ * the tuning link stores them.  Call after params_init().
+ * @param defaults One value per key, as passed to params_init().
+ * @return The number of values replaced.
+ */
+uint8_t gimbalParams_sanitize(const uint32_t *defaults) {
+  uint8_t replaced = 0;
+
+  for (uint8_t key = 0; key < PARAM_COUNT; key++) {
+    if (!gimbalParams_inRange(key, params_get(key))) {
+      params_stage(key, defaults[key]);
+      replaced++;
+    }
+  }
+  replaced += sanitizePair(PARAM_PWM_LOW, PARAM_PWM_HIGH, defaults);
+  replaced += sanitizePair(PARAM_PWM_LOW_YAW, PARAM_PWM_HIGH_YAW, defaults);
+  return replaced;
+}
@@ -0,0 +1,22 @@
+#include "gimbalStates.h"
+#include <stddef.h>
+
+const sm_state_t gimbalStates[GIMBAL_NUM_STATES] = {
+  /* GIMBAL_OFF       */ { SM_NONE,       enterOFF,       NULL },
+  /* GIMBAL_ACTIVE    */ { SM_NONE,       enterACTIVE,    exitACTIVE },
+  /* GIMBAL_BOOTING   */ { GIMBAL_ACTIVE, enterBOOTING,   exitBOOTING },
+  /* GIMBAL_STABILIZE */ { GIMBAL_ACTIVE, enterSTABILIZE, exitSTABILIZE },
+  /* GIMBAL_CINEMATIC */ { GIMBAL_ACTIVE, enterCINEMATIC, exitCINEMATIC },
+  /* GIMBAL_FAULT     */ { SM_NONE,       enterFAULT,     NULL },
+};
+
+#define NO_TRANSITION { SM_NONE, NULL, NULL }
+const sm_transition_t gimbalTransitions[GIMBAL_NUM_STATES][EV_NUM_EVENTS] = {
+  /*                     EV_MODE_BUTTON                                       EV_LOW_BATTERY            EV_IMU_FAULT                EV_CALIBRATION_DONE               EV_DEADLINE_MISS */
+  /* GIMBAL_OFF       */ { { GIMBAL_BOOTING,   modeChangeAllowed, markModeChange }, NO_TRANSITION,            NO_TRANSITION,              NO_TRANSITION,                    NO_TRANSITION },
+  /* GIMBAL_ACTIVE    */ { NO_TRANSITION,                                          { GIMBAL_OFF, NULL, NULL }, { GIMBAL_FAULT, NULL, NULL }, NO_TRANSITION,                    { GIMBAL_FAULT, NULL, NULL } },
+  /* GIMBAL_BOOTING   */ { { GIMBAL_CINEMATIC, modeChangeAllowed, markModeChange }, NO_TRANSITION,            NO_TRANSITION,              { GIMBAL_STABILIZE, NULL, NULL }, NO_TRANSITION },
+  /* GIMBAL_STABILIZE */ { { GIMBAL_CINEMATIC, modeChangeAllowed, markModeChange }, NO_TRANSITION,            NO_TRANSITION,              NO_TRANSITION,                    NO_TRANSITION },
+  /* GIMBAL_CINEMATIC */ { { GIMBAL_OFF,       modeChangeAllowed, markModeChange }, NO_TRANSITION,            NO_TRANSITION,              NO_TRANSITION,                    NO_TRANSITION },
+  /* GIMBAL_FAULT     */ { { GIMBAL_OFF,       modeChangeAllowed, markModeChange }, NO_TRANSITION,            NO_TRANSITION,              NO_TRANSITION,                    NO_TRANSITION },
+};
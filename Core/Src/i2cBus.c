@@ -0,0 +1,217 @@
+#include "i2cBus.h"
+
+static I2C_HandleTypeDef *bus;
+static uint8_t budget;
+static bool cycleFailed;
+static i2cbus_stats_t stats;
+
+typedef enum {
+  OP_WRITE,
+  OP_WRITE_READ
+} i2cbus_op_t;
+
+/**
+ * @param hi2c An initialized I2C handle.  Its Init settings are reused
+ * whenever the peripheral is re-initialized after an error.
+ */
+void i2cbus_init(I2C_HandleTypeDef *hi2c) {
+  bus = hi2c;
+  i2cbus_newCycle();
+}
+
+/**
+ * Starts a new cycle of the calling task: refills the retry budget.
+ */
+void i2cbus_newCycle(void) {
+  budget = I2CBUS_RETRY_BUDGET;
+  cycleFailed = false;
+}
+
+/**
+ * Tells whether every transfer since i2cbus_newCycle() succeeded, i.e.
+ * whether the data read in this cycle can be trusted.
+ */
+bool i2cbus_cycleOk(void) {
+  return !cycleFailed;
+}
+
+//Busy-waits on the cycle counter, which inputEvents_init() starts.
+static void delayUs(uint32_t us) {
+  uint32_t start = DWT->CYCCNT;
+  uint32_t cycles = us * (SystemCoreClock / 1000000);
+  while (DWT->CYCCNT - start < cycles) {
+  }
+}
+
+static i2cbus_result_t classify(HAL_StatusTypeDef status) {
+  uint32_t error = HAL_I2C_GetError(bus);
+
+  if (status == HAL_BUSY) {
+    return I2CBUS_BUSY;
+  }
+  if (error & HAL_I2C_ERROR_AF) {
+    return I2CBUS_NACK;
+  }
+  if (error & (HAL_I2C_ERROR_BERR | HAL_I2C_ERROR_ARLO | HAL_I2C_ERROR_OVR)) {
+    return I2CBUS_BUS_ERROR;
+  }
+  return I2CBUS_TIMEOUT;
+}
+
+static void count(i2cbus_result_t result) {
+  switch (result) {
+  case I2CBUS_NACK:      stats.nacks++;     break;
+  case I2CBUS_BUS_ERROR: stats.busErrors++; break;
+  case I2CBUS_TIMEOUT:   stats.timeouts++;  break;
+  case I2CBUS_BUSY:      stats.busy++;      break;
+  default:                                  break;
+  }
+}
+
+/*
+ * Frees a bus held by a slave that lost track of a transfer: with the pins
+ * taken over as open-drain outputs, SCL is pulsed until the slave releases
+ * SDA, then a STOP is sent.  The peripheral is re-initialized afterwards,
+ * which also clears its BUSY flag.
+ * Returns false if SCL or SDA are still held low.
+ */
+static bool recover(void) {
+  GPIO_InitTypeDef gpio = {0};
+  bool released;
+
+  HAL_I2C_DeInit(bus);
+
+  HAL_GPIO_WritePin(I2CBUS_SCL_PORT, I2CBUS_SCL_PIN, GPIO_PIN_SET);
+  HAL_GPIO_WritePin(I2CBUS_SDA_PORT, I2CBUS_SDA_PIN, GPIO_PIN_SET);
+  gpio.Mode = GPIO_MODE_OUTPUT_OD;
+  gpio.Pull = GPIO_NOPULL;
+  gpio.Speed = GPIO_SPEED_FREQ_HIGH;
+  gpio.Pin = I2CBUS_SCL_PIN;
+  HAL_GPIO_Init(I2CBUS_SCL_PORT, &gpio);
+  gpio.Pin = I2CBUS_SDA_PIN;
+  HAL_GPIO_Init(I2CBUS_SDA_PORT, &gpio);
+  delayUs(I2CBUS_HALF_BIT_US);
+
+  if (HAL_GPIO_ReadPin(I2CBUS_SDA_PORT, I2CBUS_SDA_PIN) == GPIO_PIN_RESET) {
+    stats.busClears++;
+    for (uint8_t i = 0; i < I2CBUS_CLEAR_PULSES; i++) {
+      HAL_GPIO_WritePin(I2CBUS_SCL_PORT, I2CBUS_SCL_PIN, GPIO_PIN_RESET);
+      delayUs(I2CBUS_HALF_BIT_US);
+      HAL_GPIO_WritePin(I2CBUS_SCL_PORT, I2CBUS_SCL_PIN, GPIO_PIN_SET);
+      delayUs(I2CBUS_HALF_BIT_US);
+      if (HAL_GPIO_ReadPin(I2CBUS_SDA_PORT, I2CBUS_SDA_PIN) == GPIO_PIN_SET) {
+        break;
+      }
+    }
+  }
+
+  //STOP: SDA rises while SCL is high
+  HAL_GPIO_WritePin(I2CBUS_SDA_PORT, I2CBUS_SDA_PIN, GPIO_PIN_RESET);
+  delayUs(I2CBUS_HALF_BIT_US);
+  HAL_GPIO_WritePin(I2CBUS_SDA_PORT, I2CBUS_SDA_PIN, GPIO_PIN_SET);
+  delayUs(I2CBUS_HALF_BIT_US);
+
+  released = HAL_GPIO_ReadPin(I2CBUS_SCL_PORT, I2CBUS_SCL_PIN) == GPIO_PIN_SET
+          && HAL_GPIO_ReadPin(I2CBUS_SDA_PORT, I2CBUS_SDA_PIN) == GPIO_PIN_SET;
+  if (!released) {
+    stats.stuckBus++;
+  }
+
+  //the MSP init hands the pins back to the peripheral
+  HAL_I2C_Init(bus);
+  stats.reinits++;
+  return released;
+}
+
+#define START_BITS 1
+#define STOP_BITS 1
+#define BYTE_BITS 9     //8 data bits and the ACK
+
+/**
+ * Bus time of a write of len data bytes: START, address, data, STOP.
+ * @return SCL periods; divide by I2CBUS_BUS_HZ for seconds.
+ */
+uint32_t i2cbus_writeBits(uint16_t len) {
+  return START_BITS + BYTE_BITS * (1 + len) + STOP_BITS;
+}
+
+/**
+ * Bus time of a register read of len bytes as one transaction: START,
+ * address, register, repeated START, address, data, STOP.  Done as a
+ * write followed by a separate read it would cost one STOP and one START
+ * more.
+ */
+uint32_t i2cbus_writeReadBits(uint16_t len) {
+  return START_BITS + BYTE_BITS * 2 + START_BITS + BYTE_BITS * (1 + len) + STOP_BITS;
+}
+
+static HAL_StatusTypeDef attempt(i2cbus_op_t op, uint16_t addr, uint8_t reg,
+                                 uint8_t *data, uint16_t len) {
+  //a bus still busy from a failed transfer would cost HAL's 25 ms BUSY wait
+  if (__HAL_I2C_GET_FLAG(bus, I2C_FLAG_BUSY)) {
+    return HAL_BUSY;
+  }
+  if (op == OP_WRITE) {
+    stats.busBits += i2cbus_writeBits(len);
+    return HAL_I2C_Master_Transmit(bus, addr, data, len, I2CBUS_TIMEOUT_MS);
+  }
+  stats.busBits += i2cbus_writeReadBits(len);
+  return HAL_I2C_Mem_Read(bus, addr, reg, I2C_MEMADD_SIZE_8BIT, data, len, I2CBUS_TIMEOUT_MS);
+}
+
+static i2cbus_result_t transfer(i2cbus_op_t op, uint8_t addr, uint8_t reg,
+                                uint8_t *data, uint16_t len) {
+  if (cycleFailed && budget == 0) {
+    stats.skipped++;
+    return I2CBUS_SKIPPED;
+  }
+  stats.transfers++;
+
+  for (;;) {
+    HAL_StatusTypeDef status = attempt(op, (uint16_t)(addr << 1), reg, data, len);
+    if (status == HAL_OK) {
+      return I2CBUS_OK;
+    }
+
+    i2cbus_result_t result = classify(status);
+    count(result);
+    if (budget == 0) {
+      stats.budgetExhausted++;
+      stats.failures++;
+      cycleFailed = true;
+      return result;
+    }
+    budget--;
+    stats.retries++;
+
+    //a NACK leaves the bus idle; anything else may have left it hung
+    if (result != I2CBUS_NACK && !recover()) {
+      budget = 0;
+      stats.budgetExhausted++;
+      stats.failures++;
+      cycleFailed = true;
+      return result;
+    }
+  }
+}
+
+/**
+ * Writes len bytes to a device.
+ * @param addr 7-bit device address.
+ */
+i2cbus_result_t i2cbus_write(uint8_t addr, const uint8_t *data, uint16_t len) {
+  return transfer(OP_WRITE, addr, 0, (uint8_t *)data, len);
+}
+
+/**
+ * Reads len bytes starting at a register, in one transaction with a
+ * repeated START.
+ * @param addr 7-bit device address.
+ */
+i2cbus_result_t i2cbus_writeRead(uint8_t addr, uint8_t reg, uint8_t *data, uint16_t len) {
+  return transfer(OP_WRITE_READ, addr, reg, data, len);
+}
+
+void i2cbus_getStats(i2cbus_stats_t *out) {
+  *out = stats;
+}
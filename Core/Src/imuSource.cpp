@@ -0,0 +1,90 @@
+#include "imuSource.h"
+#include "fastMath.h"
+
+SyntheticImu::SyntheticImu(Axis x, Axis y, Axis z, float noiseDeg)
+  : axes{x, y, z}, noiseDeg(noiseDeg), seed(1), startMs(0), started(false) {}
+
+bool SyntheticImu::begin()
+{
+  started = false;
+  return true;
+}
+
+//Uniform noise in [-noiseDeg, noiseDeg] from a fixed-seed LCG, so runs repeat.
+float SyntheticImu::noise()
+{
+  seed = seed * 1664525u + 1013904223u;
+  return noiseDeg * ((float)(seed >> 8) / (float)(1u << 23) - 1.0f);
+}
+
+bool SyntheticImu::read(uint32_t nowMs, bno055_vector_t *out)
+{
+  float angle[3];
+
+  if (!started) {
+    startMs = nowMs;
+    started = true;
+  }
+  float t = (float)(nowMs - startMs);
+  for (int i = 0; i < 3; i++) {
+    angle[i] = axes[i].center + noise();
+    if (axes[i].periodMs > 0) {
+      angle[i] += axes[i].amplitude * fast_sinf(FAST_TWO_PI * t / axes[i].periodMs);
+    }
+  }
+
+  //heading wraps like the BNO055's, 0 to 360
+  out->x = fast_wrap360(angle[0]);
+  out->y = angle[1];
+  out->z = angle[2];
+  out->w = 0;
+  return true;
+}
+
+ReplayImu::ReplayImu(const imu_replay_sample_t *samples, size_t count, bool loop)
+  : samples(samples), count(count), next(0), loop(loop), startMs(0), started(false) {}
+
+bool ReplayImu::begin()
+{
+  next = 0;
+  started = false;
+  return count > 0;
+}
+
+/**
+ * Returns the latest sample due at nowMs.  Fails before the first sample
+ * is due and, unless the recording loops, after the last one.
+ */
+bool ReplayImu::read(uint32_t nowMs, bno055_vector_t *out)
+{
+  if (count == 0) {
+    return false;
+  }
+  if (!started) {
+    startMs = nowMs;
+    started = true;
+  }
+
+  uint32_t elapsed = nowMs - startMs;
+  if (elapsed > samples[count - 1].tMs) {
+    if (!loop) {
+      return false;
+    }
+    startMs = nowMs;
+    elapsed = 0;
+    next = 0;
+  }
+  while (next < count && samples[next].tMs <= elapsed) {
+    next++;
+  }
+  if (next == 0) {
+    return false;
+  }
+
+  const imu_replay_sample_t *s = &samples[next - 1];
+  out->x = s->x;
+  out->y = s->y;
+  out->z = s->z;
+  out->w = 0;
+  return true;
+}
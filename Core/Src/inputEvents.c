@@ -0,0 +1,72 @@
+#include "inputEvents.h"
+#include "stm32l4xx_hal.h"
+#include "ramfunc.h"
+
+static input_event_t ring[INPUT_QUEUE_LEN];
+static volatile uint32_t head;   //written by the producer only
+static volatile uint32_t tail;   //written by the consumer only
+
+volatile uint32_t inputEventsDropped;
+input_latency_t inputLatency[NUM_BUTTONS];
+
+/**
+ * Starts the DWT cycle counter used to timestamp events.
+ */
+void inputEvents_init(void) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/**
+ * Producer side: appends an event stamped with the current cycle count.
+ * @return False if the ring was full and the event was dropped.
+ */
+RAMFUNC bool inputEvents_push(uint8_t button, uint8_t edge) {
+  uint32_t h = head;
+  if (h - tail >= INPUT_QUEUE_LEN) {
+    inputEventsDropped++;
+    return false;
+  }
+  input_event_t *ev = &ring[h & (INPUT_QUEUE_LEN - 1)];
+  ev->button = button;
+  ev->edge = edge;
+  ev->stamp = DWT->CYCCNT;
+  //publish the slot contents before the new head
+  __DMB();
+  head = h + 1;
+  return true;
+}
+
+/**
+ * Consumer side: removes the oldest event.
+ * @return False if the ring was empty.
+ */
+bool inputEvents_pop(input_event_t *ev) {
+  uint32_t t = tail;
+  if (t == head) {
+    return false;
+  }
+  __DMB();
+  *ev = ring[t & (INPUT_QUEUE_LEN - 1)];
+  __DMB();
+  tail = t + 1;
+  return true;
+}
+
+/**
+ * Records the time from an event's edge until now, the point at which the
+ * consumer has finished acting on it.
+ */
+void inputEvents_recordLatency(const input_event_t *ev) {
+  uint32_t cyclesPerUs = SystemCoreClock / 1000000U;
+  uint32_t us = (DWT->CYCCNT - ev->stamp) / cyclesPerUs;
+  input_latency_t *lat = &inputLatency[ev->button];
+
+  lat->count++;
+  lat->lastUs = us;
+  lat->totalUs += us;
+  if (us > lat->maxUs) {
+    lat->maxUs = us;
+  }
+}
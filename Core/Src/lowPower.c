@@ -0,0 +1,193 @@
+#include "lowPower.h"
+#include "main.h"
+#include "clockGovernor.h"
+#include "analogMonitor.h"
+#include "debouncer.h"
+#include "inputEvents.h"
+#include "tuningLink.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+static volatile bool stopAllowed;
+static volatile bool buttonWake;
+static volatile uint32_t buttonWakeTick;
+static volatile bool rxWake;
+static volatile uint32_t rxWakeTick;
+static lowpower_stats_t stats;
+
+/**
+ * Sets up LPTIM1 on the LSE and the interrupts used to leave STOP2.
+ */
+void lowPower_init(void) {
+  __HAL_RCC_LPTIM1_CLK_ENABLE();
+  __HAL_RCC_SYSCFG_CLK_ENABLE();
+  MODIFY_REG(RCC->CCIPR, RCC_CCIPR_LPTIM1SEL, RCC_CCIPR_LPTIM1SEL);   //LSE
+
+  //LPTIM1 wakes the chip through EXTI line 32
+  EXTI->IMR2 |= EXTI_IMR2_IM32;
+  HAL_NVIC_SetPriority(LPTIM1_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(LPTIM1_IRQn);
+
+  //PA4 on EXTI line 4, only unmasked while stopped
+  MODIFY_REG(SYSCFG->EXTICR[1], SYSCFG_EXTICR2_EXTI4, SYSCFG_EXTICR2_EXTI4_PA);
+  EXTI->FTSR1 |= EXTI_FTSR1_FT4;
+  HAL_NVIC_SetPriority(EXTI4_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(EXTI4_IRQn);
+
+  //PA15, the USART2 RX pin, on EXTI line 15, also only unmasked while stopped
+  MODIFY_REG(SYSCFG->EXTICR[3], SYSCFG_EXTICR4_EXTI15, SYSCFG_EXTICR4_EXTI15_PA);
+  EXTI->FTSR1 |= EXTI_FTSR1_FT15;
+  HAL_NVIC_SetPriority(EXTI15_10_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
+}
+
+/**
+ * Allows or forbids STOP2 in idle.  Forbid it before leaving CLOCK_LOW.
+ */
+void lowPower_allowStop(bool allow) {
+  stopAllowed = allow;
+}
+
+/**
+ * Call when the gimbal becomes active.  If a button press woke it from
+ * STOP2, records how long the power-up took.
+ */
+void lowPower_markActive(void) {
+  if (!buttonWake) {
+    return;
+  }
+  buttonWake = false;
+  stats.lastWakeToActiveMs = HAL_GetTick() - buttonWakeTick;
+  if (stats.lastWakeToActiveMs > stats.maxWakeToActiveMs) {
+    stats.maxWakeToActiveMs = stats.lastWakeToActiveMs;
+  }
+}
+
+void lowPower_getStats(lowpower_stats_t *out) {
+  *out = stats;
+}
+
+static void startWakeTimer(uint32_t counts) {
+  LPTIM1->ICR = LPTIM_ICR_CMPMCF | LPTIM_ICR_ARRMCF | LPTIM_ICR_CMPOKCF | LPTIM_ICR_ARROKCF;
+  LPTIM1->IER = LPTIM_IER_CMPMIE;   //IER is only writable while disabled
+  LPTIM1->CR = LPTIM_CR_ENABLE;
+  LPTIM1->ARR = 0xFFFF;
+  while (!(LPTIM1->ISR & LPTIM_ISR_ARROK));
+  LPTIM1->CMP = counts;
+  while (!(LPTIM1->ISR & LPTIM_ISR_CMPOK));
+  LPTIM1->CR |= LPTIM_CR_SNGSTRT;
+}
+
+//Counter reads are only reliable when two in a row agree.
+static uint32_t wakeTimerCount(void) {
+  uint32_t a, b;
+  do {
+    a = LPTIM1->CNT;
+    b = LPTIM1->CNT;
+  } while (a != b);
+  return a;
+}
+
+//STOP2 would make USART2 deaf to a tuning session, or to one starting.
+static bool linkNeedsUart(void) {
+  return tuning_sessionActive() || (rxWake && HAL_GetTick() - rxWakeTick < LOWPOWER_RX_WAKE_MS);
+}
+
+//The debouncer samples on the time base, which STOP2 stops.  After a button
+//wake, keep it running until the press is debounced, and while the button
+//is held so that its release and long press are seen too.
+static bool buttonNeedsTimeBase(void) {
+  return (debouncer_pressed() & (1U << BUTTON_MODE))
+      || (buttonWake && HAL_GetTick() - buttonWakeTick < LOWPOWER_BUTTON_WAKE_MS);
+}
+
+/*
+ * Replaces the FreeRTOS port's tickless idle (configUSE_TICKLESS_IDLE 2).
+ * Called by the idle task with the scheduler suspended.
+ */
+void vPortSuppressTicksAndSleep(TickType_t xExpectedIdleTime) {
+  if (!stopAllowed || clock_profile() != CLOCK_LOW || linkNeedsUart() || buttonNeedsTimeBase()) {
+    __DSB();
+    __WFI();
+    __ISB();
+    return;
+  }
+
+  if (xExpectedIdleTime > LOWPOWER_MAX_STOP_TICKS) {
+    xExpectedIdleTime = LOWPOWER_MAX_STOP_TICKS;
+  }
+
+  __disable_irq();
+  __DSB();
+  __ISB();
+  if (eTaskConfirmSleepModeStatus() == eAbortSleep) {
+    __enable_irq();
+    return;
+  }
+
+  SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+  HAL_SuspendTick();
+  analogMonitor_suspend();
+
+  startWakeTimer(xExpectedIdleTime * LOWPOWER_LSE_HZ / configTICK_RATE_HZ);
+  EXTI->PR1 = EXTI_PR1_PIF4 | EXTI_PR1_PIF15;
+  EXTI->IMR1 |= EXTI_IMR1_IM4 | EXTI_IMR1_IM15;
+
+  HAL_PWREx_EnterSTOP2Mode(PWR_STOPENTRY_WFI);
+
+  uint32_t restoreStart = DWT->CYCCNT;
+  EXTI->IMR1 &= ~(EXTI_IMR1_IM4 | EXTI_IMR1_IM15);
+  uint32_t elapsed = wakeTimerCount() * configTICK_RATE_HZ / LOWPOWER_LSE_HZ;
+  LPTIM1->CR = 0;
+  if (elapsed > xExpectedIdleTime) {
+    elapsed = xExpectedIdleTime;
+  }
+
+  //account for the stopped time in both tick counts
+  vTaskStepTick(elapsed);
+  uwTick += elapsed;
+
+  analogMonitor_resume();
+  HAL_ResumeTick();
+  SysTick->VAL = 0;
+  SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+  stats.stopEntries++;
+  stats.stopMs += elapsed;
+  stats.lastRestoreUs = (DWT->CYCCNT - restoreStart) / (SystemCoreClock / 1000000U);
+  if (stats.lastRestoreUs > stats.maxRestoreUs) {
+    stats.maxRestoreUs = stats.lastRestoreUs;
+  }
+
+  //pending wake-up interrupts run here
+  __enable_irq();
+}
+
+/**
+ * Call from LPTIM1_IRQHandler.
+ */
+void lowPower_lptimIrq(void) {
+  LPTIM1->ICR = LPTIM_ICR_CMPMCF;
+}
+
+/**
+ * Call from EXTI4_IRQHandler.  The press itself is picked up by the
+ * debouncer once the time base runs again; STOP2 is held off until it is.
+ */
+void lowPower_extiIrq(void) {
+  EXTI->PR1 = EXTI_PR1_PIF4;
+  buttonWake = true;
+  buttonWakeTick = HAL_GetTick();
+  stats.buttonWakes++;
+}
+
+/**
+ * Call from EXTI15_10_IRQHandler.  A start bit on the tuning link woke the
+ * chip; stay out of STOP2 until the host resends the frame.
+ */
+void lowPower_rxWakeIrq(void) {
+  EXTI->PR1 = EXTI_PR1_PIF15;
+  rxWake = true;
+  rxWakeTick = HAL_GetTick();
+  stats.rxWakes++;
+}
@@ -24,14 +24,50 @@
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include <stdio.h>
+#include <math.h>
+#include <string.h>
 #include "bno055_stm32.h"
+#include "imuSource.h"
+#include "bno055Imu.h"
 #include "PID.h"
 #include "stm32l4xx_it.h"
 #include "eventHandler.h"
+#include "coopScheduler.h"
+#include "stateMachine.h"
+#include "gimbalStates.h"
+#include "inputEvents.h"
+#include "debouncer.h"
+#include "motionProfile.h"
+#include "analogMonitor.h"
+#include "socEstimator.h"
+#include "clockGovernor.h"
+#include "lowPower.h"
+#include "ramfunc.h"
+#include "paramStore.h"
+#include "gimbalDefaults.h"
+#include "gimbalParams.h"
+#include "tuningLink.h"
+#include "blackBox.h"
+#include "supervisor.h"
+#include "i2cBus.h"
+#include "sampleAge.h"
+#include "servoOutput.h"
+#include "axisMath.h"
+#include "benchRunner.h"
+#include "controlMetrics.h"
+#include "fastMath.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
 /* USER CODE BEGIN PTD */
+/* DWT cycle counts of a piece of periodic work */
+typedef struct {
+  uint32_t last;
+  uint32_t max;
+  uint64_t total;
+  uint32_t count;
+} cycle_stats_t;
+
 #ifdef __GNUC__
   /* With GCC, small printf (option LD Linker->Libraries->Small printf
      set to 'Yes') calls __io_putchar() */
@@ -43,36 +79,56 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
-#define PWM_HIGH 20315.85
-#define PWM_LOW 6500
-#define PWM_MID 12000
-#define PWM_HIGH_Y 18000
-#define PWM_LOW_Y 8000
-#define KP_y 2.3
-#define KD_y 0.0005
-#define KI_y 0.008
-#define KP_p 3.1
-#define KD_p 0.0005
-#define KI_p 0.008
-#define KP_r 3.1
-#define KD_r 0.0005
-#define KI_r 0.008
-
-#define debounceDelay 50
+#define SLEW_START_VEL 15.0f     //deg/s as soon as a direction is held
+#define SLEW_MAX_VEL 120.0f      //deg/s after SLEW_RAMP_MS of holding
+#define SLEW_RAMP_MS 1500
+#define SLEW_ACCEL 400.0f        //deg/s^2, also brakes on release
+#define SLEW_MAX_DT_MS 50
 #define modeChangeDelay 1200
-#define OFF_STATE 0
-#define ON_STATE 1
-#define UNIQUE_STATE 2
-#define OFF_NUM_THREADS 4
-#define ON_NUM_THREADS 3
-#define UNIQUE_NUM_THREADS1 3
-#define UNIQUE_NUM_THREADS2 1
-#define CONTROL_FREQ 3
-#define IMU_FREQ 3
-#define UNIQUE_FREQ 10
+#define GATE_CTRL 0x01
+#define GATE_IMU 0x02
+#define IDLE_CONTROL_PERIOD 20    //control period while the camera is still
+#define IDLE_SETTLE_MS 1000       //time within IDLE_ERROR_DEG before going idle
+#define IDLE_ERROR_DEG 1.0f
+#define IDLE_WAKE_ERROR_DEG 2.0f
+#define IDLE_MOTION_DEG 0.5f      //IMU change between samples that wakes the loop
+#define CCR_DEADBAND 40           //smaller corrections are dropped while idle
+#define IDLE_PWM_STOP_AXES 0      //axes left unpowered while idle: 1 yaw, 2 pitch, 4 roll
+#define CTRL_WAKE_FLAG 0x01
 #define NUMOFBLINKS 100
-#define ROTATIONOFFSET 360
-#define PWM_HYSTERESIS 3000
+#define BOOTBLINK_PERIOD 20
+#define COOP_LED_BATT 0
+#define COOP_BOOT_ANIMATION 1
+#define COOP_CINEMATIC 2
+#define COOP_SOC 3
+#define COOP_TUNING 4
+#define COOP_BLACKBOX_DUMP 5
+#define COOP_SUPERVISOR 6
+#define SUP_CONTROL 0                 //supervised tasks
+#define SUP_IMU 1
+#define SUP_NUM_TASKS 2
+#define SUP_CONTROL_DEADLINE 50       //covers the idle control period
+#define SUP_IMU_DEADLINE 50           //above a cycle that spends its whole I2C retry budget
+#define SUP_IMU_SETUP_DEADLINE 3000   //bno055_setup() sleeps about 1.5 s
+#define IMU_FAILED_CYCLES 20          //consecutive failed reads before an IMU fault
+#define IMU_BACKEND_BNO055 0          //orientation sources, see imuSource.h
+#define IMU_BACKEND_SYNTHETIC 1
+#define IMU_BACKEND_REPLAY 2          //plays Core/Inc/imuReplayData.h, see Tools/imu_replay_header.py
+#ifndef IMU_BACKEND
+#define IMU_BACKEND IMU_BACKEND_BNO055
+#endif
+#define SUP_CHECK_PERIOD 10
+#define SUP_CHECK_SLEEP_PERIOD 2000   //in OFF and FAULT, where STOP2 is allowed
+#define WATCHDOG_MS 500
+#define WATCHDOG_SLEEP_MS 8000        //longer than SUP_CHECK_SLEEP_PERIOD with LSI tolerance
+#define TUNING_IDLE_WAIT 1000         //longest sleep of the tuning routine with telemetry off
+#define TELEMETRY_MIN_PERIOD 20       //a telemetry frame takes ~4 ms at 115200 baud
+#define SOC_PERIOD 100
+#define SOC_OFF_PERIOD 5000           //keeps the chip in STOP2 while OFF
+#define LOAD_IDLE_MA 60.0f            //MCU, IMU and LEDs
+#define LOAD_SERVO_HOLD_MA 150.0f     //per servo receiving pulses
+#define LOAD_SERVO_MA_PER_COUNT 0.5f  //per CCR count moved in one SOC_PERIOD
+#define LOAD_SERVO_MAX_MA 900.0f
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -91,7 +147,7 @@ typedef StaticTask_t osStaticThreadDef_t;
 
 /* Definitions for controlSysTask */
 osThreadId_t controlSysTaskHandle;
-uint32_t controlSysTaskBuffer[ 128 ];
+uint32_t controlSysTaskBuffer[ 192 ];
 osStaticThreadDef_t controlSysTaskControlBlock;
 const osThreadAttr_t controlSysTask_attributes = {
   .name = "controlSysTask",
@@ -101,21 +157,21 @@ const osThreadAttr_t controlSysTask_attributes = {
   .stack_size = sizeof(controlSysTaskBuffer),
   .priority = (osPriority_t) osPriorityLow2,
 };
-/* Definitions for ledBattTask */
-osThreadId_t ledBattTaskHandle;
-uint32_t ledBattTaskBuffer[ 128 ];
-osStaticThreadDef_t ledBattTaskControlBlock;
-const osThreadAttr_t ledBattTask_attributes = {
-  .name = "ledBattTask",
-  .cb_mem = &ledBattTaskControlBlock,
-  .cb_size = sizeof(ledBattTaskControlBlock),
-  .stack_mem = &ledBattTaskBuffer[0],
-  .stack_size = sizeof(ledBattTaskBuffer),
+/* Definitions for coopTask */
+osThreadId_t coopTaskHandle;
+uint32_t coopTaskBuffer[ 384 ];
+osStaticThreadDef_t coopTaskControlBlock;
+const osThreadAttr_t coopTask_attributes = {
+  .name = "coopTask",
+  .cb_mem = &coopTaskControlBlock,
+  .cb_size = sizeof(coopTaskControlBlock),
+  .stack_mem = &coopTaskBuffer[0],
+  .stack_size = sizeof(coopTaskBuffer),
   .priority = (osPriority_t) osPriorityLow,
 };
 /* Definitions for imuTask */
 osThreadId_t imuTaskHandle;
-uint32_t imuTaskBuffer[ 128 ];
+uint32_t imuTaskBuffer[ 256 ];
 osStaticThreadDef_t imuTaskControlBlock;
 const osThreadAttr_t imuTask_attributes = {
   .name = "imuTask",
@@ -147,14 +203,9 @@ osSemaphoreId_t targetSmphrHandle;
 const osSemaphoreAttr_t targetSmphr_attributes = {
   .name = "targetSmphr"
 };
-/* Definitions for targetSmphr */
-osSemaphoreId_t stateSmphrHandle;
-const osSemaphoreAttr_t stateSmphr_attributes = {
-  .name = "stateSmphr"
-};
 /* Definitions for stateTask */
 osThreadId_t stateTaskHandle;
-uint32_t stateTaskBuffer[ 128 ];
+uint32_t stateTaskBuffer[ 256 ];
 osStaticThreadDef_t stateTaskControlBlock;
 const osThreadAttr_t stateTask_attributes = {
   .name = "stateTask",
@@ -164,18 +215,6 @@ const osThreadAttr_t stateTask_attributes = {
   .stack_size = sizeof(stateTaskBuffer),
   .priority = (osPriority_t) osPriorityNormal,
 };
-/* Definitions for uniqueMovement */
-osThreadId_t uniqueMovementHandle;
-uint32_t uniqueMovementBuffer[ 128 ];
-osStaticThreadDef_t uniqueMovementControlBlock;
-const osThreadAttr_t uniqueMovement_attributes = {
-  .name = "uniqueMovement",
-  .cb_mem = &uniqueMovementControlBlock,
-  .cb_size = sizeof(uniqueMovementControlBlock),
-  .stack_mem = &uniqueMovementBuffer[0],
-  .stack_size = sizeof(uniqueMovementBuffer),
-  .priority = (osPriority_t) osPriorityLow,
-};
 /* USER CODE BEGIN PV */
 
 /* USER CODE END PV */
@@ -187,14 +226,30 @@ static void MX_USART2_UART_Init(void);
 static void MX_TIM2_Init(void);
 static void MX_I2C1_Init(void);
 void StartCtrlSysTask(void *argument);
-void StartLedBattTask(void *argument);
+void StartCoopTask(void *argument);
 void StartIMUTask(void *argument);
 void StartTargetSetTask(void *argument);
 void StartStateMachine(void *argument);
-void StartUniqueMovement(void *argument);
 
 /* USER CODE BEGIN PFP */
 void transitionOFF();
+uint8_t ledBattRoutine(coop_ctx_t *ctx);
+uint8_t bootAnimationRoutine(coop_ctx_t *ctx);
+uint8_t socRoutine(coop_ctx_t *ctx);
+uint8_t tuningRoutine(coop_ctx_t *ctx);
+uint8_t blackBoxDumpRoutine(coop_ctx_t *ctx);
+uint8_t supervisorRoutine(coop_ctx_t *ctx);
+uint8_t cinematicRoutine(coop_ctx_t *ctx);
+void cinematicStop();
+void updateManualSlew();
+void updateServoIdle();
+void recordCycles(cycle_stats_t *stats, uint32_t cycles);
+void loadParams();
+void applyParams();
+void recordBlackBox();
+void recordControlMetrics();
+void setServoIdle(bool idle);
+float orientationChange(const bno055_vector_t *a, const bno055_vector_t *b);
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
@@ -203,6 +258,10 @@ PUTCHAR_PROTOTYPE
 {
   /* Place your implementation of fputc here */
   /* e.g. write a character to the EVAL_COM1 and Loop until the end of transmission */
+  //text in between the tuning link's frames would corrupt them
+  if (tuning_sessionActive()){
+    return ch;
+  }
   HAL_UART_Transmit(&huart2, (uint8_t *)&ch, 1, 0xFFFF);
 
   return ch;
@@ -218,14 +277,42 @@ void rollPWM(float CCR_val);
 float getRoll();
 
 bno055_vector_t spatialOrientation;
+uint32_t spatialStampUs;        //timestamp_us() when spatialOrientation was read
+uint32_t spatialSeq;            //one more per published sample, 0 before the first
+sample_age_t ctrlSampleAge;     //orientation age as seen by the control tick
+#if IMU_BACKEND == IMU_BACKEND_SYNTHETIC
+SyntheticImu imu({ 180, 30, 4000 }, { 0, 5, 2500 }, { 0, 10, 1500 }, 0.1f);
+#elif IMU_BACKEND == IMU_BACKEND_REPLAY
+#include "imuReplayData.h"
+ReplayImu imu(imuReplaySamples, sizeof(imuReplaySamples) / sizeof(imuReplaySamples[0]), true);
+#else
+Bno055Imu imu(&hi2c1);
+#endif
 int CCR1,CCR2,CCR4;
-PIDController<float> yawCtrl(KP_y,KD_y,KI_y, getYaw, yawPWM), pitchCtrl(KP_p,KD_p,KI_p, getPitch, pitchPWM),rollCtrl(KP_r,KD_r,KI_r, getRoll, rollPWM);
+PIDController<float> yawCtrl(KP_y,KI_y,KD_y, getYaw, yawPWM), pitchCtrl(KP_p,KI_p,KD_p, getPitch, pitchPWM),rollCtrl(KP_r,KI_r,KD_r, getRoll, rollPWM);
 float setpointYaw, setpointPitch, setpointRoll;
-int state;
-
-
-osThreadId_t OFF_threads[OFF_NUM_THREADS];
-osThreadId_t UNIQUE_threads[UNIQUE_NUM_THREADS1];
+osEventFlagsId_t taskGates;
+volatile bool imuReady;
+uint32_t lastModeChange;
+cycle_stats_t ctrlTickCycles;   //compare builds with RAMFUNC_ENABLED 0 and 1
+uint32_t resetFlags;            //RCC->CSR at boot
+
+//Tunable settings, loaded from the parameter store at boot.
+int pwmLow = PWM_LOW, pwmHigh = PWM_HIGH, pwmLowYaw = PWM_LOW_Y, pwmHighYaw = PWM_HIGH_Y;
+uint32_t controlPeriod = CONTROL_FREQ, imuPeriod = IMU_FREQ, cinematicPeriod = UNIQUE_FREQ;
+int cinematicPitch = CINEMATIC_PITCH_OFFSET, cinematicRoll = CINEMATIC_ROLL_OFFSET;
+soc_estimator_t batteryEstimator;
+uint8_t batteryPercent = 100;
+motion_profile_t yawProfile, pitchProfile;
+uint32_t yawHeldSince, pitchHeldSince, lastSlewTick;
+int8_t yawSlewDir, pitchSlewDir;
+volatile bool servoIdle;
+uint32_t settledSince;
+uint32_t servoIdleEntries, servoIdleWakes;
+ctrl_metrics_t axisMetrics[SERVO_COUNT];  //since entering STABILIZE or the last restart
+volatile bool axisMetricsRestart;
+
+sm_machine_t gimbalSM;
 /* USER CODE END 0 */
 
 /**
@@ -261,7 +348,25 @@ int main(void)
   MX_TIM2_Init();
   MX_I2C1_Init();
   /* USER CODE BEGIN 2 */
-
+  resetFlags = RCC->CSR;
+  __HAL_RCC_CLEAR_RESET_FLAGS();
+  blackbox_init(resetFlags);
+  inputEvents_init();
+  servo_init(&htim2);
+  clock_init(&hi2c1, &htim2, &huart2);
+  loadParams();
+  tuning_init(&huart2);
+  debouncer_init();
+  //capture held through reset: print the benchmark table instead of flying
+  if (debouncer_pressed() & (1U << BUTTON_CAPTURE)){
+    benchRunner_run();
+    while (1){
+      __WFI();
+    }
+  }
+  analogMonitor_init();
+  lowPower_init();
+  supervisor_init(WATCHDOG_MS);
 
   /* USER CODE END 2 */
 
@@ -278,9 +383,6 @@ int main(void)
 
   /* creation of targetSmphr */
   targetSmphrHandle = osSemaphoreNew(1, 1, &targetSmphr_attributes);
-
-  /* creation of stateSmphr */
-  stateSmphrHandle = osSemaphoreNew(1,1, &stateSmphr_attributes);
   /* USER CODE BEGIN RTOS_SEMAPHORES */
   /* add semaphores, ... */
   /* USER CODE END RTOS_SEMAPHORES */
@@ -291,32 +393,44 @@ int main(void)
 
   /* USER CODE BEGIN RTOS_QUEUES */
   /* add queues, ... */
+  stateEventQueue = osMessageQueueNew(STATE_EVENT_QUEUE_LEN, sizeof(uint8_t), NULL);
   /* USER CODE END RTOS_QUEUES */
   setpointYaw = setpointPitch = setpointRoll = 0;
+  motionProfile_init(&yawProfile, setpointYaw, SLEW_MAX_VEL, SLEW_ACCEL);
+  motionProfile_init(&pitchProfile, setpointPitch, SLEW_MAX_VEL, SLEW_ACCEL);
   /* Create the thread(s) */
 
   /* creation of stateTask */
   stateTaskHandle = osThreadNew(StartStateMachine, NULL, &stateTask_attributes);
 
   /* creation of controlSysTask */
-  //controlSysTaskHandle = osThreadNew(StartCtrlSysTask, NULL, &controlSysTask_attributes);
-
-  /* creation of ledBattTask */
-  ledBattTaskHandle = osThreadNew(StartLedBattTask, NULL, &ledBattTask_attributes);
+  controlSysTaskHandle = osThreadNew(StartCtrlSysTask, NULL, &controlSysTask_attributes);
+
+  /* creation of coopTask */
+  coop_register(COOP_LED_BATT, ledBattRoutine, NULL);
+  coop_register(COOP_BOOT_ANIMATION, bootAnimationRoutine, NULL);
+  coop_register(COOP_CINEMATIC, cinematicRoutine, cinematicStop);
+  coop_register(COOP_SOC, socRoutine, NULL);
+  coop_register(COOP_TUNING, tuningRoutine, NULL);
+  coop_register(COOP_BLACKBOX_DUMP, blackBoxDumpRoutine, NULL);
+  coop_register(COOP_SUPERVISOR, supervisorRoutine, NULL);
+  coop_start(COOP_LED_BATT);
+  coop_start(COOP_SOC);
+  coop_start(COOP_TUNING);
+  coop_start(COOP_SUPERVISOR);
+  coopTaskHandle = osThreadNew(StartCoopTask, NULL, &coopTask_attributes);
 
   /* creation of imuTask */
-  //imuTaskHandle = osThreadNew(StartIMUTask, NULL, &imuTask_attributes);
+  imuTaskHandle = osThreadNew(StartIMUTask, NULL, &imuTask_attributes);
 
   /* creation of downButtonTask */
-  //targetSetTaskHandle = osThreadNew(StartTargetSetTask, NULL, &targetSetTask_attributes);
-  
-  /* creation of uniqueMovement */
-  //uniqueMovementHandle = osThreadNew(StartUniqueMovement, NULL, &uniqueMovement_attributes);
+  targetSetTaskHandle = osThreadNew(StartTargetSetTask, NULL, &targetSetTask_attributes);
 
   /* USER CODE BEGIN RTOS_THREADS */
   /* add threads, ... */
   setPointButtonEvents = osEventFlagsNew( NULL );
-  stateMachineEvents  = osEventFlagsNew( NULL );
+  taskGates = osEventFlagsNew( NULL );
+  sm_init(&gimbalSM, gimbalStates, &gimbalTransitions[0][0], GIMBAL_NUM_STATES, EV_NUM_EVENTS, GIMBAL_OFF);
   /* USER CODE END RTOS_THREADS */
 
   /* USER CODE BEGIN RTOS_EVENTS */
@@ -565,24 +679,24 @@ static void MX_GPIO_Init(void)
 
   /*Configure GPIO pins : on_off_mode_Pin button_down_Pin button_up_Pin */
   GPIO_InitStruct.Pin = on_off_mode_Pin|button_down_Pin|button_up_Pin;
-  GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
+  GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
   GPIO_InitStruct.Pull = GPIO_PULLUP;
   HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
   /*Configure GPIO pins : button_right_Pin button_left_Pin */
   GPIO_InitStruct.Pin = button_right_Pin|button_left_Pin;
-  GPIO_InitStruct.Mode = GPIO_MODE_IT_FALLING;
+  GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
   GPIO_InitStruct.Pull = GPIO_PULLUP;
   HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
 
   /*Configure GPIO pin : button_capture_Pin */
   GPIO_InitStruct.Pin = button_capture_Pin;
-  GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
+  GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
   GPIO_InitStruct.Pull = GPIO_NOPULL;
   HAL_GPIO_Init(button_capture_GPIO_Port, &GPIO_InitStruct);
 
-  /*Configure GPIO pins : temperature_Pin batt_voltage_Pin */
-  GPIO_InitStruct.Pin = temperature_Pin|batt_voltage_Pin;
+  /*Configure GPIO pins : batt_adc_Pin temperature_Pin batt_voltage_Pin */
+  GPIO_InitStruct.Pin = batt_adc_Pin|temperature_Pin|batt_voltage_Pin;
   GPIO_InitStruct.Mode = GPIO_MODE_ANALOG;
   GPIO_InitStruct.Pull = GPIO_NOPULL;
   HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
@@ -609,75 +723,44 @@ static void MX_GPIO_Init(void)
   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
   HAL_GPIO_Init(LED_3_GPIO_Port, &GPIO_InitStruct);
 
-  /* EXTI interrupt init*/
-  HAL_NVIC_SetPriority(EXTI0_IRQn, 5, 0);
-  HAL_NVIC_EnableIRQ(EXTI0_IRQn);
-
-  HAL_NVIC_SetPriority(EXTI1_IRQn, 5, 0);
-  HAL_NVIC_EnableIRQ(EXTI1_IRQn);
-
-  HAL_NVIC_SetPriority(EXTI4_IRQn, 5, 0);
-  HAL_NVIC_EnableIRQ(EXTI4_IRQn);
-
-  HAL_NVIC_SetPriority(EXTI9_5_IRQn, 5, 0);
-  HAL_NVIC_EnableIRQ(EXTI9_5_IRQn);
-
 }
 
 /* USER CODE BEGIN 4 */
-void yawPWM(float CCR_val){
-
-	CCR1 += (int)CCR_val;
+RAMFUNC void yawPWM(float CCR_val){
 
-	if (CCR1 < PWM_LOW_Y){
-		TIM2->CCR1 = PWM_LOW_Y;
-    CCR1 = PWM_LOW_Y;
-	}
-	else if (CCR1 >PWM_HIGH_Y){
-		TIM2->CCR1 = PWM_HIGH_Y;
-    CCR1 = PWM_HIGH_Y;
-	}
-	else{
-		TIM2->CCR1 = CCR1;
+	//hold the pulse width still while idle instead of chasing sensor noise
+	if (servoIdle && CCR_val < CCR_DEADBAND && CCR_val > -CCR_DEADBAND){
+		return;
 	}
 
+	CCR1 = axis_clampPulse(CCR1 + (int)CCR_val, pwmLowYaw, pwmHighYaw);
+	servo_set(SERVO_YAW, CCR1);
+
 	//HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_1);
 }
 
-void pitchPWM(float CCR_val){
-
-	CCR2 += (int)CCR_val;
+RAMFUNC void pitchPWM(float CCR_val){
 
-	if (CCR2 <PWM_LOW){
-		TIM2->CCR2 = PWM_LOW;
-    CCR2 = PWM_LOW;
-	}
-	else if (CCR2 >PWM_HIGH){
-		TIM2->CCR2 = PWM_HIGH;
-    CCR2 = PWM_HIGH;
-	}
-	else{
-		TIM2->CCR2 = CCR2;
+	//hold the pulse width still while idle instead of chasing sensor noise
+	if (servoIdle && CCR_val < CCR_DEADBAND && CCR_val > -CCR_DEADBAND){
+		return;
 	}
 
+	CCR2 = axis_clampPulse(CCR2 + (int)CCR_val, pwmLow, pwmHigh);
+	servo_set(SERVO_PITCH, CCR2);
+
 	//HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_2);
 }
 
-void rollPWM(float CCR_val){
+RAMFUNC void rollPWM(float CCR_val){
 
-	CCR4 += (int)CCR_val;
+	//hold the pulse width still while idle instead of chasing sensor noise
+	if (servoIdle && CCR_val < CCR_DEADBAND && CCR_val > -CCR_DEADBAND){
+		return;
+	}
 
-		if (CCR4 <PWM_LOW){
-			TIM2->CCR4 = PWM_LOW;
-      CCR4 = PWM_LOW;
-		}
-		else if (CCR4 >PWM_HIGH){
-			TIM2->CCR4 = PWM_HIGH;
-      CCR4 = PWM_HIGH;
-		}
-		else{
-			TIM2->CCR4 = CCR4;
-		}
+	CCR4 = axis_clampPulse(CCR4 + (int)CCR_val, pwmLow, pwmHigh);
+	servo_set(SERVO_ROLL, CCR4);
 
 		//HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_4);
 }
@@ -686,88 +769,1032 @@ float prevYaw = 0;
 int yawPrevTime = 0;
 int yawCurTime = 0;
 
-float getYaw(){
-	float yaw;
-    //if you have already rotated clockwise and your spatial orientation is greater than 180 then return larger positive value
-    if ( CCR1 > PWM_MID + PWM_HYSTERESIS && spatialOrientation.x < ROTATIONOFFSET/2 ){
-      yaw = spatialOrientation.x;
+RAMFUNC float getYaw(){
+	return axis_unwrapYaw(spatialOrientation.x, CCR1, PWM_MID, PWM_HYSTERESIS, ROTATIONOFFSET);
+}
+
+RAMFUNC float getPitch(){
+	return -spatialOrientation.z;
+}
+
+RAMFUNC float getRoll(){
+	return -spatialOrientation.y;
+}
+
+void updatePitchSetPoint(float newSet){
+	pitchCtrl.setTarget(newSet);
+}
+
+
+void servosOff(){
+	servo_set(SERVO_YAW, 0); servo_set(SERVO_PITCH, 0); servo_set(SERVO_ROLL, 0);
+}
+
+/*
+ * State machine actions.  Mode-specific work is switched on and off here by
+ * opening and closing the task gates and starting and stopping cooperative
+ * routines; no thread is ever created or destroyed on a mode change.
+ */
+void enterOFF(){
+  servosOff();
+  clock_setProfile(CLOCK_LOW);
+  supervisor_setTimeout(WATCHDOG_SLEEP_MS);
+  lowPower_allowStop(true);
+}
+
+void enterACTIVE(){
+  lowPower_allowStop(false);
+  clock_setProfile(CLOCK_NORMAL);
+  supervisor_setTimeout(WATCHDOG_MS);
+  coop_start(COOP_SUPERVISOR);  //restart the check at the active rate
+  supervisor_arm(SUP_IMU, imuReady ? SUP_IMU_DEADLINE : SUP_IMU_SETUP_DEADLINE);
+  osEventFlagsSet(taskGates, GATE_IMU);
+  lowPower_markActive();
+}
+
+void exitACTIVE(){
+  osEventFlagsClear(taskGates, GATE_IMU);
+  supervisor_disarm(SUP_IMU);
+  servosOff();
+}
+
+void enterBOOTING(){
+  coop_start(COOP_BOOT_ANIMATION);
+}
+
+void exitBOOTING(){
+  coop_stop(COOP_BOOT_ANIMATION);
+}
+
+void enterSTABILIZE(){
+  clock_setProfile(CLOCK_FULL);
+	CCR1 = CCR4 = PWM_MID;
+  CCR2 = PWM_MID-STABILIZE_PITCH_OFFSET;
+	servo_set(SERVO_YAW, CCR1); servo_set(SERVO_PITCH, CCR2); servo_set(SERVO_ROLL, CCR4);
+	servo_startAll();
+  motionProfile_reset(&yawProfile, setpointYaw);
+  motionProfile_reset(&pitchProfile, setpointPitch);
+  //the controllers were not ticked since the last STABILIZE; don't integrate over that time
+  osSemaphoreAcquire( targetSmphrHandle, osWaitForever );
+  yawCtrl.reset(); pitchCtrl.reset(); rollCtrl.reset();
+  osSemaphoreRelease( targetSmphrHandle );
+  lastSlewTick = HAL_GetTick();
+  servoIdle = false;
+  settledSince = HAL_GetTick();
+  sampleAge_init(&ctrlSampleAge);
+  axisMetricsRestart = true;
+  supervisor_arm(SUP_CONTROL, SUP_CONTROL_DEADLINE);
+  osEventFlagsSet(taskGates, GATE_CTRL);
+}
+
+void exitSTABILIZE(){
+  osEventFlagsClear(taskGates, GATE_CTRL);
+  supervisor_disarm(SUP_CONTROL);
+  servoIdle = false;
+  clock_setProfile(CLOCK_NORMAL);
+}
+
+void enterCINEMATIC(){
+  coop_start(COOP_CINEMATIC);
+}
+
+void exitCINEMATIC(){
+  coop_stop(COOP_CINEMATIC);
+}
+
+void enterFAULT(){
+  blackbox_freeze(BB_FREEZE_FAULT);
+  servosOff();
+  clock_setProfile(CLOCK_LOW);
+  supervisor_setTimeout(WATCHDOG_SLEEP_MS);
+  lowPower_allowStop(true);
+}
+
+//ignore mode presses that come too soon after the last mode change
+bool modeChangeAllowed(){
+  return HAL_GetTick() - lastModeChange > modeChangeDelay;
+}
+
+void markModeChange(){
+  lastModeChange = HAL_GetTick();
+}
+
+void yawMovement(bool &polarity){
+   if (polarity){
+      CCR1 += 30;
+    }
+    else{
+      CCR1 -= 30;
+    }
+
+    if (CCR1 > pwmHighYaw){
+      polarity = false;
+    }
+    else if (CCR1 < pwmLowYaw){
+      polarity = true;
+    }
+    servo_set(SERVO_YAW, CCR1);
+}
+
+/**
+ * Shows the battery level on LED_1..LED_3 as a three-step bar.  Below the
+ * low-battery threshold the last LED blinks in step with the status LED.
+ * The bar is dark while the gimbal is off.
+ */
+void showBattery(bool blinkPhase){
+  if (sm_isIn(&gimbalSM, GIMBAL_OFF)){
+    HAL_GPIO_WritePin(LED_1_GPIO_Port, LED_1_Pin, GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(LED_2_GPIO_Port, LED_2_Pin, GPIO_PIN_RESET);
+    HAL_GPIO_WritePin(LED_3_GPIO_Port, LED_3_Pin, GPIO_PIN_RESET);
+    return;
+  }
+  GPIO_PinState firstLed = (batteryPercent >= SOC_LOW_PERCENT || blinkPhase) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+  HAL_GPIO_WritePin(LED_1_GPIO_Port, LED_1_Pin, batteryPercent > 0 ? firstLed : GPIO_PIN_RESET);
+  HAL_GPIO_WritePin(LED_2_GPIO_Port, LED_2_Pin, batteryPercent > 33 ? GPIO_PIN_SET : GPIO_PIN_RESET);
+  HAL_GPIO_WritePin(LED_3_GPIO_Port, LED_3_Pin, batteryPercent > 66 ? GPIO_PIN_SET : GPIO_PIN_RESET);
+}
+
+/**
+ * Blinks the status LED at a rate set by the current state and refreshes the
+ * battery display.  The status LED is left to the boot animation while that
+ * is running.
+ */
+uint8_t ledBattRoutine(coop_ctx_t *ctx){
+  static uint32_t period;
+  static bool phase;
+
+  COOP_BEGIN(ctx);
+  for(;;){
+    if ( !coop_isRunning(COOP_BOOT_ANIMATION) ){
+      HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_3);
+    }
+    phase = !phase;
+    showBattery(phase);
+
+    if (sm_isIn(&gimbalSM, GIMBAL_OFF)){
+      period = 1000;
+    }
+    else if (sm_isIn(&gimbalSM, GIMBAL_BOOTING) || sm_isIn(&gimbalSM, GIMBAL_STABILIZE)){
+      period = 500;
+    }
+    else{
+      period = 100;
+    }
+    COOP_DELAY(ctx, period);
+  }
+  COOP_END(ctx);
+}
+
+/**
+ * Fast blink shown while the gimbal powers up.  Reports calibration done to
+ * the state machine once the IMU is also ready.
+ */
+uint8_t bootAnimationRoutine(coop_ctx_t *ctx){
+  static int blinks;
+
+  COOP_BEGIN(ctx);
+  for(blinks = 0; blinks < NUMOFBLINKS; blinks++){
+    HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_3);
+    COOP_DELAY(ctx, BOOTBLINK_PERIOD);
+  }
+  COOP_WAIT_UNTIL(ctx, imuReady);
+  postStateEvent(EV_CALIBRATION_DONE);
+  COOP_END(ctx);
+}
+
+//Current drawn by one servo, estimated from its pulse width and how far the
+//pulse width moved since the last estimate.
+float servoLoad(uint32_t ccr, uint32_t prevCcr){
+  if (ccr == 0){
+    return 0;
+  }
+  float moved = (ccr > prevCcr) ? ccr - prevCcr : prevCcr - ccr;
+  if (prevCcr == 0){
+    moved = 0;
+  }
+  float load = LOAD_SERVO_HOLD_MA + moved * LOAD_SERVO_MA_PER_COUNT;
+  return (load > LOAD_SERVO_MAX_MA) ? LOAD_SERVO_MAX_MA : load;
+}
+
+/**
+ * Updates the battery state of charge at 10 Hz from the latest ADC snapshot
+ * and the servo activity, and reports a low battery to the state machine
+ * while the servos are powered.
+ */
+uint8_t socRoutine(coop_ctx_t *ctx){
+  static uint32_t prevCcr[3];
+  static uint32_t lastUpdate;
+  analog_snapshot_t analog;
+  uint32_t ccr[3];
+
+  COOP_BEGIN(ctx);
+  soc_init(&batteryEstimator);
+  COOP_WAIT_UNTIL(ctx, (analogMonitor_read(&analog), analog.updates != 0));
+  lastUpdate = coop_now();
+  for(;;){
+    COOP_DELAY(ctx, sm_isIn(&gimbalSM, GIMBAL_OFF) ? SOC_OFF_PERIOD : SOC_PERIOD);
+
+    analogMonitor_read(&analog);
+    for (uint8_t axis = 0; axis < SERVO_COUNT; axis++){
+      ccr[axis] = servo_get(axis);
+    }
+    {
+      float load = LOAD_IDLE_MA;
+      for (uint8_t i = 0; i < 3; i++){
+        load += servoLoad(ccr[i], prevCcr[i]);
+        prevCcr[i] = ccr[i];
+      }
+      uint32_t now = coop_now();
+      batteryPercent = soc_update(&batteryEstimator, analog.battMv, load, now - lastUpdate);
+      lastUpdate = now;
+    }
+
+    if (batteryEstimator.low && sm_isIn(&gimbalSM, GIMBAL_ACTIVE)){
+      postStateEvent(EV_LOW_BATTERY);
+    }
+  }
+  COOP_END(ctx);
+}
+
+/**
+ * Cinematic mode: holds pitch and roll and sweeps yaw back and forth.
+ */
+uint8_t cinematicRoutine(coop_ctx_t *ctx){
+  static bool direction;
+
+  COOP_BEGIN(ctx);
+  direction = true;
+  servo_startAll();
+  servo_set(SERVO_PITCH, PWM_MID + cinematicPitch);
+  servo_set(SERVO_ROLL, PWM_MID + cinematicRoll);
+  for(;;){
+    yawMovement(direction);
+    COOP_DELAY(ctx, cinematicPeriod);
+  }
+  COOP_END(ctx);
+}
+
+void cinematicStop(){
+  servo_set(SERVO_YAW, 0); servo_set(SERVO_PITCH, 0); servo_set(SERVO_ROLL, 0);
+}
+
+//Rejects settings out of their key's range, or that would invert the servo range.
+bool tuningValueValid(uint8_t key, uint32_t value){
+  if (!gimbalParams_inRange(key, value)){
+    return false;
+  }
+  switch (key){
+  case PARAM_PWM_LOW:
+    return value < params_get(PARAM_PWM_HIGH);
+  case PARAM_PWM_HIGH:
+    return value > params_get(PARAM_PWM_LOW) && value <= TIM2->ARR;
+  case PARAM_PWM_LOW_YAW:
+    return value < params_get(PARAM_PWM_HIGH_YAW);
+  case PARAM_PWM_HIGH_YAW:
+    return value > params_get(PARAM_PWM_LOW_YAW) && value <= TIM2->ARR;
+  default:
+    return true;
+  }
+}
+
+/*
+ * Recorder reply: status, freeze reason, sample count (u16), samples written
+ * (u32), freeze tick (u32), resets while frozen, sample size, control ticks
+ * per sample.
+ */
+void handleRecorderCommand(const tuning_frame_t *frame){
+  uint8_t reply[15];
+  bb_info_t info;
+  uint8_t status = TUNING_OK;
+
+  if (frame->len != 1){
+    status = TUNING_BAD_VALUE;
+  }
+  else{
+    switch (frame->payload[0]){
+    case TUNING_RECORDER_INFO:
+      break;
+    case TUNING_RECORDER_FREEZE:
+      blackbox_freeze(BB_FREEZE_COMMAND);
+      break;
+    case TUNING_RECORDER_DUMP:
+      if (coop_isRunning(COOP_BLACKBOX_DUMP)){
+        status = TUNING_BUSY;
+        break;
+      }
+      blackbox_freeze(BB_FREEZE_COMMAND);
+      coop_start(COOP_BLACKBOX_DUMP);
+      break;
+    case TUNING_RECORDER_REARM:
+      if (coop_isRunning(COOP_BLACKBOX_DUMP)){
+        status = TUNING_BUSY;
+        break;
+      }
+      blackbox_rearm();
+      break;
+    default:
+      status = TUNING_BAD_VALUE;
+      break;
+    }
+  }
+
+  blackbox_getInfo(&info);
+  reply[0] = status;
+  reply[1] = info.reason;
+  memcpy(&reply[2], &info.count, 2);
+  memcpy(&reply[4], &info.written, 4);
+  memcpy(&reply[8], &info.freezeTick, 4);
+  reply[12] = info.bootsFrozen;
+  reply[13] = sizeof(bb_sample_t);
+  reply[14] = info.decimation;
+  tuning_send(frame->cmd | TUNING_REPLY, reply, sizeof(reply));
+}
+
+static uint16_t saturate16(uint32_t value){
+  return (value > UINT16_MAX) ? UINT16_MAX : (uint16_t)value;
+}
+
+/*
+ * Health reply: reset flags at boot (u32), withheld watchdog reloads (u32),
+ * then for each supervised task misses (u32), longest gap between beats
+ * (u16, ms) and current deadline (u16, ms, 0 while not supervised), then
+ * the I2C counters: transfers (u32), failures, NACKs, bus errors, timeouts,
+ * bus clears, re-inits and exhausted retry budgets (u16 each, saturating)
+ * and modelled bus time in SCL periods (u32).
+ */
+void sendHealth(){
+  uint8_t reply[8 + SUP_NUM_TASKS * 8 + 4 + 7 * 2 + 4];
+  i2cbus_stats_t i2c;
+  uint32_t withheld = supervisor_withheldFeeds();
+  sup_task_stats_t stats;
+
+  memcpy(&reply[0], &resetFlags, 4);
+  memcpy(&reply[4], &withheld, 4);
+  for (uint8_t task = 0; task < SUP_NUM_TASKS; task++){
+    uint8_t *p = &reply[8 + task * 8];
+    supervisor_getStats(task, &stats);
+    uint16_t gap = saturate16(stats.maxGapMs);
+    uint16_t deadline = stats.deadlineMs;
+    memcpy(p, &stats.misses, 4);
+    memcpy(p + 4, &gap, 2);
+    memcpy(p + 6, &deadline, 2);
+  }
+
+  i2cbus_getStats(&i2c);
+  uint16_t counters[7] = {
+    saturate16(i2c.failures), saturate16(i2c.nacks), saturate16(i2c.busErrors),
+    saturate16(i2c.timeouts), saturate16(i2c.busClears), saturate16(i2c.reinits),
+    saturate16(i2c.budgetExhausted)
+  };
+  memcpy(&reply[8 + SUP_NUM_TASKS * 8], &i2c.transfers, 4);
+  memcpy(&reply[8 + SUP_NUM_TASKS * 8 + 4], counters, sizeof(counters));
+  memcpy(&reply[8 + SUP_NUM_TASKS * 8 + 4 + sizeof(counters)], &i2c.busBits, 4);
+  tuning_send(TUNING_CMD_HEALTH | TUNING_REPLY, reply, sizeof(reply));
+}
+
+/*
+ * Sample age reply, for the orientation used by the control ticks since
+ * STABILIZE was entered: fresh samples, duplicates, dropouts, last and
+ * largest age in us (u32 each), then the AGE_HIST_BINS histogram counts
+ * (u16 each, saturating).
+ */
+void sendSampleAge(){
+  uint8_t reply[5 * 4 + AGE_HIST_BINS * 2];
+  uint32_t head[5] = {
+    ctrlSampleAge.fresh, ctrlSampleAge.duplicates, ctrlSampleAge.dropouts,
+    ctrlSampleAge.lastAgeUs, ctrlSampleAge.maxAgeUs
+  };
+  uint16_t hist[AGE_HIST_BINS];
+
+  for (uint8_t i = 0; i < AGE_HIST_BINS; i++){
+    hist[i] = saturate16(ctrlSampleAge.hist[i]);
+  }
+  memcpy(reply, head, sizeof(head));
+  memcpy(&reply[sizeof(head)], hist, sizeof(hist));
+  tuning_send(TUNING_CMD_SAMPLE_AGE | TUNING_REPLY, reply, sizeof(reply));
+}
+
+/*
+ * Stack reply: for the control, coop, IMU, target and state tasks, stack
+ * size and least free stack since boot (u16 each, words).
+ */
+void sendStacks(){
+  static const struct {
+    osThreadId_t *handle;
+    uint32_t sizeBytes;
+  } tasks[] = {
+    {&controlSysTaskHandle, sizeof(controlSysTaskBuffer)},
+    {&coopTaskHandle, sizeof(coopTaskBuffer)},
+    {&imuTaskHandle, sizeof(imuTaskBuffer)},
+    {&targetSetTaskHandle, sizeof(targetSetTaskBuffer)},
+    {&stateTaskHandle, sizeof(stateTaskBuffer)},
+  };
+  uint16_t reply[2 * sizeof(tasks) / sizeof(tasks[0])];
+
+  for (uint8_t i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++){
+    reply[2 * i] = tasks[i].sizeBytes / 4;
+    reply[2 * i + 1] = osThreadGetStackSpace(*tasks[i].handle) / 4;   //high-water mark
+  }
+  tuning_send(TUNING_CMD_STACKS | TUNING_REPLY, (uint8_t *)reply, sizeof(reply));
+}
+
+/*
+ * Clock reply: switches, failed switches, deferred switches, last and
+ * longest switch time in us, time at CLOCK_LOW, CLOCK_NORMAL and CLOCK_FULL
+ * in ms and the time-weighted average SYSCLK in kHz (u32 each).
+ */
+void sendClock(){
+  clock_stats_t s;
+  clock_getStats(&s);
+
+  uint32_t totalMs = s.residencyMs[CLOCK_LOW] + s.residencyMs[CLOCK_NORMAL] + s.residencyMs[CLOCK_FULL];
+  uint32_t reply[9] = {
+    s.switches, s.failedSwitches, s.deferredSwitches, s.lastSwitchUs, s.maxSwitchUs,
+    s.residencyMs[CLOCK_LOW], s.residencyMs[CLOCK_NORMAL], s.residencyMs[CLOCK_FULL],
+    totalMs ? (uint32_t)(s.mhzMs * 1000 / totalMs) : 0
+  };
+  tuning_send(TUNING_CMD_CLOCK | TUNING_REPLY, (uint8_t *)reply, sizeof(reply));
+}
+
+/*
+ * Control metrics reply: status, then per axis (yaw, pitch, roll) settle time
+ * in ms (u32, UINT32_MAX if not settled), overshoot, steady error and
+ * jitter in hundredths of a degree (u16 each) and servo travel in counts
+ * (u32).
+ */
+void handleControlMetricsCommand(const tuning_frame_t *frame){
+  uint8_t reply[1 + SERVO_COUNT * 14];
+  uint8_t *p = &reply[1];
+  ctrl_metrics_report_t report;
+
+  if (frame->len != 1){
+    reply[0] = TUNING_BAD_VALUE;
+    tuning_send(TUNING_CMD_CONTROL_METRICS | TUNING_REPLY, reply, 1);
+    return;
+  }
+  if (frame->payload[0] == TUNING_METRICS_RESTART){
+    axisMetricsRestart = true;
+  }
+  else if (frame->payload[0] != TUNING_METRICS_READ){
+    reply[0] = TUNING_BAD_COMMAND;
+    tuning_send(TUNING_CMD_CONTROL_METRICS | TUNING_REPLY, reply, 1);
+    return;
+  }
+
+  reply[0] = TUNING_OK;
+  for (uint8_t axis = 0; axis < SERVO_COUNT; axis++){
+    ctrlMetrics_report(&axisMetrics[axis], &report);
+    uint16_t centi[3] = {
+      saturate16((uint32_t)(report.overshootDeg * 100)),
+      saturate16((uint32_t)(report.steadyErrorDeg * 100)),
+      saturate16((uint32_t)(report.jitterDeg * 100))
+    };
+    memcpy(p, &report.settleMs, 4);
+    memcpy(p + 4, centi, sizeof(centi));
+    memcpy(p + 10, &report.travelCounts, 4);
+    p += 14;
+  }
+  tuning_send(TUNING_CMD_CONTROL_METRICS | TUNING_REPLY, reply, sizeof(reply));
+}
+
+#define SERVO_TRACE_PER_FRAME 5
+
+/**
+ * Handles a TUNING_CMD_SERVO_TRACE frame.  READ replies with the status, the
+ * first index, the number of stored events and up to SERVO_TRACE_PER_FRAME
+ * servo_trace_t entries starting at that index.
+ */
+void handleServoTraceCommand(const tuning_frame_t *frame){
+  uint8_t reply[5 + SERVO_TRACE_PER_FRAME * sizeof(servo_trace_t)];
+  uint8_t len = 5;
+  uint16_t index = 0;
+  uint16_t count;
+  servo_trace_t entry;
+
+  if (frame->len == 0){
+    reply[0] = TUNING_BAD_VALUE;
+    tuning_send(TUNING_CMD_SERVO_TRACE | TUNING_REPLY, reply, 1);
+    return;
+  }
+  if (frame->payload[0] == TUNING_SERVO_TRACE_ARM){
+    servo_traceArm();
+  }
+  else if (frame->payload[0] == TUNING_SERVO_TRACE_READ && frame->len >= 3){
+    memcpy(&index, &frame->payload[1], sizeof(index));
+  }
+  else{
+    reply[0] = TUNING_BAD_COMMAND;
+    tuning_send(TUNING_CMD_SERVO_TRACE | TUNING_REPLY, reply, 1);
+    return;
+  }
+
+  count = servo_traceCount();
+  reply[0] = TUNING_OK;
+  memcpy(&reply[1], &index, sizeof(index));
+  memcpy(&reply[3], &count, sizeof(count));
+  if (frame->payload[0] == TUNING_SERVO_TRACE_READ){
+    for (uint8_t i = 0; i < SERVO_TRACE_PER_FRAME && servo_traceGet(index + i, &entry); i++){
+      memcpy(&reply[len], &entry, sizeof(entry));
+      len += sizeof(entry);
     }
-    //if you have rotated counter clockwise and your spatial orientation is greater than 180, then return the negative value
-    else if ( CCR1 < PWM_MID - PWM_HYSTERESIS && spatialOrientation.x > ROTATIONOFFSET/2 ){
-      yaw = spatialOrientation.x - ROTATIONOFFSET;
+  }
+  tuning_send(TUNING_CMD_SERVO_TRACE | TUNING_REPLY, reply, len);
+}
+
+static uint32_t tuningTelemetryPeriod;
+static uint32_t tuningNextTelemetry;
+static bool tuningApplyPending;
+
+/**
+ * Handles one command frame and sends its reply.  SET only stages the value;
+ * tuningRoutine() applies it between control ticks.
+ */
+void handleTuningFrame(const tuning_frame_t *frame){
+  uint8_t reply[6];
+  uint32_t value;
+  uint8_t key = frame->payload[0];
+
+  switch (frame->cmd){
+  case TUNING_CMD_GET:
+    value = (frame->len == 1 && key < PARAM_COUNT) ? params_get(key) : 0;
+    reply[0] = key;
+    memcpy(&reply[1], &value, 4);
+    reply[5] = (frame->len == 1 && key < PARAM_COUNT) ? TUNING_OK : TUNING_BAD_KEY;
+    tuning_send(frame->cmd | TUNING_REPLY, reply, 6);
+    break;
+
+  case TUNING_CMD_SET:
+    reply[0] = key;
+    if (frame->len != 5 || key >= PARAM_COUNT){
+      reply[5] = TUNING_BAD_KEY;
     }
     else{
-      if ( spatialOrientation.x < ROTATIONOFFSET/2 ){
-      yaw = spatialOrientation.x;
+      memcpy(&value, &frame->payload[1], 4);
+      if (!tuningValueValid(key, value)){
+        reply[5] = TUNING_BAD_VALUE;
       }
       else{
-        yaw = spatialOrientation.x - ROTATIONOFFSET;
+        params_stage(key, value);
+        tuningApplyPending = true;
+        reply[5] = TUNING_OK;
       }
     }
+    value = (key < PARAM_COUNT) ? params_get(key) : 0;
+    memcpy(&reply[1], &value, 4);
+    tuning_send(frame->cmd | TUNING_REPLY, reply, 6);
+    break;
+
+  case TUNING_CMD_SAVE:
+    //erasing a page stalls the CPU for tens of ms, too long while stabilizing
+    if (sm_isIn(&gimbalSM, GIMBAL_STABILIZE)){
+      reply[0] = TUNING_BUSY;
+    }
+    else{
+      reply[0] = params_commit() ? TUNING_OK : TUNING_FLASH_ERROR;
+    }
+    tuning_send(frame->cmd | TUNING_REPLY, reply, 1);
+    break;
+
+  case TUNING_CMD_STREAM:
+    if (frame->len != 2){
+      reply[0] = TUNING_BAD_VALUE;
+    }
+    else{
+      tuningTelemetryPeriod = frame->payload[0] | (frame->payload[1] << 8);
+      if (tuningTelemetryPeriod != 0 && tuningTelemetryPeriod < TELEMETRY_MIN_PERIOD){
+        tuningTelemetryPeriod = TELEMETRY_MIN_PERIOD;
+      }
+      tuningNextTelemetry = coop_now();
+      reply[0] = TUNING_OK;
+    }
+    tuning_send(frame->cmd | TUNING_REPLY, reply, 1);
+    break;
+
+  case TUNING_CMD_RECORDER:
+    handleRecorderCommand(frame);
+    break;
+
+  case TUNING_CMD_HEALTH:
+    sendHealth();
+    break;
+
+  case TUNING_CMD_SAMPLE_AGE:
+    sendSampleAge();
+    break;
+
+  case TUNING_CMD_SERVO_TRACE:
+    handleServoTraceCommand(frame);
+    break;
 
-	return yaw;
+  case TUNING_CMD_CONTROL_METRICS:
+    handleControlMetricsCommand(frame);
+    break;
+
+  case TUNING_CMD_STACKS:
+    sendStacks();
+    break;
+
+  case TUNING_CMD_CLOCK:
+    sendClock();
+    break;
+
+  default:
+    reply[0] = TUNING_BAD_COMMAND;
+    tuning_send(frame->cmd | TUNING_REPLY, reply, 1);
+    break;
+  }
 }
 
-float getPitch(){
-	return -spatialOrientation.z;
+/*
+ * Telemetry frame: tick (u32), yaw/pitch/roll feedback, yaw/pitch/roll
+ * targets and yaw/pitch/roll errors (float, degrees), then CCR1/CCR2/CCR4
+ * (u16).  Read without the semaphores; a sample may mix two control ticks.
+ */
+void sendTelemetry(){
+  uint8_t payload[4 + 9 * 4 + 3 * 2];
+  uint8_t *p = payload;
+  uint32_t tick = HAL_GetTick();
+  float values[9] = {
+    yawCtrl.getFeedback(), pitchCtrl.getFeedback(), rollCtrl.getFeedback(),
+    yawCtrl.getTarget(), pitchCtrl.getTarget(), rollCtrl.getTarget(),
+    yawCtrl.getError(), pitchCtrl.getError(), rollCtrl.getError()
+  };
+  uint16_t ccr[3] = { (uint16_t)servo_get(SERVO_YAW), (uint16_t)servo_get(SERVO_PITCH), (uint16_t)servo_get(SERVO_ROLL) };
+
+  memcpy(p, &tick, 4); p += 4;
+  memcpy(p, values, sizeof(values)); p += sizeof(values);
+  memcpy(p, ccr, sizeof(ccr));
+  tuning_send(TUNING_TELEMETRY, payload, sizeof(payload));
 }
 
-float getRoll(){
-	return -spatialOrientation.y;
+//Sleep until the next telemetry frame is due, or indefinitely with it off.
+uint32_t tuningWait(){
+  if (tuningTelemetryPeriod == 0){
+    return TUNING_IDLE_WAIT;
+  }
+  int32_t left = (int32_t)(tuningNextTelemetry - coop_now());
+  return (left > 0) ? (uint32_t)left : 0;
 }
 
-void updatePitchSetPoint(float newSet){
-	pitchCtrl.setTarget(newSet);
+/**
+ * Serves the tuning link: answers command frames as they arrive and streams
+ * telemetry while enabled.  Staged settings are applied with targetSmphr
+ * held, which the control task holds for a whole tick, so a change always
+ * lands between two ticks.
+ */
+uint8_t tuningRoutine(coop_ctx_t *ctx){
+  static tuning_frame_t frame;
+  static bool haveFrame;
+
+  COOP_BEGIN(ctx);
+  for(;;){
+    haveFrame = false;
+    COOP_WAIT_NOTIFIED(ctx, (haveFrame = tuning_receive(&frame)), tuningWait());
+    if (haveFrame){
+      handleTuningFrame(&frame);
+    }
+
+    while (tuningApplyPending){
+      if (osSemaphoreAcquire(targetSmphrHandle, 0) == osOK){
+        applyParams();
+        osSemaphoreRelease(targetSmphrHandle);
+        tuningApplyPending = false;
+      }
+      else{
+        COOP_DELAY(ctx, 1);
+      }
+    }
+
+    if (tuningTelemetryPeriod != 0 && (int32_t)(coop_now() - tuningNextTelemetry) >= 0){
+      sendTelemetry();
+      tuningNextTelemetry += tuningTelemetryPeriod;
+      if ((int32_t)(coop_now() - tuningNextTelemetry) >= 0){
+        tuningNextTelemetry = coop_now() + tuningTelemetryPeriod;
+      }
+    }
+  }
+  COOP_END(ctx);
 }
 
+/**
+ * Streams the frozen flight record over the tuning link, one sample per
+ * frame and one frame per scheduler pass, then a frame with index 0xFFFF.
+ * Tools/blackbox_decode.py turns a capture into CSV.
+ */
+uint8_t blackBoxDumpRoutine(coop_ctx_t *ctx){
+  static uint16_t index;
+  uint8_t payload[2 + sizeof(bb_sample_t)];
+  bb_sample_t sample;
+
+  COOP_BEGIN(ctx);
+  for (index = 0; blackbox_getSample(index, &sample); index++){
+    memcpy(payload, &index, 2);
+    memcpy(&payload[2], &sample, sizeof(sample));
+    tuning_send(TUNING_RECORDER_DATA, payload, sizeof(payload));
+    COOP_YIELD(ctx);
+  }
+  index = 0xFFFF;
+  tuning_send(TUNING_RECORDER_DATA, (const uint8_t *)&index, 2);
+  COOP_END(ctx);
+}
 
-void transitionOFF(){
-for(int i = 0; i < OFF_NUM_THREADS; ++i){
-    if ( !(osThreadGetState(OFF_threads[i]) == osThreadTerminated) ){
-     osThreadTerminate(OFF_threads[i]);
+/*
+ * Safe state after a missed deadline: the servo pulses are stopped at once,
+ * whatever the late task does next, and the gimbal goes to FAULT.
+ */
+void enterDeadlineSafeState(){
+  servo_stopAll();
+  blackbox_freeze(BB_FREEZE_DEADLINE);
+  postStateEvent(EV_DEADLINE_MISS);
+}
+
+/**
+ * Runs the deadline supervisor.  The IWDG is reloaded from here only while
+ * every supervised task is on time; if this routine stops running, or a
+ * late task does not recover or get disarmed, the chip resets.
+ */
+uint8_t supervisorRoutine(coop_ctx_t *ctx){
+  COOP_BEGIN(ctx);
+  for(;;){
+    if (supervisor_check() != 0 && sm_isIn(&gimbalSM, GIMBAL_ACTIVE)){
+      enterDeadlineSafeState();
     }
+    COOP_DELAY(ctx, (sm_isIn(&gimbalSM, GIMBAL_OFF) || sm_isIn(&gimbalSM, GIMBAL_FAULT)) ? SUP_CHECK_SLEEP_PERIOD : SUP_CHECK_PERIOD);
   }
-	TIM2->CCR1 = 0; TIM2->CCR2 = 0; TIM2->CCR4 = 0;
+  COOP_END(ctx);
 }
 
-void transitionON(){
+//Velocity for a direction that has been held since heldSince, ramping from
+//SLEW_START_VEL to SLEW_MAX_VEL so short holds stay precise.
+RAMFUNC float slewVelocity(int8_t dir, uint32_t heldSince, uint32_t now){
+  if (dir == 0){
+    return 0;
+  }
+  uint32_t held = now - heldSince;
+  float speed = SLEW_MAX_VEL;
+  if (held < SLEW_RAMP_MS){
+    speed = SLEW_START_VEL + (SLEW_MAX_VEL - SLEW_START_VEL) * held / SLEW_RAMP_MS;
+  }
+  return dir * speed;
+}
 
-	for(int i = 0; i < NUMOFBLINKS; i++){
-	  HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_3);
-	  osSemaphoreRelease( stateSmphrHandle );
-	  osDelay(20);
-	}
-  UNIQUE_threads[0] = osThreadNew(StartCtrlSysTask, NULL, &controlSysTask_attributes);
-  UNIQUE_threads[1] = osThreadNew(StartIMUTask, NULL, &imuTask_attributes);
-  UNIQUE_threads[2] = osThreadNew(StartTargetSetTask, NULL, &targetSetTask_attributes);
+/*
+ * Hold-to-slew: called every control tick with targetSmphr held.  The held
+ * direction buttons are turned into a ramping velocity command for the yaw
+ * and pitch profiles, whose output becomes the PID setpoints.
+ */
+RAMFUNC void updateManualSlew(){
+  uint32_t now = HAL_GetTick();
+  uint32_t dtMs = now - lastSlewTick;
+  lastSlewTick = now;
+  if (dtMs > SLEW_MAX_DT_MS){
+    dtMs = SLEW_MAX_DT_MS;
+  }
+  float dt = dtMs * 0.001f;
+
+  uint8_t held = debouncer_pressed();
+  int8_t yawDir = ((held >> BUTTON_RIGHT) & 1) - ((held >> BUTTON_LEFT) & 1);
+  int8_t pitchDir = ((held >> BUTTON_UP) & 1) - ((held >> BUTTON_DOWN) & 1);
+
+  //the ramp restarts whenever a direction is pressed or reversed
+  if (yawDir != yawSlewDir){
+    yawSlewDir = yawDir;
+    yawHeldSince = now;
+  }
+  if (pitchDir != pitchSlewDir){
+    pitchSlewDir = pitchDir;
+    pitchHeldSince = now;
+  }
+
+  if (yawDir == 0 && pitchDir == 0 && yawProfile.velocity == 0 && pitchProfile.velocity == 0){
+    return;
+  }
+
+  motionProfile_stepVelocity(&yawProfile, slewVelocity(yawDir, yawHeldSince, now), dt);
+  motionProfile_stepVelocity(&pitchProfile, slewVelocity(pitchDir, pitchHeldSince, now), dt);
+  //keep the setpoints inside the angles the pulse limits can reach
+  setpointYaw = motionProfile_clamp(&yawProfile, (pwmLowYaw - PWM_MID) * SERVO_DEG_PER_COUNT,
+                                    (pwmHighYaw - PWM_MID) * SERVO_DEG_PER_COUNT);
+  setpointPitch = motionProfile_clamp(&pitchProfile, (pwmLow - PWM_MID) * SERVO_DEG_PER_COUNT,
+                                      (pwmHigh - PWM_MID) * SERVO_DEG_PER_COUNT);
+  yawCtrl.setTarget(setpointYaw);
+  pitchCtrl.setTarget(setpointPitch);
+}
+
+static uint32_t floatBits(float value){
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+/**
+ * Restores the tunable settings from the parameter store, falling back to
+ * the compiled-in defaults for keys never written and for stored values
+ * that are out of range, and applies them.
+ */
+void loadParams(){
+  uint32_t defaults[PARAM_COUNT];
+
+  defaults[PARAM_KP_YAW] = floatBits(KP_y);
+  defaults[PARAM_KI_YAW] = floatBits(KI_y);
+  defaults[PARAM_KD_YAW] = floatBits(KD_y);
+  defaults[PARAM_KP_PITCH] = floatBits(KP_p);
+  defaults[PARAM_KI_PITCH] = floatBits(KI_p);
+  defaults[PARAM_KD_PITCH] = floatBits(KD_p);
+  defaults[PARAM_KP_ROLL] = floatBits(KP_r);
+  defaults[PARAM_KI_ROLL] = floatBits(KI_r);
+  defaults[PARAM_KD_ROLL] = floatBits(KD_r);
+  defaults[PARAM_PWM_LOW] = PWM_LOW;
+  defaults[PARAM_PWM_HIGH] = PWM_HIGH;
+  defaults[PARAM_PWM_LOW_YAW] = PWM_LOW_Y;
+  defaults[PARAM_PWM_HIGH_YAW] = PWM_HIGH_Y;
+  defaults[PARAM_CONTROL_PERIOD] = CONTROL_FREQ;
+  defaults[PARAM_IMU_PERIOD] = IMU_FREQ;
+  defaults[PARAM_CINEMATIC_PERIOD] = UNIQUE_FREQ;
+  defaults[PARAM_CINEMATIC_PITCH] = (uint32_t)CINEMATIC_PITCH_OFFSET;
+  defaults[PARAM_CINEMATIC_ROLL] = (uint32_t)CINEMATIC_ROLL_OFFSET;
+  params_init(defaults, PARAM_COUNT);
+  gimbalParams_sanitize(defaults);
+  applyParams();
+}
 
+/**
+ * Pushes the current parameter values to the controllers and the settings
+ * globals.  setPID() takes the gains as (p, i, d).  Outside of start-up,
+ * call with targetSmphr held so that the control task never sees a
+ * half-applied set.
+ */
+void applyParams(){
+  yawCtrl.setPID(params_getFloat(PARAM_KP_YAW), params_getFloat(PARAM_KI_YAW), params_getFloat(PARAM_KD_YAW));
+  pitchCtrl.setPID(params_getFloat(PARAM_KP_PITCH), params_getFloat(PARAM_KI_PITCH), params_getFloat(PARAM_KD_PITCH));
+  rollCtrl.setPID(params_getFloat(PARAM_KP_ROLL), params_getFloat(PARAM_KI_ROLL), params_getFloat(PARAM_KD_ROLL));
+  pwmLow = params_get(PARAM_PWM_LOW);
+  pwmHigh = params_get(PARAM_PWM_HIGH);
+  pwmLowYaw = params_get(PARAM_PWM_LOW_YAW);
+  pwmHighYaw = params_get(PARAM_PWM_HIGH_YAW);
+  controlPeriod = params_get(PARAM_CONTROL_PERIOD);
+  imuPeriod = params_get(PARAM_IMU_PERIOD);
+  cinematicPeriod = params_get(PARAM_CINEMATIC_PERIOD);
+  cinematicPitch = (int32_t)params_get(PARAM_CINEMATIC_PITCH);
+  cinematicRoll = (int32_t)params_get(PARAM_CINEMATIC_ROLL);
+}
+
+//Stores every BB_DECIMATION-th control tick in the flight recorder.  Called with the semaphores held.
+RAMFUNC void recordBlackBox(){
+  bb_sample_t s;
+  uint32_t cycles = ctrlTickCycles.last / 16;
+  uint16_t maxCycles;
+  PIDController<float> *ctrl[3] = { &yawCtrl, &pitchCtrl, &rollCtrl };
+
+  if (!blackbox_due((cycles > UINT16_MAX) ? UINT16_MAX : (uint16_t)cycles, &maxCycles)){
+    return;
+  }
+  s.tick = (uint16_t)HAL_GetTick();
+  s.cycles = maxCycles;
+  for (uint8_t axis = 0; axis < 3; axis++){
+    s.orientation[axis] = blackbox_pack(ctrl[axis]->getFeedback(), BB_ANGLE_SCALE);
+    s.target[axis] = blackbox_pack(ctrl[axis]->getTarget(), BB_ANGLE_SCALE);
+    s.p[axis] = blackbox_pack(ctrl[axis]->getProportionalComponent(), BB_PID_SCALE);
+    s.i[axis] = blackbox_pack(ctrl[axis]->getIntegralComponent(), BB_PID_SCALE);
+    s.d[axis] = blackbox_pack(ctrl[axis]->getDerivativeComponent(), BB_PID_SCALE);
+  }
+  for (uint8_t axis = 0; axis < SERVO_COUNT; axis++){
+    s.ccr[axis] = servo_get(axis);
+  }
+  blackbox_record(&s);
 }
 
-void transitionUNIQUE(){
-  for (int i = 0; i < UNIQUE_NUM_THREADS1; ++i){
-    if ( !(osThreadGetState(UNIQUE_threads[i]) == osThreadTerminated) ){
-      osThreadTerminate(UNIQUE_threads[i]);
+//Adds this control tick to the per-axis control metrics.  Called with the semaphores held.
+RAMFUNC void recordControlMetrics(){
+  PIDController<float> *ctrl[SERVO_COUNT] = { &yawCtrl, &pitchCtrl, &rollCtrl };
+  uint32_t now = HAL_GetTick();
+
+  for (uint8_t axis = 0; axis < SERVO_COUNT; axis++){
+    if (axisMetricsRestart){
+      ctrlMetrics_start(&axisMetrics[axis], now);
     }
+    ctrlMetrics_update(&axisMetrics[axis], now, ctrl[axis]->getTarget(), ctrl[axis]->getFeedback(), servo_get(axis));
   }
-  OFF_threads[0] = osThreadNew(StartUniqueMovement, NULL, &uniqueMovement_attributes);
+  axisMetricsRestart = false;
+}
 
+void recordCycles(cycle_stats_t *stats, uint32_t cycles){
+  stats->last = cycles;
+  stats->total += cycles;
+  stats->count++;
+  if (cycles > stats->max){
+    stats->max = cycles;
+  }
 }
 
-void yawMovement(bool &polarity){
-   if (polarity){
-      CCR1 += 30;
+/**
+ * Enters or leaves the idle hold.  Axes in IDLE_PWM_STOP_AXES stop receiving
+ * pulses while idle; their CCR is kept so they resume where they were.
+ */
+void setServoIdle(bool idle){
+  servoIdle = idle;
+  if (idle){
+    servoIdleEntries++;
+  }
+  else{
+    settledSince = HAL_GetTick();
+  }
+  for (uint8_t axis = 0; axis < SERVO_COUNT; axis++){
+    if (IDLE_PWM_STOP_AXES & (1 << axis)){
+      if (idle){
+        servo_stop(axis);
+      }
+      else{
+        servo_start(axis);
+      }
     }
-    else{
-      CCR1 -= 30;
+  }
+}
+
+/*
+ * Idle detector, run after every control tick.  The loop goes idle once all
+ * three errors have stayed small for IDLE_SETTLE_MS with no manual slew, and
+ * wakes as soon as an error grows or a slew starts.  The IMU task wakes it
+ * directly when it sees motion.
+ */
+RAMFUNC void updateServoIdle(){
+  float limit = servoIdle ? IDLE_WAKE_ERROR_DEG : IDLE_ERROR_DEG;
+  bool still = fabsf(yawCtrl.getError()) < limit && fabsf(pitchCtrl.getError()) < limit
+            && fabsf(rollCtrl.getError()) < limit
+            && yawProfile.velocity == 0 && pitchProfile.velocity == 0
+            && yawSlewDir == 0 && pitchSlewDir == 0;
+  uint32_t now = HAL_GetTick();
+
+  if (!still){
+    settledSince = now;
+    if (servoIdle){
+      servoIdleWakes++;
+      setServoIdle(false);
     }
+  }
+  else if (!servoIdle && now - settledSince >= IDLE_SETTLE_MS){
+    setServoIdle(true);
+  }
+}
 
-    if (CCR1 > PWM_HIGH_Y){
-      polarity = false;
+//Largest change of any Euler angle between two IMU samples, yaw unwrapped.
+float orientationChange(const bno055_vector_t *a, const bno055_vector_t *b){
+  float dx = fabsf(fast_wrap180(a->x - b->x));
+  float dy = fabsf(a->y - b->y);
+  float dz = fabsf(a->z - b->z);
+  return fmaxf(dx, fmaxf(dy, dz));
+}
+
+/*
+ * Body of the IMU task for any orientation source.  A failed read keeps the
+ * last good orientation rather than feeding garbage to the PIDs; too many
+ * in a row are an IMU fault.
+ */
+template <class Backend>
+void runImuTask(ImuSource<Backend> &source){
+  bno055_vector_t lastOrientation = {0};
+  bno055_vector_t euler;
+  uint32_t failedReads = 0;
+
+  for(;;){
+    osEventFlagsWait(taskGates, GATE_IMU, osFlagsWaitAny | osFlagsNoClear, osWaitForever);
+
+    //bring the IMU up the first time the gimbal is switched on
+    if (!imuReady){
+      if (!source.begin()){
+        postStateEvent(EV_IMU_FAULT);
+        osDelay(modeChangeDelay);
+        continue;
+      }
+      imuReady = true;
+      supervisor_setDeadline(SUP_IMU, SUP_IMU_DEADLINE);
     }
-    else if (CCR1 < PWM_LOW_Y){
-      polarity = true;
+
+    if (source.read(HAL_GetTick(), &euler)){
+      uint32_t stamp = timestamp_us();  //the read has just completed
+      failedReads = 0;
+      osSemaphoreAcquire( spatialSmphrHandle, osWaitForever );
+      spatialOrientation = euler;
+      spatialStampUs = stamp;
+      spatialSeq++;
+      osSemaphoreRelease( spatialSmphrHandle );
+
+      //compare this task's own copy; spatialOrientation is only safe under the semaphore
+      if (servoIdle && orientationChange(&euler, &lastOrientation) > IDLE_MOTION_DEG){
+        osThreadFlagsSet(controlSysTaskHandle, CTRL_WAKE_FLAG);
+      }
+      lastOrientation = euler;
+    }
+    else if (++failedReads == IMU_FAILED_CYCLES){
+      postStateEvent(EV_IMU_FAULT);
+    }
+
+    //a stalled read can starve the supervisor's check, so the beat catches the miss too
+    if (supervisor_beat(SUP_IMU) && sm_isIn(&gimbalSM, GIMBAL_ACTIVE)){
+      enterDeadlineSafeState();
     }
-    TIM2->CCR1 = CCR1;
+    osDelay(imuPeriod);
+  }
 }
 /* USER CODE END 4 */
 
@@ -782,11 +1809,6 @@ void StartCtrlSysTask(void *argument)
 {
   /* USER CODE BEGIN 5 */
 
-	CCR1 = CCR4 = PWM_MID;
-  CCR2 = PWM_MID-1500;
-	TIM2->CCR1 = CCR1; TIM2->CCR2 = CCR2; TIM2->CCR4 = CCR4;
-	HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_1);  HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_2);  HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_4);
-
 	yawCtrl.setTarget(setpointYaw); yawCtrl.registerTimeFunction(HAL_GetTick);
 
 	pitchCtrl.setTarget(setpointPitch); pitchCtrl.registerTimeFunction(HAL_GetTick);
@@ -796,59 +1818,59 @@ void StartCtrlSysTask(void *argument)
   /* Infinite loop */
   for(;;)
   {
+	osEventFlagsWait(taskGates, GATE_CTRL, osFlagsWaitAny | osFlagsNoClear, osWaitForever);
 	osSemaphoreAcquire( spatialSmphrHandle, osWaitForever );
 	osSemaphoreAcquire( targetSmphrHandle, osWaitForever );
 
+		uint32_t tickStart = DWT->CYCCNT;
+		if (spatialSeq != 0){
+			sampleAge_update(&ctrlSampleAge, spatialSeq, spatialStampUs, timestamp_us());
+		}
+		updateManualSlew();
 		yawCtrl.tick();
 		pitchCtrl.tick();
 		rollCtrl.tick();
+		updateServoIdle();
+		recordCycles(&ctrlTickCycles, DWT->CYCCNT - tickStart);
+		recordControlMetrics();
+		recordBlackBox();
 
 	osSemaphoreRelease( targetSmphrHandle );
 	osSemaphoreRelease( spatialSmphrHandle );
-	osDelay(CONTROL_FREQ);
+	if (supervisor_beat(SUP_CONTROL) && sm_isIn(&gimbalSM, GIMBAL_ACTIVE)){
+		enterDeadlineSafeState();
+	}
+
+	if (servoIdle){
+		//sleep at the idle rate unless the IMU task reports motion
+		if (osThreadFlagsWait(CTRL_WAKE_FLAG, osFlagsWaitAny, IDLE_CONTROL_PERIOD) == CTRL_WAKE_FLAG && servoIdle){
+			servoIdleWakes++;
+			setServoIdle(false);
+		}
+	}
+	else{
+		osDelay(controlPeriod);
+	}
   }
-  HAL_TIM_PWM_Stop(&htim2, TIM_CHANNEL_1);  HAL_TIM_PWM_Stop(&htim2, TIM_CHANNEL_2);  HAL_TIM_PWM_Stop(&htim2, TIM_CHANNEL_4);
+  servo_stopAll();
   osThreadTerminate(NULL);
   /* USER CODE END 5 */
 }
 
-/* USER CODE BEGIN Header_StartLedBattTask */
+/* USER CODE BEGIN Header_StartCoopTask */
 /**
-* @brief Function implementing the ledBattTask thread.
+* @brief Function implementing the coopTask thread.  Hosts the LED, boot
+* animation and cinematic routines on a single shared stack.
 * @param argument: Not used
 * @retval None
 */
-/* USER CODE END Header_StartLedBattTask */
-void StartLedBattTask(void *argument)
+/* USER CODE END Header_StartCoopTask */
+void StartCoopTask(void *argument)
 {
-  /* USER CODE BEGIN StartLedBattTask */
-  /* Infinite loop */
-  for(;;){
-
-   osSemaphoreAcquire( stateSmphrHandle, osWaitForever );
-
-	  if (state == OFF_STATE){
-		  HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_3);
-		  osSemaphoreRelease( stateSmphrHandle );
-		  osDelay(1000);
-	  }
-	  else if (state == ON_STATE){
-		  HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_3);
-		  osSemaphoreRelease( stateSmphrHandle );
-		  osDelay(500);
-	  }
-	  else if (state == UNIQUE_STATE || state == -1){
-		  HAL_GPIO_TogglePin(GPIOB, GPIO_PIN_3);
-		  osSemaphoreRelease( stateSmphrHandle );
-		  osDelay(100);
-	  }
-	  else{
-		  osSemaphoreRelease( stateSmphrHandle );
-	  }
-
-  }
+  /* USER CODE BEGIN StartCoopTask */
+  coop_run();
   osThreadTerminate(NULL);
-  /* USER CODE END StartLedBattTask */
+  /* USER CODE END StartCoopTask */
 }
 
 /* USER CODE BEGIN Header_StartIMUTask */
@@ -862,26 +1884,16 @@ void StartIMUTask(void *argument)
 {
   /* USER CODE BEGIN StartIMUTask */
   /* Infinite loop */
-
-	bno055_assignI2C(&hi2c1);
-	bno055_setup();
-	bno055_setOperationModeNDOF();
-  for(;;)
-  {
-	osSemaphoreAcquire( spatialSmphrHandle, osWaitForever );
-
-		spatialOrientation = bno055_getVectorEuler();
-
-	osSemaphoreRelease( spatialSmphrHandle );
-	osDelay(IMU_FREQ);
-  }
+  runImuTask(imu);
   osThreadTerminate(NULL);
   /* USER CODE END StartIMUTask */
 }
 
 /* USER CODE BEGIN Header_StartTargetSetTask */
 /**
-* @brief Function implementing the downButtonTask thread.
+* @brief Function implementing the targetSetTask thread.  Consumes every
+* button event in order and forwards mode presses to the state machine.
+* Direction buttons are read as held levels by the control task instead.
 * @param argument: Not used
 * @retval None
 */
@@ -889,46 +1901,25 @@ void StartIMUTask(void *argument)
 void StartTargetSetTask(void *argument)
 {
   /* USER CODE BEGIN StartTargetSetTask */
+  input_event_t ev;
+
   /* Infinite loop */
   for(;;)
   {
-	osEventFlagsWait(setPointButtonEvents,0x50, osFlagsWaitAll, osWaitForever);
-
-	osSemaphoreAcquire( targetSmphrHandle, osWaitForever );
-
-	if (!HAL_GPIO_ReadPin (GPIOA,GPIO_PIN_6)){
-
-		setpointPitch -= 3;
-		pitchCtrl.setTarget(setpointPitch);
-
-	}
-	else if (!HAL_GPIO_ReadPin (GPIOA,GPIO_PIN_7)){
-
-		setpointPitch += 3;
-
-		pitchCtrl.setTarget(setpointPitch);
-
-	}
-	else if (!HAL_GPIO_ReadPin (GPIOB,GPIO_PIN_1)){
-
-		setpointYaw -=  3;
-		yawCtrl.setTarget(setpointYaw);
-
-	}
-	else if (!HAL_GPIO_ReadPin (GPIOB,GPIO_PIN_0)){
-
-	  	setpointYaw +=  3;
-	  	yawCtrl.setTarget(setpointYaw);
+	osEventFlagsWait(setPointButtonEvents, INPUT_EVENT_FLAG, osFlagsWaitAny, osWaitForever);
 
+	while (inputEvents_pop(&ev)){
+		if (ev.button == BUTTON_MODE && ev.edge == EDGE_PRESS){
+			postStateEvent(EV_MODE_BUTTON);
+			inputEvents_recordLatency(&ev);
+		}
+		else if (ev.button == BUTTON_CAPTURE && ev.edge == EDGE_LONG_PRESS){
+			blackbox_freeze(BB_FREEZE_BUTTON);
+		}
 	}
-
-	osSemaphoreRelease( targetSmphrHandle );
-    osEventFlagsClear(setPointButtonEvents, 0x50);
-	osDelay(debounceDelay);
-
   }
     osThreadTerminate(NULL);
-  /* USER CODE END downButton */
+  /* USER CODE END StartTargetSetTask */
 }
 
 /* USER CODE BEGIN Header_StartStateMachine */
@@ -941,69 +1932,25 @@ void StartTargetSetTask(void *argument)
 void StartStateMachine(void *argument)
 {
   /* USER CODE BEGIN StartStateMachine */
+  uint8_t event;
 
-//   #define OFF_STATE 0
-// #define ON_STATE 1
-// #define UNIQUE_STATE 2
   /* Infinite loop */
-	state = OFF_STATE;
-	transitionOFF();
   for(;;)
   {
-    osEventFlagsWait(stateMachineEvents,0x69, osFlagsWaitAll, osWaitForever);
-	osSemaphoreAcquire( stateSmphrHandle, osWaitForever );
-
-    state++; //increment the state :3
-    switch(state){
-      case OFF_STATE:
-      transitionOFF();
-      break; 
-      case ON_STATE:
-      transitionON();
-      break;
-      case UNIQUE_STATE:
-      transitionUNIQUE();
-      state = -1;
-      break;
-      default:
-      state = OFF_STATE;
+    //the entry actions switch the clock; a deferred switch is retried here
+    uint32_t timeout = clock_pending() ? CLOCK_RETRY_MS : osWaitForever;
+    if (osMessageQueueGet(stateEventQueue, &event, NULL, timeout) == osOK){
+      sm_dispatch(&gimbalSM, event);
+    }
+    else if (clock_pending()){
+      clock_retry();
     }
-    osSemaphoreRelease( stateSmphrHandle);
-
-
-    osEventFlagsClear(stateMachineEvents, 0x69);
-    osDelay( modeChangeDelay );
   }
   osThreadTerminate(NULL);
   /* USER CODE END StartStateMachine */
 }
 
 
-/* USER CODE BEGIN Header_StartUniqueMovement */
-/**
-* @brief Function implementing the uniqueMovement thread.
-* @param argument: Not used
-* @retval None
-*/
-/* USER CODE END Header_StartUniqueMovement */
-void StartUniqueMovement(void *argument)
-{
-  /* USER CODE BEGIN StartUniqueMovement */
-  /* Infinite loop */
-  bool direction = true;
-  HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_1);  HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_2);  HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_4);
-  TIM2->CCR2 = PWM_MID-1500;
-  TIM2->CCR4 = PWM_MID+1300;
-  for(;;)
-  {
-   yawMovement(direction);
-   osDelay(UNIQUE_FREQ);
-  }
-  HAL_TIM_PWM_Stop(&htim2, TIM_CHANNEL_1);  HAL_TIM_PWM_Stop(&htim2, TIM_CHANNEL_2);  HAL_TIM_PWM_Stop(&htim2, TIM_CHANNEL_4);
-  osThreadTerminate(NULL);
-  /* USER CODE END StartUniqueMovement */
-}
-
 /**
   * @brief  Period elapsed callback in non blocking mode
   * @note   This function is called  when TIM6 interrupt took place, inside
@@ -1021,6 +1968,9 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
     HAL_IncTick();
   }
   /* USER CODE BEGIN Callback 1 */
+  if (htim->Instance == TIM6) {
+    debouncer_sample();
+  }
 
   /* USER CODE END Callback 1 */
 }
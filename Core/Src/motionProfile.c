@@ -0,0 +1,79 @@
+#include "motionProfile.h"
+#include "ramfunc.h"
+
+/**
+ * Initializes a profile at rest.
+ * @param mp The profile.
+ * @param position The starting setpoint.
+ * @param maxVelocity The velocity limit, degrees per second.
+ * @param maxAccel The acceleration limit, degrees per second squared.
+ */
+void motionProfile_init(motion_profile_t *mp, float position, float maxVelocity, float maxAccel) {
+  mp->maxVelocity = maxVelocity;
+  mp->maxAccel = maxAccel;
+  motionProfile_reset(mp, position);
+}
+
+/**
+ * Moves the profile to a new setpoint and stops it there.
+ */
+void motionProfile_reset(motion_profile_t *mp, float position) {
+  mp->position = position;
+  mp->velocity = 0;
+}
+
+/**
+ * Advances the profile by one control tick.  The velocity approaches the
+ * command no faster than the acceleration limit, so starting and stopping
+ * are both ramped.
+ * @param mp The profile.
+ * @param command The wanted velocity, degrees per second.
+ * @param dt The time since the previous step, seconds.
+ * @return The new setpoint.
+ */
+RAMFUNC float motionProfile_stepVelocity(motion_profile_t *mp, float command, float dt) {
+  if (command > mp->maxVelocity) {
+    command = mp->maxVelocity;
+  }
+  else if (command < -mp->maxVelocity) {
+    command = -mp->maxVelocity;
+  }
+
+  float maxChange = mp->maxAccel * dt;
+  float change = command - mp->velocity;
+  if (change > maxChange) {
+    change = maxChange;
+  }
+  else if (change < -maxChange) {
+    change = -maxChange;
+  }
+
+  mp->velocity += change;
+  mp->position += mp->velocity * dt;
+  return mp->position;
+}
+
+/**
+ * Holds the profile inside a travel range.  At a limit the setpoint stops
+ * there and any velocity further out is dropped, so reversing moves away
+ * at once instead of first unwinding travel the servo never made.
+ * @param mp The profile.
+ * @param low The lowest setpoint allowed.
+ * @param high The highest setpoint allowed.
+ * @return The clamped setpoint.
+ */
+RAMFUNC float motionProfile_clamp(motion_profile_t *mp, float low, float high) {
+  if (mp->position < low) {
+    mp->position = low;
+    if (mp->velocity < 0) {
+      mp->velocity = 0;
+    }
+  }
+  else if (mp->position > high) {
+    mp->position = high;
+    if (mp->velocity > 0) {
+      mp->velocity = 0;
+    }
+  }
+  return mp->position;
+}
@@ -0,0 +1,283 @@
+#include "paramStore.h"
+#include "stm32l4xx_hal.h"
+#include <string.h>
+
+#define PAGE_MAGIC 0x4D524150UL   //"PARM"
+#define SLOTS_PER_PAGE (FLASH_PAGE_SIZE / sizeof(uint64_t))
+#define ERASED 0xFFFFFFFFFFFFFFFFULL
+
+typedef struct {
+  uint16_t key;
+  uint16_t crc;
+  uint32_t value;
+} param_record_t;
+
+extern uint8_t _sparams[];   //start of the PARAMS region, from the linker script
+
+static uint32_t values[PARAM_MAX_KEYS];
+static uint32_t persisted;   //keys with a record in flash
+static uint32_t staged;      //keys changed in RAM only
+static uint8_t numKeys;
+static uint8_t activePage;
+static bool haveActive;
+static uint32_t activeSeq;
+static uint32_t nextSlot;    //slot 0 of each page holds its header
+static param_store_stats_t stats;
+
+//CRC-16/CCITT, polynomial 0x1021
+static const uint16_t crcTable[256] = {
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+  0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+  0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+  0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+  0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+  0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+  0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+  0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+  0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+  0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+  0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+  0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+  0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+  0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+  0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+  0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+  0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+  0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+  0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+  0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+  0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+  0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+  0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+  0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+  0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+  0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+  0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+  0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+  0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+  0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+  0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+  0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+
+static uint16_t recordCrc(uint16_t key, uint32_t value) {
+  uint8_t bytes[6] = {
+    key & 0xFF, key >> 8,
+    value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24
+  };
+  uint16_t crc = 0xFFFF;
+  for (uint8_t i = 0; i < sizeof(bytes); ++i) {
+    crc = (crc << 8) ^ crcTable[(crc >> 8) ^ bytes[i]];
+  }
+  return crc;
+}
+
+static const uint64_t *slotAddr(uint8_t page, uint32_t slot) {
+  return (const uint64_t *)(_sparams + page * FLASH_PAGE_SIZE) + slot;
+}
+
+static bool program(const uint64_t *addr, uint64_t data) {
+  HAL_FLASH_Unlock();
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+  HAL_StatusTypeDef status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, (uint32_t)addr, data);
+  HAL_FLASH_Lock();
+  if (status != HAL_OK) {
+    stats.writeErrors++;
+  }
+  return status == HAL_OK;
+}
+
+static bool erasePage(uint8_t page) {
+  FLASH_EraseInitTypeDef erase = {0};
+  uint32_t pageError;
+
+  erase.TypeErase = FLASH_TYPEERASE_PAGES;
+  erase.Banks = FLASH_BANK_1;
+  erase.Page = ((uint32_t)slotAddr(page, 0) - FLASH_BASE) / FLASH_PAGE_SIZE;
+  erase.NbPages = 1;
+
+  HAL_FLASH_Unlock();
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+  HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &pageError);
+  HAL_FLASH_Lock();
+  if (status != HAL_OK) {
+    stats.writeErrors++;
+  }
+  return status == HAL_OK;
+}
+
+static uint64_t packRecord(uint8_t key, uint32_t value) {
+  param_record_t rec = { key, recordCrc(key, value), value };
+  uint64_t data;
+  memcpy(&data, &rec, sizeof(data));
+  return data;
+}
+
+static uint64_t packHeader(uint32_t seq) {
+  return ((uint64_t)seq << 32) | PAGE_MAGIC;
+}
+
+/*
+ * Copies every persisted value into the next page and makes it the active
+ * one.  The header is written last, so a reset part-way through leaves the
+ * old page in charge.
+ */
+static bool compact(void) {
+  uint8_t to = (activePage + 1) % PARAM_STORE_PAGES;
+  uint32_t slot = 1;
+
+  if (!erasePage(to)) {
+    return false;
+  }
+  for (uint8_t key = 0; key < numKeys; ++key) {
+    if (persisted & (1UL << key)) {
+      if (!program(slotAddr(to, slot), packRecord(key, values[key]))) {
+        return false;
+      }
+      slot++;
+    }
+  }
+  if (!program(slotAddr(to, 0), packHeader(activeSeq + 1))) {
+    return false;
+  }
+  if (haveActive) {
+    erasePage(activePage);
+  }
+
+  activePage = to;
+  activeSeq++;
+  haveActive = true;
+  nextSlot = slot;
+  stats.records = slot - 1;
+  stats.compactions++;
+  return true;
+}
+
+/**
+ * Loads the defaults and then every valid record of the active page into the
+ * RAM table.  Later records override earlier ones.
+ * @param defaults One value per key, used for keys never written.
+ * @param count The number of keys, at most PARAM_MAX_KEYS.
+ */
+void params_init(const uint32_t *defaults, uint8_t count) {
+  uint32_t start = DWT->CYCCNT;
+
+  numKeys = (count > PARAM_MAX_KEYS) ? PARAM_MAX_KEYS : count;
+  memcpy(values, defaults, numKeys * sizeof(uint32_t));
+  memset(&stats, 0, sizeof(stats));
+  persisted = 0;
+  staged = 0;
+  haveActive = false;
+
+  //the active page is the valid one with the newest sequence number
+  for (uint8_t page = 0; page < PARAM_STORE_PAGES; ++page) {
+    uint64_t header = *slotAddr(page, 0);
+    uint32_t seq = header >> 32;
+    if ((uint32_t)header == PAGE_MAGIC && (!haveActive || (int32_t)(seq - activeSeq) > 0)) {
+      haveActive = true;
+      activePage = page;
+      activeSeq = seq;
+    }
+  }
+
+  nextSlot = 1;
+  if (haveActive) {
+    for (; nextSlot < SLOTS_PER_PAGE; ++nextSlot) {
+      uint64_t data = *slotAddr(activePage, nextSlot);
+      if (data == ERASED) {
+        break;
+      }
+      param_record_t rec;
+      memcpy(&rec, &data, sizeof(rec));
+      if (rec.key >= numKeys || rec.crc != recordCrc(rec.key, rec.value)) {
+        stats.badRecords++;
+        continue;
+      }
+      values[rec.key] = rec.value;
+      persisted |= 1UL << rec.key;
+    }
+  }
+  stats.records = nextSlot - 1;
+  stats.scanUs = (DWT->CYCCNT - start) / (SystemCoreClock / 1000000U);
+}
+
+uint32_t params_get(uint8_t key) {
+  return (key < numKeys) ? values[key] : 0;
+}
+
+float params_getFloat(uint8_t key) {
+  uint32_t bits = params_get(key);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/**
+ * Changes a parameter in RAM and appends it to flash.  Writing the value a
+ * key already holds in flash costs nothing.
+ * @return False if the key is invalid or flash could not be written; the RAM
+ * value is updated either way for a valid key.
+ */
+bool params_set(uint8_t key, uint32_t value) {
+  if (key >= numKeys) {
+    return false;
+  }
+  if ((persisted & (1UL << key)) && values[key] == value) {
+    return true;
+  }
+
+  values[key] = value;
+  persisted |= 1UL << key;
+  staged &= ~(1UL << key);
+
+  //the first write, or a full page, starts a new page holding every value
+  if (!haveActive || nextSlot >= SLOTS_PER_PAGE) {
+    return compact();
+  }
+  if (!program(slotAddr(activePage, nextSlot), packRecord(key, value))) {
+    return false;
+  }
+  nextSlot++;
+  stats.records++;
+  return true;
+}
+
+bool params_setFloat(uint8_t key, float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return params_set(key, bits);
+}
+
+/**
+ * Changes a parameter in RAM only.  It reverts at the next reset unless
+ * params_commit() is called.
+ * @return False if the key is invalid.
+ */
+bool params_stage(uint8_t key, uint32_t value) {
+  if (key >= numKeys) {
+    return false;
+  }
+  values[key] = value;
+  staged |= 1UL << key;
+  return true;
+}
+
+/**
+ * Writes every staged parameter to flash.
+ * @return False if any write failed.
+ */
+bool params_commit(void) {
+  bool ok = true;
+  for (uint8_t key = 0; key < numKeys; ++key) {
+    if (staged & (1UL << key)) {
+      //params_set skips the write if it already matches, so force it
+      persisted &= ~(1UL << key);
+      ok &= params_set(key, values[key]);
+    }
+  }
+  return ok;
+}
+
+void params_getStats(param_store_stats_t *out) {
+  *out = stats;
+}
@@ -0,0 +1,60 @@
+#include "sampleAge.h"
+#include "stm32l4xx_hal.h"
+#include "ramfunc.h"
+#include <string.h>
+
+#define TIMEBASE_HALF_MS 500   //TIM6 counts 0..999 per tick
+
+/**
+ * Microseconds since boot, modulo 2^32.  Safe with interrupts masked: an
+ * update of TIM6 whose interrupt has not run yet is accounted for.
+ */
+RAMFUNC uint32_t timestamp_us(void) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint32_t ms = HAL_GetTick();
+  uint32_t count = TIM6->CNT;
+  if ((TIM6->SR & TIM_SR_UIF) && count < TIMEBASE_HALF_MS) {
+    ms++;
+  }
+  __set_PRIMASK(primask);
+  return ms * 1000 + count;
+}
+
+void sampleAge_init(sample_age_t *age) {
+  memset(age, 0, sizeof(*age));
+}
+
+/**
+ * Records one use of a sample.
+ * @param seq Sequence number the producer gave the sample, one more per sample.
+ * @param stampUs timestamp_us() when the sample was taken.
+ * @param nowUs timestamp_us() when it is used.
+ */
+RAMFUNC void sampleAge_update(sample_age_t *age, uint32_t seq, uint32_t stampUs, uint32_t nowUs) {
+  uint32_t ageUs = nowUs - stampUs;
+
+  if (age->seen && seq == age->lastSeq) {
+    age->duplicates++;
+  }
+  else {
+    if (age->seen) {
+      age->dropouts += seq - age->lastSeq - 1;
+    }
+    age->fresh++;
+    age->lastSeq = seq;
+    age->seen = true;
+  }
+
+  age->lastAgeUs = ageUs;
+  if (ageUs > age->maxAgeUs) {
+    age->maxAgeUs = ageUs;
+  }
+
+  uint32_t scaled = ageUs >> AGE_HIST_BASE_SHIFT;
+  uint32_t bin = (scaled == 0) ? 0 : 32 - __builtin_clz(scaled);
+  if (bin >= AGE_HIST_BINS) {
+    bin = AGE_HIST_BINS - 1;
+  }
+  age->hist[bin]++;
+}
@@ -0,0 +1,112 @@
+#include "servoOutput.h"
+#include "sampleAge.h"
+#include "ramfunc.h"
+
+static TIM_HandleTypeDef *timer;
+static servo_trace_t trace[SERVO_TRACE_LEN];
+static volatile uint16_t traceCount;
+static volatile bool traceArmed;
+
+static const uint32_t channels[SERVO_COUNT] = { TIM_CHANNEL_1, TIM_CHANNEL_2, TIM_CHANNEL_4 };
+
+static inline volatile uint32_t *compare(uint8_t axis) {
+  switch (axis) {
+  case SERVO_YAW:   return &timer->Instance->CCR1;
+  case SERVO_PITCH: return &timer->Instance->CCR2;
+  default:          return &timer->Instance->CCR4;
+  }
+}
+
+RAMFUNC static void record(uint8_t axis, uint8_t event, uint32_t ccr) {
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint16_t i = traceCount;
+  if (traceArmed && i < SERVO_TRACE_LEN) {
+    trace[i].stampUs = timestamp_us();
+    trace[i].ccr = (uint16_t)ccr;
+    trace[i].axis = axis;
+    trace[i].event = event;
+    traceCount = i + 1;
+    traceArmed = (i + 1 < SERVO_TRACE_LEN);
+  }
+  __set_PRIMASK(primask);
+}
+
+/**
+ * @param pwm The timer whose channels 1, 2 and 4 drive the servos.
+ */
+void servo_init(TIM_HandleTypeDef *pwm) {
+  timer = pwm;
+}
+
+/**
+ * Sets the pulse width of one servo, in timer counts; 0 sends no pulse.
+ */
+RAMFUNC void servo_set(uint8_t axis, uint32_t ccr) {
+  if (axis >= SERVO_COUNT) {
+    return;
+  }
+  *compare(axis) = ccr;
+  if (traceArmed) {
+    record(axis, SERVO_EVENT_WRITE, ccr);
+  }
+}
+
+RAMFUNC uint32_t servo_get(uint8_t axis) {
+  return (axis < SERVO_COUNT) ? *compare(axis) : 0;
+}
+
+//Enables the channel output, which resumes pulses at the current width.
+void servo_start(uint8_t axis) {
+  if (axis >= SERVO_COUNT) {
+    return;
+  }
+  HAL_TIM_PWM_Start(timer, channels[axis]);
+  record(axis, SERVO_EVENT_START, *compare(axis));
+}
+
+//Disables the channel output; the servo goes limp and the width is kept.
+void servo_stop(uint8_t axis) {
+  if (axis >= SERVO_COUNT) {
+    return;
+  }
+  HAL_TIM_PWM_Stop(timer, channels[axis]);
+  record(axis, SERVO_EVENT_STOP, *compare(axis));
+}
+
+void servo_startAll(void) {
+  for (uint8_t axis = 0; axis < SERVO_COUNT; axis++) {
+    servo_start(axis);
+  }
+}
+
+void servo_stopAll(void) {
+  for (uint8_t axis = 0; axis < SERVO_COUNT; axis++) {
+    servo_stop(axis);
+  }
+}
+
+/**
+ * Clears the trace and records the next SERVO_TRACE_LEN events.
+ */
+void servo_traceArm(void) {
+  traceArmed = false;
+  traceCount = 0;
+  traceArmed = true;
+}
+
+uint16_t servo_traceCount(void) {
+  return traceCount;
+}
+
+/**
+ * Reads one trace event, oldest first.
+ * @return False if there is no such event.
+ */
+bool servo_traceGet(uint16_t index, servo_trace_t *out) {
+  if (index >= traceCount) {
+    return false;
+  }
+  *out = trace[index];
+  return true;
+}
@@ -0,0 +1,69 @@
+#include "socEstimator.h"
+
+//Resting Li-ion cell voltage in mV at 0, 10, ..., 100 % charge.
+static const uint16_t ocvCurve[11] = {
+  3300, 3600, 3690, 3750, 3790, 3830, 3870, 3930, 4000, 4080, 4180
+};
+
+static float socFromOcv(float cellMv) {
+  if (cellMv <= ocvCurve[0]) {
+    return 0;
+  }
+  for (uint8_t i = 1; i < 11; ++i) {
+    if (cellMv < ocvCurve[i]) {
+      return 10.0f * (i - 1) + 10.0f * (cellMv - ocvCurve[i - 1]) / (ocvCurve[i] - ocvCurve[i - 1]);
+    }
+  }
+  return 100;
+}
+
+void soc_init(soc_estimator_t *est) {
+  est->vrcMv = 0;
+  est->soc = 0;
+  est->lowCount = 0;
+  est->low = false;
+  est->seeded = false;
+}
+
+/**
+ * Advances the model by one step.  Cheap enough to run at 10 Hz.
+ * @param est The estimator.
+ * @param battMv The measured terminal voltage of the pack.
+ * @param loadMa The estimated current drawn from the pack.
+ * @param dtMs The time since the previous update.
+ * @return The state of charge in percent.
+ */
+uint8_t soc_update(soc_estimator_t *est, uint16_t battMv, float loadMa, uint32_t dtMs) {
+  //the RC pair charges towards I * R1 with time constant tau
+  float alpha = dtMs / (SOC_TAU_MS + dtMs);
+  est->vrcMv += (loadMa * SOC_R1_MOHM * 0.001f - est->vrcMv) * alpha;
+
+  float ocvMv = battMv + loadMa * SOC_R0_MOHM * 0.001f + est->vrcMv;
+  float soc = socFromOcv(ocvMv / SOC_CELLS);
+
+  if (!est->seeded) {
+    est->soc = soc;
+    est->seeded = true;
+  }
+  else {
+    est->soc += (soc - est->soc) * dtMs / (SOC_FILTER_MS + dtMs);
+  }
+
+  //low battery needs a sustained reading and clears with hysteresis
+  if (est->soc < SOC_LOW_PERCENT) {
+    if (est->lowCount < SOC_LOW_SAMPLES) {
+      est->lowCount++;
+    }
+    if (est->lowCount >= SOC_LOW_SAMPLES) {
+      est->low = true;
+    }
+  }
+  else {
+    est->lowCount = 0;
+    if (est->soc > SOC_LOW_CLEAR_PERCENT) {
+      est->low = false;
+    }
+  }
+
+  return (uint8_t)(est->soc + 0.5f);
+}
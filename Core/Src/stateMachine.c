@@ -0,0 +1,125 @@
+#include "stateMachine.h"
+#include <stddef.h>
+
+static int8_t parentOf(const sm_machine_t *sm, int8_t state) {
+  return sm->states[state].parent;
+}
+
+static bool isAncestorOrSelf(const sm_machine_t *sm, int8_t ancestor, int8_t state) {
+  for (uint8_t depth = 0; state != SM_NONE && depth < SM_MAX_DEPTH; ++depth) {
+    if (state == ancestor) {
+      return true;
+    }
+    state = parentOf(sm, state);
+  }
+  return false;
+}
+
+/**
+ * Initializes the machine and runs the entry actions of the initial state and
+ * of all of its ancestors, outermost first.
+ * @param sm The machine to initialize.
+ * @param states One entry per state, indexed by state id.
+ * @param transitions numStates * numEvents cells, row-major by state.
+ * @param numStates The number of states.
+ * @param numEvents The number of events.
+ * @param initial The state to start in.
+ */
+void sm_init(sm_machine_t *sm, const sm_state_t *states,
+             const sm_transition_t *transitions, uint8_t numStates,
+             uint8_t numEvents, int8_t initial) {
+  int8_t path[SM_MAX_DEPTH];
+  uint8_t depth = 0;
+
+  sm->states = states;
+  sm->transitions = transitions;
+  sm->numStates = numStates;
+  sm->numEvents = numEvents;
+  sm->current = initial;
+
+  for (int8_t s = initial; s != SM_NONE && depth < SM_MAX_DEPTH; s = parentOf(sm, s)) {
+    path[depth++] = s;
+  }
+  while (depth > 0) {
+    void (*onEntry)(void) = states[path[--depth]].onEntry;
+    if (onEntry != NULL) {
+      onEntry();
+    }
+  }
+}
+
+/**
+ * Delivers an event to the machine.  The cost is bounded by SM_MAX_DEPTH
+ * table lookups plus the exit and entry actions of the states left and
+ * entered.
+ * @param sm The machine.
+ * @param event The event id, less than numEvents.
+ * @return True if the event caused a transition.
+ */
+bool sm_dispatch(sm_machine_t *sm, uint8_t event) {
+  if (event >= sm->numEvents) {
+    return false;
+  }
+
+  //Find the innermost state that handles this event.
+  const sm_transition_t *t = NULL;
+  int8_t source = sm->current;
+  for (uint8_t depth = 0; source != SM_NONE && depth < SM_MAX_DEPTH; ++depth) {
+    t = &sm->transitions[source * sm->numEvents + event];
+    if (t->target != SM_NONE) {
+      break;
+    }
+    source = parentOf(sm, source);
+  }
+  if (source == SM_NONE || t == NULL || t->target == SM_NONE) {
+    return false;
+  }
+  if (t->guard != NULL && !t->guard()) {
+    return false;
+  }
+
+  int8_t target = t->target;
+
+  /*
+   * The states below the least common ancestor of source and target are left
+   * and re-entered.  A transition from a state to itself, or to one of its
+   * ancestors, leaves and re-enters that state as well.
+   */
+  int8_t lca = (source == target) ? parentOf(sm, source) : source;
+  while (lca != SM_NONE && (lca == target || !isAncestorOrSelf(sm, lca, target))) {
+    lca = parentOf(sm, lca);
+  }
+
+  for (int8_t s = sm->current; s != lca && s != SM_NONE; s = parentOf(sm, s)) {
+    if (sm->states[s].onExit != NULL) {
+      sm->states[s].onExit();
+    }
+  }
+
+  if (t->action != NULL) {
+    t->action();
+  }
+
+  int8_t path[SM_MAX_DEPTH];
+  uint8_t depth = 0;
+  for (int8_t s = target; s != lca && s != SM_NONE && depth < SM_MAX_DEPTH; s = parentOf(sm, s)) {
+    path[depth++] = s;
+  }
+  sm->current = target;
+  while (depth > 0) {
+    void (*onEntry)(void) = sm->states[path[--depth]].onEntry;
+    if (onEntry != NULL) {
+      onEntry();
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Tells whether the machine is in a state, either directly or in one of its
+ * sub-states.
+ */
+bool sm_isIn(const sm_machine_t *sm, int8_t state) {
+  return isAncestorOrSelf(sm, state, sm->current);
+}
@@ -24,6 +24,10 @@
 #include "eventHandler.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "analogMonitor.h"
+#include "lowPower.h"
+#include "tuningLink.h"
+#include "blackBox.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -37,7 +41,6 @@
 
 /* Private macro -------------------------------------------------------------*/
 /* USER CODE BEGIN PM */
-#define debounceDelay 50
 
 /* USER CODE END PM */
 
@@ -87,6 +90,7 @@ void NMI_Handler(void)
 void HardFault_Handler(void)
 {
   /* USER CODE BEGIN HardFault_IRQn 0 */
+  blackbox_freeze(BB_FREEZE_HARDFAULT);
 
   /* USER CODE END HardFault_IRQn 0 */
   while (1)
@@ -163,80 +167,60 @@ void DebugMon_Handler(void)
 /******************************************************************************/
 
 /**
-  * @brief This function handles EXTI line0 interrupt.
+  * @brief This function handles TIM6 global interrupt, DAC channel1 and channel2 underrun error interrupts.
   */
-void EXTI0_IRQHandler(void)
+void TIM6_DAC_IRQHandler(void)
 {
-  /* USER CODE BEGIN EXTI0_IRQn 0 */
-  setpointButtons();
-  //osDelay(debounceDelay);
-  /* USER CODE END EXTI0_IRQn 0 */
-  HAL_GPIO_EXTI_IRQHandler(MCO_Pin);
-  /* USER CODE BEGIN EXTI0_IRQn 1 */
-
-  /* USER CODE END EXTI0_IRQn 1 */
+  /* USER CODE BEGIN TIM6_DAC_IRQn 0 */
+
+  /* USER CODE END TIM6_DAC_IRQn 0 */
+  HAL_TIM_IRQHandler(&htim6);
+  /* USER CODE BEGIN TIM6_DAC_IRQn 1 */
+
+  /* USER CODE END TIM6_DAC_IRQn 1 */
 }
 
+/* USER CODE BEGIN 1 */
+
 /**
-  * @brief This function handles EXTI line1 interrupt.
+  * @brief This function handles DMA1 channel1 global interrupt (ADC1 scans).
   */
-void EXTI1_IRQHandler(void)
+void DMA1_Channel1_IRQHandler(void)
 {
-  /* USER CODE BEGIN EXTI1_IRQn 0 */
-   setpointButtons();
-   //osDelay(debounceDelay);
-  /* USER CODE END EXTI1_IRQn 0 */
-  HAL_GPIO_EXTI_IRQHandler(button_left_Pin);
-  /* USER CODE BEGIN EXTI1_IRQn 1 */
-
-  /* USER CODE END EXTI1_IRQn 1 */
+  analogMonitor_dmaIrq();
 }
 
 /**
-  * @brief This function handles EXTI line4 interrupt.
+  * @brief This function handles EXTI line4 interrupt (on/off button wake from STOP2).
   */
 void EXTI4_IRQHandler(void)
 {
-  /* USER CODE BEGIN EXTI4_IRQn 0 */
-  modeChangeButton();
-  /* USER CODE END EXTI4_IRQn 0 */
-  HAL_GPIO_EXTI_IRQHandler(on_off_mode_Pin);
-  /* USER CODE BEGIN EXTI4_IRQn 1 */
-
-  /* USER CODE END EXTI4_IRQn 1 */
+  lowPower_extiIrq();
 }
 
 /**
-  * @brief This function handles EXTI line[9:5] interrupts.
+  * @brief This function handles EXTI lines 10 to 15 interrupt (tuning link wake from STOP2).
   */
-void EXTI9_5_IRQHandler(void)
+void EXTI15_10_IRQHandler(void)
 {
-  /* USER CODE BEGIN EXTI9_5_IRQn 0 */
- setpointButtons();
-  /* USER CODE END EXTI9_5_IRQn 0 */
-  HAL_GPIO_EXTI_IRQHandler(button_down_Pin);
-  HAL_GPIO_EXTI_IRQHandler(button_up_Pin);
-  HAL_GPIO_EXTI_IRQHandler(button_capture_Pin);
-  /* USER CODE BEGIN EXTI9_5_IRQn 1 */
-
-  /* USER CODE END EXTI9_5_IRQn 1 */
+  lowPower_rxWakeIrq();
 }
 
 /**
-  * @brief This function handles TIM6 global interrupt, DAC channel1 and channel2 underrun error interrupts.
+  * @brief This function handles LPTIM1 global interrupt (tickless idle wake-up).
   */
-void TIM6_DAC_IRQHandler(void)
+void LPTIM1_IRQHandler(void)
 {
-  /* USER CODE BEGIN TIM6_DAC_IRQn 0 */
-
-  /* USER CODE END TIM6_DAC_IRQn 0 */
-  HAL_TIM_IRQHandler(&htim6);
-  /* USER CODE BEGIN TIM6_DAC_IRQn 1 */
-
-  /* USER CODE END TIM6_DAC_IRQn 1 */
+  lowPower_lptimIrq();
 }
 
-/* USER CODE BEGIN 1 */
+/**
+  * @brief This function handles USART2 global interrupt (tuning link receive).
+  */
+void USART2_IRQHandler(void)
+{
+  tuning_uartIrq();
+}
 
 /* USER CODE END 1 */
 
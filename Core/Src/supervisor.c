@@ -0,0 +1,189 @@
+#include "supervisor.h"
+#include "stm32l4xx_hal.h"
+#include "ramfunc.h"
+
+#define IWDG_KEY_RELOAD 0xAAAA
+#define IWDG_KEY_ENABLE 0xCCCC
+#define IWDG_KEY_ACCESS 0x5555
+#define IWDG_MAX_RELOAD 0x1000
+#define IWDG_MAX_PRESCALER 6      //divide by 256
+#define IWDG_UPDATE_TIMEOUT 10    //ms; a register update takes a few LSI cycles
+
+typedef struct {
+  volatile uint32_t lastBeat;
+  volatile uint32_t deadlineMs;
+  uint32_t beats;
+  uint32_t misses;
+  uint32_t maxGapMs;
+  bool late;
+} sup_task_t;
+
+static sup_task_t tasks[SUP_MAX_TASKS];
+static uint32_t withheldFeeds;
+
+/**
+ * Starts the IWDG.  Once started it cannot be stopped until the next reset.
+ * The IWDG is frozen while the core is halted by a debugger.
+ * @param timeoutMs Time without a reload after which the chip resets.
+ */
+void supervisor_init(uint32_t timeoutMs) {
+  DBGMCU->APB1FZR1 |= DBGMCU_APB1FZR1_DBG_IWDG_STOP;
+  IWDG->KR = IWDG_KEY_ENABLE;
+  supervisor_setTimeout(timeoutMs);
+}
+
+/**
+ * Changes the IWDG timeout and reloads the counter.  Picks the smallest
+ * prescaler that can count the timeout, for the finest resolution.
+ */
+void supervisor_setTimeout(uint32_t timeoutMs) {
+  uint32_t counts = timeoutMs * (SUP_LSI_HZ / 1000);
+  uint32_t prescaler = 0;
+
+  while (counts / (4UL << prescaler) > IWDG_MAX_RELOAD && prescaler < IWDG_MAX_PRESCALER) {
+    prescaler++;
+  }
+  uint32_t reload = counts / (4UL << prescaler);
+  if (reload > IWDG_MAX_RELOAD) {
+    reload = IWDG_MAX_RELOAD;
+  }
+  if (reload == 0) {
+    reload = 1;
+  }
+
+  IWDG->KR = IWDG_KEY_ACCESS;
+  IWDG->PR = prescaler;
+  IWDG->RLR = reload - 1;
+  uint32_t start = HAL_GetTick();
+  while (IWDG->SR != 0 && HAL_GetTick() - start < IWDG_UPDATE_TIMEOUT) {
+  }
+  IWDG->KR = IWDG_KEY_RELOAD;
+}
+
+/**
+ * Starts supervising a task.  The deadline counts from now, so the task has
+ * one full deadline for its first beat.
+ * @param deadlineMs Longest allowed gap between two beats.
+ */
+void supervisor_arm(uint8_t task, uint32_t deadlineMs) {
+  if (task >= SUP_MAX_TASKS || deadlineMs == 0) {
+    return;
+  }
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  tasks[task].lastBeat = HAL_GetTick();
+  tasks[task].late = false;
+  tasks[task].deadlineMs = deadlineMs;
+  __set_PRIMASK(primask);
+}
+
+/**
+ * Changes the deadline of a task that is already armed, e.g. once a slow
+ * start-up is over.  Does nothing if the task is disarmed.
+ */
+void supervisor_setDeadline(uint8_t task, uint32_t deadlineMs) {
+  if (task >= SUP_MAX_TASKS || deadlineMs == 0) {
+    return;
+  }
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (tasks[task].deadlineMs != 0) {
+    tasks[task].deadlineMs = deadlineMs;
+  }
+  __set_PRIMASK(primask);
+}
+
+/**
+ * Stops supervising a task, e.g. when it is about to block on purpose.
+ */
+void supervisor_disarm(uint8_t task) {
+  if (task < SUP_MAX_TASKS) {
+    tasks[task].deadlineMs = 0;
+  }
+}
+
+/**
+ * Reports that a task has completed a cycle.  Call from the task itself.
+ * @return True if the gap since the last beat exceeded the deadline and
+ * supervisor_check() has not already counted that miss.
+ */
+RAMFUNC bool supervisor_beat(uint8_t task) {
+  sup_task_t *t = &tasks[task];
+  bool missed = false;
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  uint32_t now = HAL_GetTick();
+  if (t->deadlineMs != 0) {
+    uint32_t gap = now - t->lastBeat;
+    if (gap > t->maxGapMs) {
+      t->maxGapMs = gap;
+    }
+    if (gap > t->deadlineMs && !t->late) {
+      t->misses++;
+      missed = true;
+    }
+  }
+  t->late = false;
+  t->lastBeat = now;
+  t->beats++;
+  __set_PRIMASK(primask);
+  return missed;
+}
+
+/**
+ * Checks every armed task against its deadline and reloads the IWDG if all
+ * of them are on time.  A task that stays late counts as one miss.
+ * @return A mask with bit n set for each task n that has just become late.
+ */
+uint32_t supervisor_check(void) {
+  uint32_t lateMask = 0;
+  uint32_t newlyLate = 0;
+
+  for (uint8_t i = 0; i < SUP_MAX_TASKS; i++) {
+    sup_task_t *t = &tasks[i];
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();   //a beat in between would be missed or counted twice
+    uint32_t now = HAL_GetTick();
+    uint32_t deadline = t->deadlineMs;
+    if (deadline == 0) {
+      __set_PRIMASK(primask);
+      continue;
+    }
+    if (now - t->lastBeat > deadline) {
+      lateMask |= 1UL << i;
+      if (!t->late) {
+        t->late = true;
+        t->misses++;
+        newlyLate |= 1UL << i;
+      }
+    }
+    else {
+      t->late = false;
+    }
+    __set_PRIMASK(primask);
+  }
+
+  if (lateMask == 0) {
+    IWDG->KR = IWDG_KEY_RELOAD;
+  }
+  else {
+    withheldFeeds++;
+  }
+  return newlyLate;
+}
+
+void supervisor_getStats(uint8_t task, sup_task_stats_t *out) {
+  if (task >= SUP_MAX_TASKS) {
+    return;
+  }
+  out->deadlineMs = tasks[task].deadlineMs;
+  out->beats = tasks[task].beats;
+  out->misses = tasks[task].misses;
+  out->maxGapMs = tasks[task].maxGapMs;
+}
+
+//Checks that found a late task and so did not reload the IWDG.
+uint32_t supervisor_withheldFeeds(void) {
+  return withheldFeeds;
+}
@@ -0,0 +1,156 @@
+#include "tuningLink.h"
+#include "coopScheduler.h"
+#include <string.h>
+
+enum {
+  RX_SYNC,
+  RX_CMD,
+  RX_LEN,
+  RX_PAYLOAD,
+  RX_CRC
+};
+
+static UART_HandleTypeDef *uartHandle;
+static uint8_t rxState;
+static uint8_t rxCount;
+static tuning_frame_t rxFrame;       //frame being assembled in the ISR
+static tuning_frame_t mailbox;
+static volatile bool mailboxFull;
+static volatile bool inSession;
+static volatile uint32_t lastFrameTick;
+static tuning_stats_t stats;
+
+static uint8_t crc8(uint8_t crc, uint8_t byte) {
+  crc ^= byte;
+  for (uint8_t bit = 0; bit < 8; ++bit) {
+    crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+  }
+  return crc;
+}
+
+static uint8_t frameCrc(uint8_t cmd, uint8_t len, const uint8_t *payload) {
+  uint8_t crc = crc8(crc8(0, cmd), len);
+  for (uint8_t i = 0; i < len; ++i) {
+    crc = crc8(crc, payload[i]);
+  }
+  return crc;
+}
+
+/**
+ * Starts receiving on an initialized UART.
+ */
+void tuning_init(UART_HandleTypeDef *uart) {
+  uartHandle = uart;
+  rxState = RX_SYNC;
+  __HAL_UART_ENABLE_IT(uartHandle, UART_IT_RXNE);
+  HAL_NVIC_SetPriority(USART2_IRQn, 6, 0);
+  HAL_NVIC_EnableIRQ(USART2_IRQn);
+}
+
+static void rxByte(uint8_t byte) {
+  switch (rxState) {
+    case RX_SYNC:
+      if (byte == TUNING_SYNC) {
+        rxState = RX_CMD;
+      }
+      break;
+    case RX_CMD:
+      rxFrame.cmd = byte;
+      rxState = RX_LEN;
+      break;
+    case RX_LEN:
+      rxFrame.len = byte;
+      rxCount = 0;
+      if (byte > TUNING_MAX_PAYLOAD) {
+        rxState = RX_SYNC;
+      }
+      else {
+        rxState = (byte == 0) ? RX_CRC : RX_PAYLOAD;
+      }
+      break;
+    case RX_PAYLOAD:
+      rxFrame.payload[rxCount++] = byte;
+      if (rxCount == rxFrame.len) {
+        rxState = RX_CRC;
+      }
+      break;
+    case RX_CRC:
+      rxState = RX_SYNC;
+      if (byte != frameCrc(rxFrame.cmd, rxFrame.len, rxFrame.payload)) {
+        stats.crcErrors++;
+        break;
+      }
+      lastFrameTick = HAL_GetTick();
+      inSession = true;
+      if (mailboxFull) {
+        stats.dropped++;
+      }
+      else {
+        mailbox = rxFrame;
+        mailboxFull = true;
+        stats.frames++;
+        coop_notify();
+      }
+      break;
+  }
+}
+
+/**
+ * Call from USART2_IRQHandler.
+ */
+void tuning_uartIrq(void) {
+  USART_TypeDef *usart = uartHandle->Instance;
+  uint32_t isr = usart->ISR;
+
+  if (isr & USART_ISR_ORE) {
+    usart->ICR = USART_ICR_ORECF;
+    stats.overruns++;
+  }
+  if (isr & (USART_ISR_FE | USART_ISR_NE | USART_ISR_PE)) {
+    usart->ICR = USART_ICR_FECF | USART_ICR_NECF | USART_ICR_PECF;
+  }
+  if (isr & USART_ISR_RXNE) {
+    rxByte((uint8_t)usart->RDR);
+  }
+}
+
+/**
+ * Takes the received frame, if any.  Never blocks.
+ */
+bool tuning_receive(tuning_frame_t *out) {
+  if (!mailboxFull) {
+    return false;
+  }
+  *out = mailbox;
+  __DMB();
+  mailboxFull = false;
+  return true;
+}
+
+/**
+ * Sends a frame.  Blocks for the transmission time; call from task context.
+ */
+void tuning_send(uint8_t cmd, const uint8_t *payload, uint8_t len) {
+  uint8_t buf[TUNING_MAX_PAYLOAD + 4];
+
+  if (len > TUNING_MAX_PAYLOAD) {
+    return;
+  }
+  buf[0] = TUNING_SYNC;
+  buf[1] = cmd;
+  buf[2] = len;
+  memcpy(&buf[3], payload, len);
+  buf[3 + len] = frameCrc(cmd, len, payload);
+  HAL_UART_Transmit(uartHandle, buf, len + 4, 10 + len);
+}
+
+/**
+ * Tells whether a good frame came in within the last TUNING_SESSION_MS.
+ */
+bool tuning_sessionActive(void) {
+  return inSession && HAL_GetTick() - lastFrameTick < TUNING_SESSION_MS;
+}
+
+void tuning_getStats(tuning_stats_t *out) {
+  *out = stats;
+}
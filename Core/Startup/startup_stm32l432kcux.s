@@ -95,6 +95,23 @@ LoopFillZerobss:
 	cmp	r2, r3
 	bcc	FillZerobss
 
+/* Copy the RAMFUNC code from flash to SRAM2 */
+  movs	r1, #0
+  b	LoopCopyRam2Init
+
+CopyRam2Init:
+	ldr	r3, =_siram2
+	ldr	r3, [r3, r1]
+	str	r3, [r0, r1]
+	adds	r1, r1, #4
+
+LoopCopyRam2Init:
+	ldr	r0, =_sram2
+	ldr	r3, =_eram2
+	adds	r2, r0, r1
+	cmp	r2, r3
+	bcc	CopyRam2Init
+
 /* Call static constructors */
     bl __libc_init_array
 /* Call the application's entry point.*/
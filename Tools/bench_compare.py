@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""Compare two benchmark results kernel by kernel.
+
+Takes two JSON documents written by bench_host, or two tables captured from
+the target's benchmark mode (hold capture through reset), and prints the
+change of every metric.  Exits with 1 if a kernel got slower than the
+threshold, so it can gate a change.
+
+  bench_compare.py before.json after.json [--threshold 5]
+  bench_compare.py before.txt after.txt
+"""
+
+import argparse
+import json
+import sys
+
+HOST_METRICS = ("ns_per_op", "instructions_per_op", "cache_misses_per_op")
+TARGET_METRICS = ("cycles_per_op",)
+LABELS = {"instructions_per_op": "instr", "cache_misses_per_op": "misses"}
+
+
+def load_table(text):
+    """Parses the target's table; anything outside it in the capture is skipped."""
+    kernels = {}
+    inside = False
+    for line in text.splitlines():
+        line = line.strip()
+        if line.startswith("# bench"):
+            sys.stderr.write(line[2:] + "\n")
+            inside = True
+        elif line == "# end":
+            inside = False
+        elif inside and line and not line.startswith("name,"):
+            name, cycles, checksum = line.split(",")
+            kernels[name] = {"name": name, "cycles_per_op": float(cycles), "checksum": checksum}
+    return kernels
+
+
+def load(path):
+    with open(path) as f:
+        text = f.read()
+    if text.lstrip().startswith("{"):
+        return {k["name"]: k for k in json.loads(text)["kernels"]}
+    return load_table(text)
+
+
+def change(old, new):
+    if old is None or new is None or old == 0:
+        return None
+    return 100.0 * (new - old) / old
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("before")
+    parser.add_argument("after")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="percent of ns or cycles per op counted as a regression")
+    args = parser.parse_args()
+
+    before = load(args.before)
+    after = load(args.after)
+    regressed = []
+
+    metrics = HOST_METRICS
+    if any("cycles_per_op" in k for k in before.values()):
+        metrics = TARGET_METRICS
+    if any(metrics[0] not in k for k in list(before.values()) + list(after.values())):
+        sys.exit("cannot compare host and target results")
+    primary = metrics[0]
+
+    print("%-24s %12s %12s %8s" % ("kernel", "before", "after", "change")
+          + "".join(" %10s" % LABELS[m] for m in metrics[1:]))
+    for name in list(before) + [n for n in after if n not in before]:
+        if name not in before or name not in after:
+            print("%-24s %s" % (name, "only in " + ("after" if name in after else "before")))
+            continue
+        old, new = before[name], after[name]
+        cells = []
+        for metric in metrics:
+            delta = change(old.get(metric), new.get(metric))
+            cells.append("-" if delta is None else "%+.1f%%" % delta)
+        note = "" if old.get("checksum") == new.get("checksum") else "  results differ"
+        print("%-24s %12.3f %12.3f %8s" % (name, old[primary], new[primary], cells[0])
+              + "".join(" %10s" % c for c in cells[1:]) + note)
+        delta = change(old[primary], new[primary])
+        if delta is not None and delta > args.threshold:
+            regressed.append(name)
+
+    if regressed:
+        sys.stderr.write("slower than %.1f%%: %s\n" % (args.threshold, ", ".join(regressed)))
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
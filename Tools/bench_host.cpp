@@ -0,0 +1,135 @@
+/*
+ * Host runner for the kernels in Core/Inc/benchKernels.h.
+ *
+ * Times every kernel and, where the kernel allows it (Linux perf events,
+ * see perf_event_paranoid), counts instructions and cache misses.  Prints
+ * one JSON document; compare two of them with bench_compare.py.
+ *
+ *   g++ -O2 -DRAMFUNC_ENABLED=0 -ICore/Inc -o bench_host Tools/bench_host.cpp \
+ *       Core/Src/benchKernels.cpp Core/Src/PID.cpp -x c Core/Src/bno055.c \
+ *       -x c Core/Src/motionProfile.c -x c Core/Src/socEstimator.c
+ *   ./bench_host [iterations] > bench.json
+ *
+ * Host numbers rank changes; the cycle counts that matter are the target's.
+ */
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "benchKernels.h"
+
+#define DEFAULT_ITERATIONS 1000000
+#define REPEATS 7   //the median of these is reported
+
+//The kernels only decode buffers; the bus is never used.
+extern "C" bool bno055_readData(uint8_t, uint8_t *data, uint8_t len) { memset(data, 0, len); return true; }
+extern "C" bool bno055_writeData(uint8_t, uint8_t) { return true; }
+extern "C" void bno055_delay(int) {}
+
+struct Counter {
+  int fd = -1;
+
+  void open(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+  void start() {
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+  //-1 if the counter is not available.
+  int64_t stop() {
+    uint64_t value;
+    if (fd < 0) {
+      return -1;
+    }
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    return (read(fd, &value, sizeof(value)) == sizeof(value)) ? (int64_t)value : -1;
+  }
+};
+
+struct Sample {
+  double nsPerOp;
+  double instructionsPerOp;
+  double cacheMissesPerOp;
+};
+
+static uint64_t nowNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static int byTime(const void *a, const void *b) {
+  double d = ((const Sample *)a)->nsPerOp - ((const Sample *)b)->nsPerOp;
+  return (d > 0) - (d < 0);
+}
+
+static double perOp(int64_t count, uint32_t iterations) {
+  return (count < 0) ? -1 : (double)count / iterations;
+}
+
+//JSON number, or null for a counter that could not be read.
+static const char *jsonNumber(char *buf, size_t size, const char *format, double value) {
+  if (value < 0) {
+    return "null";
+  }
+  snprintf(buf, size, format, value);
+  return buf;
+}
+
+int main(int argc, char **argv) {
+  uint32_t iterations = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : DEFAULT_ITERATIONS;
+  Counter instructions, cacheMisses;
+  Sample samples[REPEATS];
+
+  instructions.open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  cacheMisses.open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  if (instructions.fd < 0) {
+    fprintf(stderr, "perf counters unavailable, reporting time only\n");
+  }
+
+  printf("{\n  \"iterations\": %u,\n  \"kernels\": [\n", iterations);
+  for (uint8_t k = 0; k < bench_count(); k++) {
+    const bench_kernel_t *kernel = bench_get(k);
+
+    for (int r = 0; r < REPEATS; r++) {
+      bench_init();
+      kernel->run(iterations / 10);   //warm the caches and predictors
+      instructions.start();
+      cacheMisses.start();
+      uint64_t start = nowNs();
+      kernel->run(iterations);
+      uint64_t elapsed = nowNs() - start;
+      samples[r].cacheMissesPerOp = perOp(cacheMisses.stop(), iterations);
+      samples[r].instructionsPerOp = perOp(instructions.stop(), iterations);
+      samples[r].nsPerOp = (double)elapsed / iterations;
+    }
+    qsort(samples, REPEATS, sizeof(samples[0]), byTime);
+    const Sample &median = samples[REPEATS / 2];
+    char instr[32], misses[32];
+    printf("    { \"name\": \"%s\", \"ns_per_op\": %.3f, \"instructions_per_op\": %s, "
+           "\"cache_misses_per_op\": %s, \"checksum\": \"%08x\" }%s\n",
+           kernel->name, median.nsPerOp,
+           jsonNumber(instr, sizeof(instr), "%.2f", median.instructionsPerOp),
+           jsonNumber(misses, sizeof(misses), "%.4f", median.cacheMissesPerOp),
+           bench_checksum(), (k + 1 < bench_count()) ? "," : "");
+  }
+  printf("  ]\n}\n");
+  return 0;
+}
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""Dump and decode the gimbal flight recorder.
+
+Reads tuning-link frames from a serial port (needs pyserial) or from a raw
+capture file, and writes the recorder samples as CSV, oldest first.  The
+recorder keeps one sample every few control ticks (see BB_DECIMATION);
+the cycles column is the longest tick since the previous sample.
+
+  blackbox_decode.py --port /dev/ttyACM0 > record.csv
+  blackbox_decode.py capture.bin > record.csv
+"""
+
+import argparse
+import struct
+import sys
+
+SYNC = 0xA5
+CMD_RECORDER = 0x05
+REPLY = 0x80
+RECORDER_DATA = 0x91
+RECORDER_DUMP = 2
+END_INDEX = 0xFFFF
+
+ANGLE_SCALE = 100.0
+PID_SCALE = 10.0
+
+# Must match bb_sample_t in Core/Inc/blackBox.h
+SAMPLE = struct.Struct("<HH3h3h3h3h3h3H")
+
+REASONS = {0: "running", 1: "fault", 2: "hardfault", 3: "watchdog",
+           4: "button", 5: "command", 6: "deadline", 7: "stack"}
+
+AXES = ("yaw", "pitch", "roll")
+
+
+def crc8(data):
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def frame(cmd, payload=b""):
+    body = bytes([cmd, len(payload)]) + payload
+    return bytes([SYNC]) + body + bytes([crc8(body)])
+
+
+def frames(read):
+    """Yields (cmd, payload) for every frame with a valid CRC."""
+    while True:
+        byte = read(1)
+        if not byte:
+            return
+        if byte[0] != SYNC:
+            continue
+        head = read(2)
+        if len(head) < 2:
+            return
+        cmd, length = head
+        rest = read(length + 1)
+        if len(rest) < length + 1:
+            return
+        if crc8(head + rest[:-1]) == rest[-1]:
+            yield cmd, rest[:-1]
+
+
+def decode(read, out):
+    header = ["index", "tick", "cycles"]
+    header += ["%s_%s" % (f, a) for f in ("angle", "target", "p", "i", "d") for a in AXES]
+    header += ["ccr1", "ccr2", "ccr4"]
+    out.write(",".join(header) + "\n")
+
+    for cmd, payload in frames(read):
+        if cmd == CMD_RECORDER | REPLY and len(payload) >= 14:
+            status, reason, count, written, freeze_tick, boots, size = \
+                struct.unpack("<BBHIIBB", payload[:14])
+            decimation = payload[14] if len(payload) >= 15 else 1
+            sys.stderr.write("recorder: %s, %d samples (%d written) of every %d control ticks, "
+                             "frozen at %d ms, %d resets since\n"
+                             % (REASONS.get(reason, reason), count, written, decimation,
+                                freeze_tick, boots))
+            if size != SAMPLE.size:
+                sys.exit("sample size %d, decoder expects %d" % (size, SAMPLE.size))
+        elif cmd == RECORDER_DATA and len(payload) >= 2:
+            index = struct.unpack("<H", payload[:2])[0]
+            if index == END_INDEX:
+                return
+            v = SAMPLE.unpack(payload[2:2 + SAMPLE.size])
+            row = [index, v[0], v[1] * 16]
+            row += ["%.2f" % (x / ANGLE_SCALE) for x in v[2:8]]
+            row += ["%.1f" % (x / PID_SCALE) for x in v[8:17]]
+            row += list(v[17:20])
+            out.write(",".join(str(x) for x in row) + "\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", nargs="?", help="raw capture file")
+    parser.add_argument("--port", help="serial port to request a dump from")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    if args.port:
+        import serial
+        with serial.Serial(args.port, args.baud, timeout=2) as port:
+            port.reset_input_buffer()
+            port.write(frame(CMD_RECORDER, bytes([RECORDER_DUMP])))
+            decode(port.read, sys.stdout)
+    elif args.capture:
+        with open(args.capture, "rb") as f:
+            decode(f.read, sys.stdout)
+    else:
+        parser.error("give a capture file or --port")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""Fail the build if firmware code calls the double-precision runtime.
+
+The M4F FPU only does single precision, so every double operation is a
+soft-float call into libgcc (__aeabi_dadd, __aeabi_f2d and friends).  The
+compiler flag -Werror=double-promotion catches the implicit promotions; this
+catches what is left, such as double literals, explicit double variables and
+double libm calls.  It lists the undefined symbols of every object built
+from Core/Src with nm and, as a cross-check that needs no binutils, reads the
+linker map for the objects that pulled the double routines out of libgcc.
+
+Runs as the post-build step of both configurations, from the build folder:
+
+  check_no_double.py Debug [--nm arm-none-eabi-nm]
+
+newlib's printf pulls in double code for %f (-u_printf_float); that is
+referenced from libc, not from Core/Src, and is not reported.
+"""
+
+import argparse
+import glob
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+DOUBLE_RUNTIME = re.compile(r"__aeabi_(d[a-z0-9]+|[a-z0-9]+2d)\b")
+
+# Objects allowed to use double, by file name.  Keep this to code that never
+# runs from the control loop.
+ALLOWED = set()
+
+
+def scan_objects(build, nm):
+    """Maps each Core/Src object to the double routines it references."""
+    found = {}
+    for obj in sorted(glob.glob(os.path.join(build, "Core", "Src", "**", "*.o"), recursive=True)):
+        out = subprocess.run([nm, "-u", obj], check=True, capture_output=True, text=True).stdout
+        symbols = sorted(set(m.group(0) for m in DOUBLE_RUNTIME.finditer(out)))
+        if symbols:
+            found[obj] = symbols
+    return found
+
+
+def scan_map(path):
+    """Maps each Core/Src object named in the map's archive member section to
+    the double routines it was the first to reference."""
+    found = {}
+    with open(path) as f:
+        lines = f.read().split("Archive member included", 1)[-1].splitlines()
+    for line in lines[1:]:
+        if line.startswith("Discarded input sections") or line.startswith("Memory Configuration"):
+            break
+        m = re.search(r"(\S+) \((\S+)\)$", line)
+        if m and "Core/Src/" in m.group(1) and DOUBLE_RUNTIME.fullmatch(m.group(2)):
+            found.setdefault(m.group(1), []).append(m.group(2))
+    return found
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("build", help="build folder holding the objects and the .map file")
+    parser.add_argument("--nm", default="arm-none-eabi-nm")
+    args = parser.parse_args()
+
+    found = {}
+    if shutil.which(args.nm):
+        found.update(scan_objects(args.build, args.nm))
+    else:
+        sys.stderr.write("%s not found, checking the link map only\n" % args.nm)
+    for path in glob.glob(os.path.join(args.build, "*.map")):
+        for obj, symbols in scan_map(path).items():
+            found.setdefault(obj, symbols)
+
+    bad = {obj: s for obj, s in found.items() if os.path.basename(obj) not in ALLOWED}
+    for obj, symbols in sorted(bad.items()):
+        sys.stderr.write("%s: double-precision math: %s\n" % (obj, ", ".join(symbols)))
+    if bad:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Check closed-loop scenario results against a baseline.
+
+Takes the baseline and a new result, both written by control_sim, and
+prints every metric side by side.  A metric that got worse by more than the
+tolerance (and by more than its noise floor) fails the check, as does a
+scenario that no longer settles.
+
+  control_compare.py Tools/control_baseline.json result.json [--tolerance 10]
+"""
+
+import argparse
+import json
+import sys
+
+# Lower is better for every metric; changes below the floor are ignored.
+FLOORS = {
+    "settle_ms": 10,
+    "overshoot_deg": 0.05,
+    "steady_error_deg": 0.05,
+    "jitter_deg": 0.05,
+    "travel_counts": 50,
+}
+
+
+def load(path):
+    with open(path) as f:
+        return {s["name"]: s for s in json.load(f)["scenarios"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("result")
+    parser.add_argument("--tolerance", type=float, default=10.0,
+                        help="percent a metric may get worse")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    result = load(args.result)
+    failures = []
+
+    for name, old in baseline.items():
+        new = result.get(name)
+        if new is None:
+            failures.append("%s: missing" % name)
+            continue
+        print("%s (%s)" % (name, old["axis"]))
+        for metric, floor in FLOORS.items():
+            a, b = old[metric], new[metric]
+            verdict = ""
+            if a is not None and b is None:
+                verdict = "  no longer settles"
+            elif a is not None and b - a > max(floor, abs(a) * args.tolerance / 100):
+                verdict = "  worse"
+            if verdict:
+                failures.append("%s %s" % (name, metric))
+            print("  %-18s %10s %10s%s" % (metric, a, b, verdict))
+
+    if failures:
+        sys.stderr.write("regressed: %s\n" % ", ".join(failures))
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,228 @@
+/*
+ * Closed-loop scenarios for the stabilizer, run on a host.
+ *
+ * The real PIDController, axisMath and controlMetrics code drives a simple
+ * servo and hand model, ticked like the firmware: the IMU samples every
+ * IMU_FREQ ms, the control tick runs every CONTROL_FREQ ms and the PID
+ * output is added to the pulse width and clamped as in the *PWM()
+ * callbacks.  Gains, limits and periods are the firmware's, from
+ * gimbalDefaults.h.  Each scenario reports the controlMetrics numbers of
+ * the axis it judges, as JSON.  Scenarios under continuous hand motion report the
+ * whole-run error and jitter and no settle time.  control_compare.py checks
+ * the results against control_baseline.json.
+ *
+ * A scenario may spend time in CINEMATIC, where the controllers do not
+ * tick and cinematicRoutine() drives the servos, before it is judged in
+ * STABILIZE.  The firmware's way back goes through OFF and BOOTING, which
+ * tick no controller either, so they are part of that time.  As in the
+ * firmware, enterSTABILIZE() resets the servos and each controller's
+ * integrator and last tick time.
+ *
+ *   g++ -O2 -DRAMFUNC_ENABLED=0 -ICore/Inc -o control_sim Tools/control_sim.cpp \
+ *       Core/Src/PID.cpp -x c Core/Src/controlMetrics.c
+ *   ./control_sim > result.json
+ *   Tools/control_compare.py Tools/control_baseline.json result.json
+ *
+ * Regenerate the baseline with ./control_sim > Tools/control_baseline.json
+ * when a change in control quality is intended.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "PID.h"
+#include "axisMath.h"
+#include "controlMetrics.h"
+#include "gimbalDefaults.h"
+
+//Plant model.
+#define SERVO_TAU_MS 15.0f           //first-order lag of the servo position
+#define SERVO_MAX_RATE 0.5f          //degrees per ms, about 0.12 s per 60 degrees
+#define IMU_LATENCY_MS 4             //fusion output lag of the BNO055
+#define WARMUP_MS 2000               //settling before a scenario starts
+#define CINEMATIC_SWEEP_STEP 30      //yawMovement() counts per cinematic period
+#define TWO_PI 6.28318531f
+
+enum { YAW, PITCH, ROLL, AXES };
+static const char *axisNames[AXES] = { "yaw", "pitch", "roll" };
+
+struct Scenario {
+  const char *name;
+  int axis;                 //the axis the metrics are taken on
+  unsigned durationMs;
+  bool warmup;              //start from a settled gimbal, else from enterSTABILIZE()
+  unsigned cinematicMs;     //time in CINEMATIC before STABILIZE is entered, and judged
+  float step[AXES];         //setpoint change at the start, degrees
+  float tilt[AXES];         //constant hand attitude, degrees
+  float shake[AXES];        //sinusoidal hand motion amplitude, degrees
+  float shakeHz;
+  float coupling;           //fraction of the roll hand motion seen on pitch
+  bool disturbance() const { return shakeHz > 0; }
+};
+
+static const Scenario scenarios[] = {
+  { "yaw_step_30",         YAW,   3000, true,  0,    { 30, 0, 0 }, { 0, 0, 0 },   { 0, 0, 0 },  0,  0 },
+  { "pitch_shake_2hz",     PITCH, 4000, true,  0,    { 0, 0, 0 },  { 0, 0, 0 },   { 0, 3, 0 },  2,  0 },
+  { "pitch_shake_5hz",     PITCH, 4000, true,  0,    { 0, 0, 0 },  { 0, 0, 0 },   { 0, 3, 0 },  5,  0 },
+  { "pitch_shake_10hz",    PITCH, 4000, true,  0,    { 0, 0, 0 },  { 0, 0, 0 },   { 0, 3, 0 },  10, 0 },
+  { "pitch_hold_roll_1hz", PITCH, 4000, true,  0,    { 0, 0, 0 },  { 0, 0, 0 },   { 0, 0, 15 }, 1,  0.15f },
+  { "stabilize_entry",     PITCH, 3000, false, 0,    { 0, 0, 0 },  { 0, 10, -8 }, { 0, 0, 0 },  0,  0 },
+  { "cinematic_to_stabilize", PITCH, 3000, false, 4000, { 0, 0, 0 }, { 0, 10, -8 }, { 0, 0, 0 }, 0, 0 },
+  { "stabilize_cinematic_stabilize", PITCH, 3000, true, 4000, { 0, 0, 0 }, { 0, 10, -8 }, { 0, 0, 0 }, 0, 0 },
+  { "stabilize_cinematic_stabilize_yaw", YAW, 3000, true, 4000, { 0, 0, 0 }, { 20, 0, 0 }, { 0, 0, 0 }, 0, 0 },
+};
+
+static unsigned long simMs;
+static const Scenario *scenario;
+static float servoDeg[AXES];
+static int ccr[AXES];
+static float measured[AXES];   //what the IMU task last published, controller coordinates
+static float history[IMU_LATENCY_MS + 1][AXES];
+
+static unsigned long simTick() { return simMs; }
+
+static float simYaw() {
+  float heading = fmodf(measured[YAW] + 2 * ROTATIONOFFSET, ROTATIONOFFSET);
+  return axis_unwrapYaw(heading, ccr[YAW], PWM_MID, PWM_HYSTERESIS, ROTATIONOFFSET);
+}
+static float simPitch() { return measured[PITCH]; }
+static float simRoll() { return measured[ROLL]; }
+
+static void simYawPWM(float out) { ccr[YAW] = axis_clampPulse(ccr[YAW] + (int)out, PWM_LOW_Y, PWM_HIGH_Y); }
+static void simPitchPWM(float out) { ccr[PITCH] = axis_clampPulse(ccr[PITCH] + (int)out, PWM_LOW, PWM_HIGH); }
+static void simRollPWM(float out) { ccr[ROLL] = axis_clampPulse(ccr[ROLL] + (int)out, PWM_LOW, PWM_HIGH); }
+
+//Hand motion the gimbal has to cancel, for t ms into the scenario.
+static float hand(int axis, float t) {
+  float angle = scenario->tilt[axis];
+  if (t > 0) {
+    angle += scenario->shake[axis] * sinf(TWO_PI * scenario->shakeHz * t / 1000);
+  }
+  return angle;
+}
+
+//One millisecond of servo and hand motion, then the camera attitude.
+static void stepPlant(float t) {
+  float camera[AXES];
+
+  for (int axis = 0; axis < AXES; axis++) {
+    float wanted = (ccr[axis] - PWM_MID) * SERVO_DEG_PER_COUNT;
+    float move = (wanted - servoDeg[axis]) / SERVO_TAU_MS;
+    if (move > SERVO_MAX_RATE) move = SERVO_MAX_RATE;
+    if (move < -SERVO_MAX_RATE) move = -SERVO_MAX_RATE;
+    servoDeg[axis] += move;
+    camera[axis] = hand(axis, t) + servoDeg[axis];
+  }
+  camera[PITCH] += scenario->coupling * (hand(ROLL, t) - scenario->tilt[ROLL]);
+
+  memmove(history[1], history[0], sizeof(history) - sizeof(history[0]));
+  memcpy(history[0], camera, sizeof(camera));
+}
+
+//enterSTABILIZE(): servos back to their starting pulses, controllers reset.
+static void enterStabilize(PIDController<float> *const *ctrl) {
+  ccr[YAW] = ccr[ROLL] = PWM_MID;
+  ccr[PITCH] = PWM_MID - STABILIZE_PITCH_OFFSET;
+  for (int axis = 0; axis < AXES; axis++) {
+    ctrl[axis]->reset();
+  }
+}
+
+//cinematicRoutine(): pitch and roll to their offsets, and one step of the yaw sweep.
+static void cinematicStep(bool *direction) {
+  ccr[PITCH] = PWM_MID + CINEMATIC_PITCH_OFFSET;
+  ccr[ROLL] = PWM_MID + CINEMATIC_ROLL_OFFSET;
+  ccr[YAW] += *direction ? CINEMATIC_SWEEP_STEP : -CINEMATIC_SWEEP_STEP;
+  if (ccr[YAW] > PWM_HIGH_Y) {
+    *direction = false;
+  }
+  else if (ccr[YAW] < PWM_LOW_Y) {
+    *direction = true;
+  }
+}
+
+static void runScenario(const Scenario &s, ctrl_metrics_report_t *report) {
+  PIDController<float> yawCtrl(KP_y, KI_y, KD_y, simYaw, simYawPWM);
+  PIDController<float> pitchCtrl(KP_p, KI_p, KD_p, simPitch, simPitchPWM);
+  PIDController<float> rollCtrl(KP_r, KI_r, KD_r, simRoll, simRollPWM);
+  PIDController<float> *ctrl[AXES] = { &yawCtrl, &pitchCtrl, &rollCtrl };
+  ctrl_metrics_t metrics;
+  bool sweepDirection = true;
+
+  scenario = &s;
+  simMs = 0;
+  //gains in the argument order applyParams() uses: (p, i, d)
+  yawCtrl.setPID(KP_y, KI_y, KD_y);
+  pitchCtrl.setPID(KP_p, KI_p, KD_p);
+  rollCtrl.setPID(KP_r, KI_r, KD_r);
+  //timed as StartCtrlSysTask() sets them up: yaw and pitch
+  yawCtrl.registerTimeFunction(simTick);
+  pitchCtrl.registerTimeFunction(simTick);
+
+  enterStabilize(ctrl);
+  for (int axis = 0; axis < AXES; axis++) {
+    servoDeg[axis] = (ccr[axis] - PWM_MID) * SERVO_DEG_PER_COUNT;
+    ctrl[axis]->setTarget(0);
+  }
+  memset(history, 0, sizeof(history));
+
+  //a warmup is spent in STABILIZE, then the cinematic time, then the judged run
+  unsigned cinematicStart = s.warmup ? WARMUP_MS : 0;
+  unsigned startMs = cinematicStart + s.cinematicMs;
+  unsigned endMs = startMs + s.durationMs;
+  for (simMs = 0; simMs < endMs; simMs++) {
+    float t = (float)simMs - startMs;
+    bool cinematic = simMs >= cinematicStart && simMs < startMs;
+    if (simMs == startMs) {
+      if (s.cinematicMs > 0) {
+        enterStabilize(ctrl);
+      }
+      for (int axis = 0; axis < AXES; axis++) {
+        ctrl[axis]->setTarget(ctrl[axis]->getTarget() + s.step[axis]);
+      }
+      ctrlMetrics_start(&metrics, simMs);
+    }
+    if (cinematic && (simMs - cinematicStart) % UNIQUE_FREQ == 0) {
+      cinematicStep(&sweepDirection);
+    }
+    stepPlant(t);
+    if (simMs % IMU_FREQ == 0) {
+      memcpy(measured, history[IMU_LATENCY_MS], sizeof(measured));
+    }
+    if (!cinematic && simMs % CONTROL_FREQ == 1) {
+      yawCtrl.tick();
+      pitchCtrl.tick();
+      rollCtrl.tick();
+      if (simMs >= startMs) {
+        PIDController<float> *c = ctrl[s.axis];
+        ctrlMetrics_update(&metrics, simMs, c->getTarget(), c->getFeedback(), ccr[s.axis]);
+      }
+    }
+  }
+  ctrlMetrics_report(&metrics, report);
+}
+
+int main() {
+  const unsigned count = sizeof(scenarios) / sizeof(scenarios[0]);
+
+  printf("{\n  \"scenarios\": [\n");
+  for (unsigned i = 0; i < count; i++) {
+    ctrl_metrics_report_t r;
+    char settle[16] = "null";
+
+    runScenario(scenarios[i], &r);
+    if (scenarios[i].disturbance()) {
+      r.steadyErrorDeg = r.runErrorDeg;
+      r.jitterDeg = r.runJitterDeg;
+    }
+    else if (r.settleMs != CTRL_NEVER_SETTLED) {
+      snprintf(settle, sizeof(settle), "%u", (unsigned)r.settleMs);
+    }
+    printf("    { \"name\": \"%s\", \"axis\": \"%s\", \"settle_ms\": %s, \"overshoot_deg\": %.3f, "
+           "\"steady_error_deg\": %.3f, \"jitter_deg\": %.3f, \"travel_counts\": %u }%s\n",
+           scenarios[i].name, axisNames[scenarios[i].axis], settle, r.overshootDeg,
+           r.steadyErrorDeg, r.jitterDeg, (unsigned)r.travelCounts, (i + 1 < count) ? "," : "");
+  }
+  printf("  ]\n}\n");
+  return 0;
+}
@@ -0,0 +1,252 @@
+/*
+ * Runs the servo output and the BNO055 read path on a host against the
+ * fake HAL in Tools/fakeHal, at the board's 32 MHz core clock, and checks
+ * their timing: when a servo write shows up at the pin given TIM2's
+ * preloaded compare registers, how a stop cuts a pulse, that the servo
+ * trace agrees with the timer, and how long an Euler read takes on a
+ * healthy bus, on a bus some device holds low and when every retry of the
+ * cycle fails.  Exits with 1 if a check fails.
+ *
+ *   g++ -O2 -DRAMFUNC_ENABLED=0 -ITools/fakeHal -ICore/Inc -o driver_timing_host \
+ *       Tools/driver_timing_host.cpp Tools/fakeHal/fakeHal.cpp Core/Src/bno055Imu.cpp \
+ *       -x c Core/Src/servoOutput.c -x c Core/Src/i2cBus.c -x c Core/Src/bno055.c \
+ *       -x c Core/Src/bno055_stm32.c
+ *   ./driver_timing_host
+ */
+
+#include <stdio.h>
+#include "bno055Imu.h"
+#include "fakeHal.h"
+#include "gimbalDefaults.h"
+#include "hostCheck.h"
+#include "i2cBus.h"
+#include "sampleAge.h"
+#include "servoOutput.h"
+
+#define CORE_HZ 32000000        //SystemClock_Config(): MSI 4 MHz, PLL x16 / 2
+#define TIM2_PRESCALER 3        //MX_TIM2_Init()
+#define TIM2_PERIOD 65535
+#define CYCLES_PER_US (CORE_HZ / 1000000)
+#define COUNTS_PER_US (CYCLES_PER_US / (TIM2_PRESCALER + 1))
+#define FRAME_US ((TIM2_PERIOD + 1) / COUNTS_PER_US)
+
+#define SUP_IMU_DEADLINE 50         //as in main.cpp
+#define SUP_IMU_SETUP_DEADLINE 3000
+#define DEVICE_LATENCY_US 20        //clock stretching of the BNO055
+#define BIT_US (1000000 / I2CBUS_BUS_HZ)
+#define RECOVERY_US ((2 * I2CBUS_CLEAR_PULSES + 3) * I2CBUS_HALF_BIT_US)   //worst case of one bus clear
+#define CPU_SLACK_US 2
+
+static TIM_HandleTypeDef htim2 = { TIM2 };
+static I2C_HandleTypeDef hi2c = { I2C1, { 0, 0, 0 }, 0 };
+
+//The firmware's clock is TIM6 based; here it is simulated time.
+extern "C" uint32_t timestamp_us(void) {
+  fakeHal_sync();
+  return fakeHal_us();
+}
+
+static uint64_t usToCycles(uint32_t us) {
+  return (uint64_t)us * CYCLES_PER_US;
+}
+
+//The frame that starts at or after a time, once it is over.
+static fake_pwm_frame_t frameAfter(uint8_t channel, uint64_t fromCycle) {
+  fake_pwm_frame_t frame = { 0, 0, false, 0 };
+  while (!fakeHal_pwmFrame(channel, fromCycle, &frame)) {
+    fakeHal_advanceUs(FRAME_US);
+  }
+  return frame;
+}
+
+//Moves time on to a given offset into the next frame.
+static uint64_t intoNextFrame(uint32_t offsetUs) {
+  uint64_t frameCycles = usToCycles(FRAME_US);
+  uint64_t next = (fakeHal_cycles() / frameCycles + 1) * frameCycles + usToCycles(offsetUs);
+  fakeHal_advanceUs((uint32_t)((next - fakeHal_cycles()) / CYCLES_PER_US));
+  return next;
+}
+
+static void servoChecks() {
+  char line[96];
+
+  TIM2->PSC = TIM2_PRESCALER;
+  TIM2->ARR = TIM2_PERIOD;
+  fakeHal_timClearLog();
+  servo_init(&htim2);
+
+  //every channel starts at the width set before it
+  servo_set(SERVO_YAW, 12000);
+  servo_set(SERVO_PITCH, 11000);
+  servo_set(SERVO_ROLL, 13000);
+  uint64_t started = fakeHal_cycles();
+  servo_startAll();
+  check("started channels output their widths in the next frame",
+        frameAfter(1, started).widthCounts == 12000 && frameAfter(2, started).widthCounts == 11000 &&
+        frameAfter(4, started).widthCounts == 13000);
+  check("  and nothing on the unused channel 3", !frameAfter(3, started).enabled);
+  check("servo_get() reads back the compare values",
+        servo_get(SERVO_YAW) == 12000 && servo_get(SERVO_PITCH) == 11000 && servo_get(SERVO_ROLL) == 13000);
+
+  //a write in the middle of a frame waits for the next update event
+  uint64_t written = intoNextFrame(3000);
+  servo_set(SERVO_YAW, 14000);
+  fake_pwm_frame_t current = frameAfter(1, written - usToCycles(FRAME_US) + 1);
+  fake_pwm_frame_t next = frameAfter(1, written);
+  uint32_t latencyUs = (uint32_t)((next.startCycle - written) / CYCLES_PER_US);
+  check("a write mid-frame leaves the frame it falls in alone", current.widthCounts == 12000);
+  snprintf(line, sizeof(line), "  and reaches the pin %u us later, within a frame", (unsigned)latencyUs);
+  check(line, next.widthCounts == 14000 && latencyUs <= FRAME_US);
+
+  //a write just ahead of the update event makes it, one just after waits a whole frame
+  written = intoNextFrame(FRAME_US - 10);
+  servo_set(SERVO_YAW, 15000);
+  next = frameAfter(1, written);
+  check("a write 10 us before the update event is in the next frame",
+        next.widthCounts == 15000 && next.startCycle - written == usToCycles(10));
+  written = intoNextFrame(10);
+  servo_set(SERVO_YAW, 16000);
+  current = frameAfter(1, written - usToCycles(10));
+  next = frameAfter(1, written);
+  check("a write 10 us after it misses the frame it falls in",
+        current.widthCounts == 15000 && next.widthCounts == 16000);
+
+  //the servo trace shows the writes when the timer saw them
+  servo_traceArm();
+  fakeHal_timClearLog();
+  for (uint32_t i = 0; i < 8; i++) {
+    fakeHal_advanceUs(700 + 130 * i);
+    servo_set((uint8_t)(i % SERVO_COUNT), 9000 + 500 * i);
+  }
+  fakeHal_sync();
+  bool traceMatches = servo_traceCount() == 8 && fakeHal_timWriteCount() == 8;
+  for (uint16_t i = 0; traceMatches && i < 8; i++) {
+    servo_trace_t event;
+    fake_tim_write_t write;
+    servo_traceGet(i, &event);
+    fakeHal_timWriteGet(i, &write);
+    uint32_t writeUs = (uint32_t)(write.cycle / CYCLES_PER_US);
+    traceMatches = event.event == SERVO_EVENT_WRITE && event.ccr == write.value &&
+                   write.reg == (event.axis == SERVO_ROLL ? FAKE_TIM_CCR4 : FAKE_TIM_CCR1 + event.axis) &&
+                   event.stampUs >= writeUs && event.stampUs <= writeUs + 1;
+  }
+  check("the servo trace matches the TIM2 timeline to 1 us", traceMatches);
+
+  //stopping cuts the pulse in progress and sends none after it
+  servo_set(SERVO_YAW, 12000);
+  servo_set(SERVO_PITCH, 12000);
+  servo_set(SERVO_ROLL, 12000);
+  uint64_t frameStart = intoNextFrame(0);
+  fakeHal_advanceUs(500);
+  servo_stopAll();
+  current = frameAfter(1, frameStart);
+  next = frameAfter(1, frameStart + 1);
+  snprintf(line, sizeof(line), "servo_stopAll() 500 us into a pulse cuts it at %u us",
+           (unsigned)(current.widthCounts / COUNTS_PER_US));
+  check(line, current.widthCounts == 500 * COUNTS_PER_US);
+  check("  and no servo gets a pulse in the next frame",
+        !next.enabled && !frameAfter(2, frameStart + 1).enabled && !frameAfter(4, frameStart + 1).enabled);
+  check("  keeping the widths for a restart", servo_get(SERVO_YAW) == 12000);
+}
+
+static uint32_t readUs(Bno055Imu &imu, bool *ok, bno055_vector_t *euler) {
+  uint32_t start = fakeHal_us();
+  *ok = imu.read(HAL_GetTick(), euler);
+  return fakeHal_us() - start;
+}
+
+static void imuChecks() {
+  i2cbus_stats_t before, after;
+  bno055_vector_t euler;
+  char line[96];
+  bool ok;
+
+  HAL_I2C_Init(&hi2c);
+  fake_i2c_device_t *dev = fakeHal_i2cAddDevice(BNO055_I2C_ADDR, DEVICE_LATENCY_US);
+  dev->regs[BNO055_CHIP_ID] = BNO055_ID;
+  //heading 90, roll -10.5, pitch 3 degrees, at 16 LSB per degree
+  int16_t raw[3] = { 90 * 16, -168, 48 };
+  for (uint8_t i = 0; i < 3; i++) {
+    dev->regs[BNO055_VECTOR_EULER + 2 * i] = (uint8_t)raw[i];
+    dev->regs[BNO055_VECTOR_EULER + 2 * i + 1] = (uint8_t)(raw[i] >> 8);
+  }
+
+  Bno055Imu imu(&hi2c);
+  uint32_t start = fakeHal_us();
+  ok = imu.begin();
+  uint32_t beginMs = (fakeHal_us() - start) / 1000;
+  snprintf(line, sizeof(line), "begin() brings the BNO055 up in %u ms", (unsigned)beginMs);
+  check(line, ok && beginMs < SUP_IMU_SETUP_DEADLINE);
+
+  //a healthy read is one transaction, the page already being 0
+  readUs(imu, &ok, &euler);
+  fakeHal_i2cClearLog();
+  uint32_t us = readUs(imu, &ok, &euler);
+  uint32_t healthyUs = fakeHal_i2cBits() * BIT_US + DEVICE_LATENCY_US;
+  check("an Euler read is a single 6-byte register read",
+        ok && fakeHal_i2cBits() == i2cbus_writeReadBits(6) &&
+        euler.x == 90.0 && euler.y == -10.5 && euler.z == 3.0);
+  snprintf(line, sizeof(line), "  and takes %u us, inside the %u ms IMU period", (unsigned)us, IMU_FREQ);
+  check(line, us >= healthyUs && us <= healthyUs + CPU_SLACK_US && us < IMU_FREQ * 1000);
+
+  //a device that glitches SDA low is clocked out of it before the read
+  i2cbus_getStats(&before);
+  uint32_t edges = fakeHal_gpioRisingEdges(I2CBUS_SCL_PORT, I2CBUS_SCL_PIN);
+  fakeHal_gpioScript(I2CBUS_SDA_PORT, I2CBUS_SDA_PIN, fakeHal_us(), true);
+  fakeHal_gpioScript(I2CBUS_SDA_PORT, I2CBUS_SDA_PIN, fakeHal_us() + 30, false);
+  us = readUs(imu, &ok, &euler);
+  i2cbus_getStats(&after);
+  edges = fakeHal_gpioRisingEdges(I2CBUS_SCL_PORT, I2CBUS_SCL_PIN) - edges;
+  snprintf(line, sizeof(line), "SDA held low for 30 us is cleared in %u SCL pulses", (unsigned)edges);
+  check(line, ok && after.busy == before.busy + 1 && after.busClears == before.busClears + 1 && edges <= 4);
+  snprintf(line, sizeof(line), "  and the read takes %u us", (unsigned)us);
+  check(line, us <= healthyUs + RECOVERY_US);
+
+  //a device that hangs mid-transfer costs the timeout and a bus clear
+  i2cbus_getStats(&before);
+  fakeHal_i2cFailNext(FAKE_I2C_HANG, 1, 4);
+  us = readUs(imu, &ok, &euler);
+  i2cbus_getStats(&after);
+  check("a hung transfer is retried after a bus clear",
+        ok && after.timeouts == before.timeouts + 1 && after.busClears == before.busClears + 1 &&
+        after.reinits == before.reinits + 1);
+  snprintf(line, sizeof(line), "  and the read takes %u us", (unsigned)us);
+  check(line, us >= I2CBUS_TIMEOUT_MS * 1000 && us <= I2CBUS_TIMEOUT_MS * 1000 + RECOVERY_US + healthyUs);
+
+  //a bus error costs a re-init and a retry, no timeout
+  i2cbus_getStats(&before);
+  fakeHal_i2cFailNext(FAKE_I2C_BUS_ERROR, 1, 0);
+  us = readUs(imu, &ok, &euler);
+  i2cbus_getStats(&after);
+  snprintf(line, sizeof(line), "a bus error is retried, the read taking %u us", (unsigned)us);
+  check(line, ok && after.busErrors == before.busErrors + 1 && us <= 2 * healthyUs + RECOVERY_US);
+
+  //a bus that stays stuck fails the cycle after one recovery
+  i2cbus_getStats(&before);
+  fakeHal_gpioHoldLow(I2CBUS_SDA_PORT, I2CBUS_SDA_PIN, true);
+  us = readUs(imu, &ok, &euler);
+  i2cbus_getStats(&after);
+  fakeHal_gpioHoldLow(I2CBUS_SDA_PORT, I2CBUS_SDA_PIN, false);
+  snprintf(line, sizeof(line), "a stuck bus fails the read after one recovery, in %u us", (unsigned)us);
+  check(line, !ok && after.stuckBus == before.stuckBus + 1 && us <= RECOVERY_US + CPU_SLACK_US);
+
+  //every attempt of a cycle hanging is the worst case the IMU deadline covers
+  i2cbus_getStats(&before);
+  fakeHal_i2cFailNext(FAKE_I2C_HANG, I2CBUS_RETRY_BUDGET + 1, 1);
+  us = readUs(imu, &ok, &euler);
+  i2cbus_getStats(&after);
+  snprintf(line, sizeof(line), "a cycle that spends its retry budget fails in %u us", (unsigned)us);
+  check(line, !ok && after.budgetExhausted == before.budgetExhausted + 1 &&
+              us <= (I2CBUS_RETRY_BUDGET + 1) * I2CBUS_TIMEOUT_MS * 1000 + I2CBUS_RETRY_BUDGET * RECOVERY_US);
+  snprintf(line, sizeof(line), "  inside the %u ms IMU deadline", SUP_IMU_DEADLINE);
+  check(line, us < SUP_IMU_DEADLINE * 1000);
+  us = readUs(imu, &ok, &euler);
+  check("  and the next cycle frees the bus it left hung", ok && us <= healthyUs + RECOVERY_US);
+}
+
+int main() {
+  fakeHal_reset(CORE_HZ);
+  servoChecks();
+  imuChecks();
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,17 @@
+/*
+ * FreeRTOS.h (host)
+ *
+ * The kernel types and configuration that modules built by the runners use;
+ * the calls they make are in task.h and cmsis_os.h.
+ */
+
+#ifndef __FREERTOS_H
+#define __FREERTOS_H
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+
+#define configTICK_RATE_HZ 1000
+
+#endif /* __FREERTOS_H */
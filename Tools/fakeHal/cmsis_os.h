@@ -0,0 +1,33 @@
+/*
+ * cmsis_os.h (host)
+ *
+ * The CMSIS-RTOS2 calls that modules built by the runners make, on the
+ * simulated time of stm32l4xx_hal.h.  There is one thread, so a delay just
+ * lets time pass, and event flags are set with no one to wake.
+ */
+
+#ifndef __CMSIS_OS_H
+#define __CMSIS_OS_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdint.h>
+
+typedef enum {
+  osOK = 0,
+  osError = -1
+} osStatus_t;
+
+typedef void *osEventFlagsId_t;
+typedef void *osMessageQueueId_t;
+
+osStatus_t osDelay(uint32_t ticks);
+uint32_t osEventFlagsSet(osEventFlagsId_t ef_id, uint32_t flags);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __CMSIS_OS_H */
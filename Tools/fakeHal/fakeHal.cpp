@@ -0,0 +1,817 @@
+/*
+ * Host implementation of the HAL subset in stm32l4xx_hal.h.  See fakeHal.h.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string>
+#include "cmsis_os.h"
+#include "fakeHal.h"
+#include "task.h"
+
+uint32_t SystemCoreClock = 80000000;
+uint32_t fakeHal_primask;
+CoreDebug_Type fakeHal_coreDebug;
+SysTick_Type fakeHal_sysTick;
+volatile uint32_t uwTick;     //unused; HAL_GetTick() is simulated time
+
+static uint64_t cycles;
+static DWT_Type dwt;
+
+static int flashFd = -1;
+static uint8_t *flash;
+static bool flashUnlocked;
+static int32_t flashOpsLeft = -1;   //operations until the power is lost, -1 for never
+static fake_flash_stats_t flashStats;
+
+GPIO_TypeDef fakeHal_gpioA = { 0 }, fakeHal_gpioB = { 1 };
+typedef struct {
+  uint16_t odr;
+  uint16_t heldLow;      //pins an outside device pulls low
+  uint32_t mode[16];
+  uint32_t risingEdges[16];
+} fake_port_t;
+static fake_port_t ports[2];
+
+typedef struct {
+  uint64_t atCycle;
+  GPIO_TypeDef *port;
+  uint16_t pins;
+  bool low;
+} fake_gpio_edge_t;
+static fake_gpio_edge_t script[FAKE_GPIO_SCRIPT_LEN];
+static uint8_t scriptLen;
+
+#define I2C1_SCL_PIN GPIO_PIN_9     //on GPIOA
+#define I2C1_SDA_PIN GPIO_PIN_10
+
+I2C_TypeDef fakeHal_i2c1;
+static fake_i2c_device_t devices[FAKE_I2C_DEVICES];
+static uint8_t numDevices;
+static uint32_t i2cHz = 100000;
+static std::string i2cLog;
+static uint32_t i2cBits;
+static uint8_t i2cFault;
+static uint8_t i2cFaultsLeft;
+static uint8_t i2cReleasePulses;
+static int32_t hangPulsesLeft = -1;    //SCL pulses until a hung device lets go, -1 if none hangs
+
+TIM_TypeDef fakeHal_tim2;
+static uint32_t timSeen[FAKE_TIM_REGS];    //register values as of the last sync
+static uint32_t timBase[FAKE_TIM_REGS];    //and as of the last clear of the log
+static fake_tim_write_t timLog[FAKE_TIM_LOG_LEN];
+static uint32_t timLogLen;
+
+RCC_TypeDef fakeHal_rcc;
+SYSCFG_TypeDef fakeHal_syscfg;
+EXTI_TypeDef fakeHal_exti;
+LPTIM_TypeDef fakeHal_lptim1;
+static uint32_t extiPending;
+
+static void catchUp(void);
+
+/**
+ * Starts simulated time over at zero, with the pins released, no scripted
+ * edges or I2C faults pending and TIM2, EXTI and LPTIM1 cleared.
+ * @param coreClock The SystemCoreClock the modules under test see.
+ */
+void fakeHal_reset(uint32_t coreClock) {
+  SystemCoreClock = coreClock;
+  cycles = 0;
+  memset(&dwt, 0, sizeof(dwt));
+  fakeHal_primask = 0;
+  memset(ports, 0, sizeof(ports));
+  scriptLen = 0;
+  i2cFaultsLeft = 0;
+  hangPulsesLeft = -1;
+  fakeHal_i2c1.ISR = 0;
+  memset(&fakeHal_tim2, 0, sizeof(fakeHal_tim2));
+  memset(timSeen, 0, sizeof(timSeen));
+  fakeHal_timClearLog();
+  memset(&fakeHal_exti, 0, sizeof(fakeHal_exti));
+  extiPending = 0;
+  memset(&fakeHal_lptim1, 0, sizeof(fakeHal_lptim1));
+  fakeHal_lptim1.ISR = LPTIM_ISR_ARROK | LPTIM_ISR_CMPOK;   //register writes complete at once
+  memset(&fakeHal_sysTick, 0, sizeof(fakeHal_sysTick));
+}
+
+uint64_t fakeHal_cycles(void) {
+  return cycles;
+}
+
+uint32_t fakeHal_us(void) {
+  return (uint32_t)(cycles / (SystemCoreClock / 1000000U));
+}
+
+void fakeHal_advanceUs(uint32_t us) {
+  catchUp();
+  cycles += (uint64_t)us * (SystemCoreClock / 1000000U);
+  catchUp();
+}
+
+/**
+ * Catches up with the register writes and scripted edges up to now.  HAL
+ * calls do this themselves; call it after a write that no HAL call
+ * follows.
+ */
+void fakeHal_sync(void) {
+  catchUp();
+}
+
+//Every read costs a cycle, so code polling CYCCNT sees time pass.
+DWT_Type *fakeHal_dwt(void) {
+  catchUp();
+  cycles++;
+  dwt.CYCCNT = (uint32_t)cycles;
+  return &dwt;
+}
+
+uint32_t HAL_GetTick(void) {
+  catchUp();
+  return (uint32_t)(cycles / (SystemCoreClock / 1000U));
+}
+
+void HAL_Delay(uint32_t Delay) {
+  fakeHal_advanceUs(Delay * 1000U);
+}
+
+//The RTOS tick is 1 ms, as configTICK_RATE_HZ sets it up.
+osStatus_t osDelay(uint32_t ticks) {
+  fakeHal_advanceUs(ticks * 1000U);
+  return osOK;
+}
+
+uint32_t osEventFlagsSet(osEventFlagsId_t ef_id, uint32_t flags) {
+  (void)ef_id;
+  return flags;
+}
+
+eSleepModeStatus eTaskConfirmSleepModeStatus(void) {
+  return eStandardSleep;
+}
+
+void vTaskStepTick(TickType_t xTicksToJump) {
+  (void)xTicksToJump;
+}
+
+//The HAL tick is simulated time and NVIC settings have no effect.
+void HAL_SuspendTick(void) { }
+void HAL_ResumeTick(void) { }
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority) { }
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) { }
+
+//Sleeps until the next interrupt, taken to be the next 1 ms HAL tick.
+void fakeHal_wfi(void) {
+  uint64_t perMs = SystemCoreClock / 1000U;
+
+  catchUp();
+  cycles = (cycles / perMs + 1) * perMs;
+  catchUp();
+}
+
+/* Flash */
+
+/**
+ * Maps the parameter flash image at its target address.
+ * @param path The image file, created if missing.
+ * @param blank Erase the image first, as on a new part.
+ * @return False if the file cannot be opened or mapped.
+ */
+bool fakeHal_flashOpen(const char *path, bool blank) {
+  fakeHal_flashClose();
+  flashFd = open(path, O_RDWR | O_CREAT, 0644);
+  if (flashFd < 0 || ftruncate(flashFd, FAKE_PARAMS_SIZE) != 0) {
+    return false;
+  }
+  void *map = mmap((void *)FAKE_PARAMS_BASE, FAKE_PARAMS_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_FIXED_NOREPLACE, flashFd, 0);
+  if (map != (void *)FAKE_PARAMS_BASE) {
+    close(flashFd);
+    flashFd = -1;
+    return false;
+  }
+  flash = (uint8_t *)map;
+  if (blank) {
+    memset(flash, 0xFF, FAKE_PARAMS_SIZE);
+  }
+  mprotect(flash, FAKE_PARAMS_SIZE, PROT_READ);
+  flashOpsLeft = -1;
+  memset(&flashStats, 0, sizeof(flashStats));
+  return true;
+}
+
+void fakeHal_flashClose(void) {
+  if (flash) {
+    munmap(flash, FAKE_PARAMS_SIZE);
+    flash = NULL;
+  }
+  if (flashFd >= 0) {
+    close(flashFd);
+    flashFd = -1;
+  }
+}
+
+/**
+ * Cuts the power after the given number of program or erase operations:
+ * the operations after them fail and leave flash as it was.  Reopen the
+ * image, or pass -1, to restore the power.
+ */
+void fakeHal_flashFailAfter(int32_t operations) {
+  flashOpsLeft = operations;
+}
+
+uint8_t *fakeHal_flashImage(void) {
+  return flash;
+}
+
+void fakeHal_flashGetStats(fake_flash_stats_t *out) {
+  *out = flashStats;
+}
+
+//Checks that an operation may run and uses up one from the power budget.
+static bool flashPowered(void) {
+  if (flashOpsLeft == 0) {
+    return false;
+  }
+  if (flashOpsLeft > 0) {
+    flashOpsLeft--;
+  }
+  return true;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) {
+  flashUnlocked = true;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void) {
+  flashUnlocked = false;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data) {
+  uint64_t current;
+
+  if (!flash || !flashUnlocked || TypeProgram != FLASH_TYPEPROGRAM_DOUBLEWORD || (Address & 7) != 0 ||
+      Address < FAKE_PARAMS_BASE || Address >= FAKE_PARAMS_BASE + FAKE_PARAMS_SIZE) {
+    return HAL_ERROR;
+  }
+  if (!flashPowered()) {
+    return HAL_ERROR;
+  }
+  uint8_t *dst = flash + (Address - FAKE_PARAMS_BASE);
+  memcpy(&current, dst, sizeof(current));
+  //like the target, only an erased doubleword, or writing all zeros, is allowed
+  if (current != 0xFFFFFFFFFFFFFFFFULL && Data != 0) {
+    flashStats.rejected++;
+    return HAL_ERROR;
+  }
+  mprotect(flash, FAKE_PARAMS_SIZE, PROT_READ | PROT_WRITE);
+  memcpy(dst, &Data, sizeof(Data));
+  mprotect(flash, FAKE_PARAMS_SIZE, PROT_READ);
+  flashStats.programs++;
+  fakeHal_advanceUs(FAKE_FLASH_PROGRAM_US);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError) {
+  uint32_t first = (FAKE_PARAMS_BASE - FLASH_BASE) / FLASH_PAGE_SIZE;
+
+  *PageError = 0xFFFFFFFFU;
+  if (!flash || !flashUnlocked || pEraseInit->TypeErase != FLASH_TYPEERASE_PAGES) {
+    return HAL_ERROR;
+  }
+  for (uint32_t page = pEraseInit->Page; page < pEraseInit->Page + pEraseInit->NbPages; page++) {
+    if (page < first || page >= first + FAKE_PARAMS_SIZE / FLASH_PAGE_SIZE || !flashPowered()) {
+      *PageError = page;
+      return HAL_ERROR;
+    }
+    mprotect(flash, FAKE_PARAMS_SIZE, PROT_READ | PROT_WRITE);
+    memset(flash + (page - first) * FLASH_PAGE_SIZE, 0xFF, FLASH_PAGE_SIZE);
+    mprotect(flash, FAKE_PARAMS_SIZE, PROT_READ);
+    flashStats.erases++;
+    fakeHal_advanceUs(FAKE_FLASH_ERASE_US);
+  }
+  return HAL_OK;
+}
+
+/* GPIO */
+
+static fake_port_t *portOf(GPIO_TypeDef *port) {
+  return &ports[port->port];
+}
+
+void fakeHal_gpioHoldLow(GPIO_TypeDef *port, uint16_t pins, bool low) {
+  if (low) {
+    portOf(port)->heldLow |= pins;
+  }
+  else {
+    portOf(port)->heldLow &= ~pins;
+  }
+  catchUp();
+}
+
+/**
+ * Has an outside device pull pins low, or let go of them, at a given time.
+ * @param atUs Simulated time of the edge; one in the past is applied at
+ * the next HAL call.
+ * @return False if the script is full.
+ */
+bool fakeHal_gpioScript(GPIO_TypeDef *port, uint16_t pins, uint32_t atUs, bool low) {
+  uint64_t at = (uint64_t)atUs * (SystemCoreClock / 1000000U);
+  uint8_t i;
+
+  if (scriptLen == FAKE_GPIO_SCRIPT_LEN) {
+    return false;
+  }
+  //keep the script in time order, edges at the same time in the order given
+  for (i = scriptLen; i > 0 && script[i - 1].atCycle > at; i--) {
+    script[i] = script[i - 1];
+  }
+  script[i].atCycle = at;
+  script[i].port = port;
+  script[i].pins = pins;
+  script[i].low = low;
+  scriptLen++;
+  return true;
+}
+
+//Applies the scripted edges that are due.
+static void runScript(void) {
+  uint8_t done = 0;
+
+  while (done < scriptLen && script[done].atCycle <= cycles) {
+    fake_gpio_edge_t *edge = &script[done++];
+    if (edge->low) {
+      portOf(edge->port)->heldLow |= edge->pins;
+    }
+    else {
+      portOf(edge->port)->heldLow &= ~edge->pins;
+    }
+  }
+  if (done > 0) {
+    memmove(script, script + done, (scriptLen - done) * sizeof(script[0]));
+    scriptLen -= done;
+  }
+}
+
+//Times a pin was driven from low to high as an output.
+uint32_t fakeHal_gpioRisingEdges(GPIO_TypeDef *port, uint16_t pin) {
+  for (uint8_t i = 0; i < 16; i++) {
+    if (pin & (1U << i)) {
+      return portOf(port)->risingEdges[i];
+    }
+  }
+  return 0;
+}
+
+uint32_t fakeHal_gpioMode(GPIO_TypeDef *port, uint16_t pin) {
+  for (uint8_t i = 0; i < 16; i++) {
+    if (pin & (1U << i)) {
+      return portOf(port)->mode[i];
+    }
+  }
+  return GPIO_MODE_ANALOG;
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init) {
+  catchUp();
+  for (uint8_t i = 0; i < 16; i++) {
+    if (GPIO_Init->Pin & (1U << i)) {
+      portOf(GPIOx)->mode[i] = GPIO_Init->Mode;
+    }
+  }
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState) {
+  fake_port_t *p = portOf(GPIOx);
+
+  catchUp();
+  if (PinState == GPIO_PIN_SET) {
+    for (uint8_t i = 0; i < 16; i++) {
+      uint32_t mode = p->mode[i];
+      if ((GPIO_Pin & ~p->odr & (1U << i)) && (mode == GPIO_MODE_OUTPUT_PP || mode == GPIO_MODE_OUTPUT_OD)) {
+        p->risingEdges[i]++;
+      }
+    }
+    //a hung device shifts out one bit per SCL pulse, then lets go of SDA
+    if (GPIOx == GPIOA && (GPIO_Pin & ~p->odr & I2C1_SCL_PIN) && hangPulsesLeft > 0 &&
+        --hangPulsesLeft == 0) {
+      p->heldLow &= ~I2C1_SDA_PIN;
+      hangPulsesLeft = -1;
+    }
+    p->odr |= GPIO_Pin;
+  }
+  else {
+    p->odr &= ~GPIO_Pin;
+  }
+  catchUp();
+}
+
+//Outputs drive their level, anything else floats high on the pull-ups.
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin) {
+  fake_port_t *p = portOf(GPIOx);
+  uint32_t mode = fakeHal_gpioMode(GPIOx, GPIO_Pin);
+  catchUp();
+  bool output = mode == GPIO_MODE_OUTPUT_PP || mode == GPIO_MODE_OUTPUT_OD;
+
+  if ((p->heldLow & GPIO_Pin) || (output && !(p->odr & GPIO_Pin))) {
+    return GPIO_PIN_RESET;
+  }
+  return GPIO_PIN_SET;
+}
+
+//The levels of all pins, as IDR shows them.
+static uint16_t portLevels(fake_port_t *p) {
+  uint16_t levels = 0xFFFF & ~p->heldLow;
+
+  for (uint8_t i = 0; i < 16; i++) {
+    uint32_t mode = p->mode[i];
+    if ((mode == GPIO_MODE_OUTPUT_PP || mode == GPIO_MODE_OUTPUT_OD) && !(p->odr & (1U << i))) {
+      levels &= ~(1U << i);
+    }
+  }
+  return levels;
+}
+
+/* I2C */
+
+/**
+ * Puts a device on the bus with all registers zero.
+ * @param latencyUs Time the device stretches the clock in every transfer.
+ * @return The device, whose registers the runner may change, or NULL if
+ * the bus is full.
+ */
+fake_i2c_device_t *fakeHal_i2cAddDevice(uint8_t addr, uint32_t latencyUs) {
+  if (numDevices == FAKE_I2C_DEVICES) {
+    return NULL;
+  }
+  fake_i2c_device_t *dev = &devices[numDevices++];
+  memset(dev, 0, sizeof(*dev));
+  dev->addr = addr;
+  dev->latencyUs = latencyUs;
+  return dev;
+}
+
+void fakeHal_i2cRemoveDevices(void) {
+  numDevices = 0;
+}
+
+void fakeHal_i2cSetHz(uint32_t hz) {
+  i2cHz = hz;
+}
+
+const char *fakeHal_i2cLog(void) {
+  return i2cLog.c_str();
+}
+
+//SCL periods of every transfer logged since the last clear.
+uint32_t fakeHal_i2cBits(void) {
+  return i2cBits;
+}
+
+void fakeHal_i2cClearLog(void) {
+  i2cLog.clear();
+  i2cBits = 0;
+}
+
+/**
+ * Makes the next transfers that a device acknowledges fail after the
+ * address byte.
+ * @param fault FAKE_I2C_BUS_ERROR, or FAKE_I2C_HANG, where the transfer
+ * times out and the device holds SDA low.
+ * @param transfers How many transfers in a row fail.
+ * @param releasePulses SCL pulses a hung device needs to let go of SDA; 0
+ * for never, until the runner releases it.
+ */
+void fakeHal_i2cFailNext(uint8_t fault, uint8_t transfers, uint8_t releasePulses) {
+  i2cFault = fault;
+  i2cFaultsLeft = transfers;
+  i2cReleasePulses = releasePulses;
+}
+
+static fake_i2c_device_t *findDevice(uint8_t addr) {
+  for (uint8_t i = 0; i < numDevices; i++) {
+    if (devices[i].addr == addr) {
+      return &devices[i];
+    }
+  }
+  return NULL;
+}
+
+static void logSymbol(const char *symbol, uint32_t bits) {
+  i2cLog += i2cLog.empty() ? "" : " ";
+  i2cLog += symbol;
+  i2cBits += bits;
+}
+
+static void logByte(const char *prefix, uint8_t value, const char *suffix) {
+  char symbol[8];
+  snprintf(symbol, sizeof(symbol), "%s%02X%s", prefix, value, suffix);
+  logSymbol(symbol, 9);
+}
+
+//Sends START and the address byte; NULL, after a STOP, if nobody acknowledged.
+static fake_i2c_device_t *addressDevice(uint16_t devAddress, bool read, bool repeated) {
+  uint8_t addr = (uint8_t)(devAddress >> 1);
+  fake_i2c_device_t *dev = findDevice(addr);
+
+  logSymbol(repeated ? "Sr" : "S", 1);
+  logByte(read ? "R" : "W", addr, dev ? "" : "!");
+  if (!dev) {
+    logSymbol("P", 1);
+  }
+  return dev;
+}
+
+//Ends a transfer with the pending fault, if there is one.
+static bool injectFault(I2C_HandleTypeDef *hi2c, uint32_t startBits, uint32_t timeoutMs) {
+  if (i2cFaultsLeft == 0) {
+    return false;
+  }
+  i2cFaultsLeft--;
+  if (i2cFault == FAKE_I2C_BUS_ERROR) {
+    logSymbol("BERR", 0);
+    fakeHal_advanceUs((uint32_t)((uint64_t)(i2cBits - startBits) * 1000000U / i2cHz));
+    hi2c->ErrorCode = HAL_I2C_ERROR_BERR;
+    return true;
+  }
+  logSymbol("HANG", 0);
+  portOf(GPIOA)->heldLow |= I2C1_SDA_PIN;
+  hangPulsesLeft = i2cReleasePulses ? i2cReleasePulses : -1;
+  fakeHal_advanceUs(timeoutMs * 1000U);
+  hi2c->ErrorCode = HAL_I2C_ERROR_TIMEOUT;
+  return true;
+}
+
+//Advances time by a transfer's bits and the device's latency; fails past the timeout.
+static HAL_StatusTypeDef finish(I2C_HandleTypeDef *hi2c, uint32_t startBits, uint32_t latencyUs,
+                                uint32_t timeoutMs) {
+  uint32_t us = (uint32_t)((uint64_t)(i2cBits - startBits) * 1000000U / i2cHz) + latencyUs;
+  if (us > timeoutMs * 1000U) {
+    fakeHal_advanceUs(timeoutMs * 1000U);
+    hi2c->ErrorCode = HAL_I2C_ERROR_TIMEOUT;
+    return HAL_ERROR;
+  }
+  fakeHal_advanceUs(us);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c) {
+  hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+  hi2c->Instance->ISR = 0;
+  catchUp();
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c) {
+  hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+  return HAL_OK;
+}
+
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef *hi2c) {
+  return hi2c->ErrorCode;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                          uint16_t Size, uint32_t Timeout) {
+  uint32_t startBits = i2cBits;
+
+  catchUp();
+  hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+  fake_i2c_device_t *dev = addressDevice(DevAddress, false, false);
+  if (!dev) {
+    finish(hi2c, startBits, 0, Timeout);
+    hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+    return HAL_ERROR;
+  }
+  if (injectFault(hi2c, startBits, Timeout)) {
+    return HAL_ERROR;
+  }
+  for (uint16_t i = 0; i < Size; i++) {
+    logByte("", pData[i], "");
+    if (i == 0) {
+      dev->pointer = pData[i];
+    }
+    else {
+      dev->regs[dev->pointer++] = pData[i];
+    }
+  }
+  logSymbol("P", 1);
+  return finish(hi2c, startBits, dev->latencyUs, Timeout);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                   uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+  uint32_t startBits = i2cBits;
+
+  catchUp();
+  hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+  fake_i2c_device_t *dev = addressDevice(DevAddress, false, false);
+  if (!dev || MemAddSize != I2C_MEMADD_SIZE_8BIT) {
+    finish(hi2c, startBits, 0, Timeout);
+    hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+    return HAL_ERROR;
+  }
+  if (injectFault(hi2c, startBits, Timeout)) {
+    return HAL_ERROR;
+  }
+  logByte("", (uint8_t)MemAddress, "");
+  dev->pointer = (uint8_t)MemAddress;
+  addressDevice(DevAddress, true, true);
+  for (uint16_t i = 0; i < Size; i++) {
+    pData[i] = dev->regs[dev->pointer++];
+    logByte("<", pData[i], "");
+  }
+  logSymbol("P", 1);
+  return finish(hi2c, startBits, dev->latencyUs, Timeout);
+}
+
+/* TIM */
+
+static volatile uint32_t *timReg(uint8_t reg) {
+  switch (reg) {
+  case FAKE_TIM_PSC:  return &fakeHal_tim2.PSC;
+  case FAKE_TIM_ARR:  return &fakeHal_tim2.ARR;
+  case FAKE_TIM_CCER: return &fakeHal_tim2.CCER;
+  case FAKE_TIM_CCR1: return &fakeHal_tim2.CCR1;
+  case FAKE_TIM_CCR2: return &fakeHal_tim2.CCR2;
+  case FAKE_TIM_CCR3: return &fakeHal_tim2.CCR3;
+  default:            return &fakeHal_tim2.CCR4;
+  }
+}
+
+//Logs the registers that changed since the last sync and moves the counter on.
+static void timSync(void) {
+  for (uint8_t reg = 0; reg < FAKE_TIM_REGS; reg++) {
+    uint32_t value = *timReg(reg);
+    if (value != timSeen[reg]) {
+      timSeen[reg] = value;
+      if (timLogLen < FAKE_TIM_LOG_LEN) {
+        timLog[timLogLen].cycle = cycles;
+        timLog[timLogLen].reg = reg;
+        timLog[timLogLen].value = value;
+        timLogLen++;
+      }
+    }
+  }
+  fakeHal_tim2.CNT = (uint32_t)((cycles / (fakeHal_tim2.PSC + 1)) % ((uint64_t)fakeHal_tim2.ARR + 1));
+}
+
+static void catchUp(void) {
+  runScript();
+  if (portOf(GPIOA)->heldLow & (I2C1_SCL_PIN | I2C1_SDA_PIN)) {
+    fakeHal_i2c1.ISR |= I2C_FLAG_BUSY;
+  }
+  else {
+    fakeHal_i2c1.ISR &= ~I2C_FLAG_BUSY;
+  }
+  timSync();
+  fakeHal_gpioA.IDR = portLevels(portOf(GPIOA));
+  fakeHal_gpioB.IDR = portLevels(portOf(GPIOB));
+}
+
+/**
+ * Empties the TIM2 timeline; the registers as they are now become the
+ * starting point that fakeHal_pwmFrame() replays the timeline from.
+ */
+void fakeHal_timClearLog(void) {
+  catchUp();
+  memcpy(timBase, timSeen, sizeof(timBase));
+  timLogLen = 0;
+}
+
+uint32_t fakeHal_timWriteCount(void) {
+  catchUp();
+  return timLogLen;
+}
+
+bool fakeHal_timWriteGet(uint32_t index, fake_tim_write_t *out) {
+  if (index >= timLogLen) {
+    return false;
+  }
+  *out = timLog[index];
+  return true;
+}
+
+/**
+ * Tells what a channel output in the first PWM frame that starts at or
+ * after a given time.  Compare values are preloaded, so the frame shows
+ * the value last written before its update event.  The enable bit is not
+ * preloaded; a channel switched off during a pulse cuts it short, and one
+ * switched on during a frame is treated as on from the next.
+ * @param channel 1 to 4.
+ * @param fromCycle Simulated time, in core clock cycles.
+ * @return False if the frame has not ended yet.
+ */
+bool fakeHal_pwmFrame(uint8_t channel, uint64_t fromCycle, fake_pwm_frame_t *out) {
+  uint32_t regs[FAKE_TIM_REGS];
+  uint32_t i = 0;
+
+  catchUp();
+  memcpy(regs, timBase, sizeof(regs));
+  for (; i < timLogLen && timLog[i].cycle <= fromCycle; i++) {
+    regs[timLog[i].reg] = timLog[i].value;
+  }
+  uint32_t prescale = regs[FAKE_TIM_PSC] + 1;
+  out->frameCycles = prescale * (regs[FAKE_TIM_ARR] + 1);
+  out->startCycle = (fromCycle + out->frameCycles - 1) / out->frameCycles * out->frameCycles;
+  if (out->startCycle + out->frameCycles > cycles) {
+    return false;
+  }
+  for (; i < timLogLen && timLog[i].cycle <= out->startCycle; i++) {
+    regs[timLog[i].reg] = timLog[i].value;
+  }
+  uint32_t enable = TIM_CCER_CC1E << (4 * (channel - 1));
+  uint32_t width = regs[FAKE_TIM_CCR1 + channel - 1];
+  out->enabled = (regs[FAKE_TIM_CCER] & enable) != 0;
+  out->widthCounts = out->enabled ? width : 0;
+  for (; i < timLogLen && timLog[i].cycle < out->startCycle + (uint64_t)width * prescale; i++) {
+    if (timLog[i].reg == FAKE_TIM_CCER && !(timLog[i].value & enable) && out->widthCounts == width) {
+      out->widthCounts = (uint32_t)((timLog[i].cycle - out->startCycle) / prescale);
+    }
+  }
+  return true;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel) {
+  catchUp();
+  htim->Instance->CCER |= TIM_CCER_CC1E << Channel;
+  catchUp();
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef *htim, uint32_t Channel) {
+  catchUp();
+  htim->Instance->CCER &= ~(TIM_CCER_CC1E << Channel);
+  catchUp();
+  return HAL_OK;
+}
+
+/* PWR */
+
+/**
+ * STOP2: time passes until LPTIM1, counting the LSE from the moment of
+ * entry, matches its compare value, or until a scripted falling edge on a
+ * GPIOA pin whose EXTI line is unmasked and falling edge triggered, which
+ * is then pending until fakeHal_extiTake().  LPTIM1->CNT holds the LSE
+ * counts spent stopped.
+ */
+void HAL_PWREx_EnterSTOP2Mode(uint8_t STOPEntry) {
+  uint64_t start, wake = UINT64_MAX;
+  uint32_t lines = fakeHal_exti.IMR1 & fakeHal_exti.FTSR1;
+  uint32_t pending = 0;
+
+  (void)STOPEntry;
+  catchUp();
+  start = cycles;
+  if ((fakeHal_lptim1.CR & LPTIM_CR_ENABLE) && (fakeHal_lptim1.IER & LPTIM_IER_CMPMIE)) {
+    wake = start + (uint64_t)fakeHal_lptim1.CMP * SystemCoreClock / FAKE_LSE_HZ;
+  }
+  uint16_t held = portOf(GPIOA)->heldLow;
+  for (uint8_t i = 0; i < scriptLen && script[i].atCycle < wake; i++) {
+    if (script[i].port != GPIOA) {
+      continue;
+    }
+    if (script[i].low) {
+      pending = script[i].pins & ~held & lines;
+      held |= script[i].pins;
+      if (pending) {
+        wake = script[i].atCycle;
+        break;
+      }
+    }
+    else {
+      held &= ~script[i].pins;
+    }
+  }
+  if (wake == UINT64_MAX) {
+    return;   //nothing would wake the chip
+  }
+
+  cycles = wake;
+  catchUp();
+  fakeHal_lptim1.CNT = (uint32_t)((wake - start) * FAKE_LSE_HZ / SystemCoreClock);
+  if (pending) {
+    fakeHal_exti.PR1 |= pending;
+    extiPending |= pending;
+  }
+  else {
+    fakeHal_lptim1.ISR |= LPTIM_ISR_CMPM;
+  }
+}
+
+/**
+ * Takes the EXTI lines that became pending, as the NVIC would by running
+ * their handlers.  PR1 clears when written with ones, which the fake
+ * cannot see, so the runner asks here rather than reading it.
+ * @return The lines, as EXTI_PR1_PIFx bits.
+ */
+uint32_t fakeHal_extiTake(void) {
+  uint32_t lines = extiPending;
+  extiPending = 0;
+  return lines;
+}
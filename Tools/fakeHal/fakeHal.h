@@ -0,0 +1,143 @@
+/*
+ * fakeHal.h
+ *
+ * Runner side of the host HAL in this folder: simulated time and the state
+ * of the fake peripherals.
+ *
+ * The parameter flash is a file mapped at the address the linker script
+ * gives the PARAMS region, so pointers into it are the target's.  Link the
+ * runner with -no-pie -Wl,--defsym,_sparams=0x0803F000 for that.  The
+ * mapping is read-only outside of HAL_FLASH_Program and HAL_FLASHEx_Erase,
+ * so a stray write faults as it would on the target.  Programming a
+ * doubleword that is not erased fails, an erase fills the page with 0xFF,
+ * and each operation takes its datasheet time.
+ *
+ * I2C devices are register files with an auto-incrementing register
+ * pointer, set by the first byte written.  Each transfer appends its
+ * framing to a log, e.g. "S W28 1A Sr R28 <00 <01 P" for a two-byte read
+ * of register 0x1A at address 0x28 ("!" marks a NACK), counts its SCL
+ * periods and advances time by them at the bus clock, plus the latency
+ * the device stretches the clock by.  fakeHal_i2cFailNext() makes the next
+ * transfers end in a bus error, or hang with the device holding SDA low
+ * until SCL is pulsed the given number of times.  I2C1 is on PA9 (SCL) and
+ * PA10 (SDA) as on the board, and its BUSY flag is set while either line is
+ * held low.
+ *
+ * Pins read high unless driven low or held low by an outside device, as on
+ * a bus with pull-ups.  Edges of the outside devices can be scripted at
+ * given times; they take effect at the first HAL call at or after it.
+ *
+ * TIM2 counts at SystemCoreClock / (PSC + 1) from time zero.  Every change
+ * of its prescaler, reload, enable and compare registers goes into a
+ * timeline.  Compare values are preloaded, as HAL_TIM_PWM_ConfigChannel()
+ * sets them up, so each PWM frame outputs the values in effect at its
+ * update event; fakeHal_pwmFrame() replays the timeline to tell what the
+ * servo saw.
+ *
+ * GPIOx->IDR shows the pin levels as of the last HAL call or DWT read.
+ * __WFI() sleeps until the next 1 ms HAL tick.  STOP2 lasts until LPTIM1,
+ * clocked from the LSE, reaches its compare value or until a scripted
+ * falling edge on a GPIOA pin with its EXTI line armed; the runner then
+ * takes the pending line with fakeHal_extiTake() and calls the handler
+ * itself.
+ */
+
+#ifndef __FAKEHAL_H
+#define __FAKEHAL_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include "stm32l4xx_hal.h"
+
+#define FAKE_PARAMS_BASE 0x0803F000UL
+#define FAKE_PARAMS_SIZE 0x1000U
+
+#define FAKE_FLASH_PROGRAM_US 82       //one doubleword
+#define FAKE_FLASH_ERASE_US 22020      //one page
+
+#define FAKE_I2C_DEVICES 4
+#define FAKE_GPIO_SCRIPT_LEN 16
+#define FAKE_TIM_LOG_LEN 1024
+#define FAKE_LSE_HZ 32768
+
+//Faults of fakeHal_i2cFailNext()
+#define FAKE_I2C_BUS_ERROR 1   //misplaced START or STOP after the address
+#define FAKE_I2C_HANG 2        //the device holds SDA low and stops answering
+
+//Registers in the TIM2 timeline
+enum {
+  FAKE_TIM_PSC,
+  FAKE_TIM_ARR,
+  FAKE_TIM_CCER,
+  FAKE_TIM_CCR1,
+  FAKE_TIM_CCR2,
+  FAKE_TIM_CCR3,
+  FAKE_TIM_CCR4,
+  FAKE_TIM_REGS
+};
+
+typedef struct {
+  uint64_t cycle;
+  uint8_t reg;
+  uint32_t value;
+} fake_tim_write_t;
+
+typedef struct {
+  uint64_t startCycle;   //update event that starts the frame
+  uint32_t frameCycles;
+  bool enabled;          //the channel output was on
+  uint32_t widthCounts;  //pulse width, 0 for no pulse
+} fake_pwm_frame_t;
+
+typedef struct {
+  uint8_t addr;          //7-bit
+  uint32_t latencyUs;    //clock stretching per transfer
+  uint8_t pointer;
+  uint8_t regs[256];
+} fake_i2c_device_t;
+
+typedef struct {
+  uint32_t programs;
+  uint32_t erases;
+  uint32_t rejected;    //programs of a doubleword that was not erased
+} fake_flash_stats_t;
+
+void fakeHal_reset(uint32_t coreClock);
+uint64_t fakeHal_cycles(void);
+uint32_t fakeHal_us(void);
+void fakeHal_advanceUs(uint32_t us);
+void fakeHal_sync(void);
+
+bool fakeHal_flashOpen(const char *path, bool blank);
+void fakeHal_flashClose(void);
+void fakeHal_flashFailAfter(int32_t operations);
+uint8_t *fakeHal_flashImage(void);
+void fakeHal_flashGetStats(fake_flash_stats_t *out);
+
+void fakeHal_gpioHoldLow(GPIO_TypeDef *port, uint16_t pins, bool low);
+bool fakeHal_gpioScript(GPIO_TypeDef *port, uint16_t pins, uint32_t atUs, bool low);
+uint32_t fakeHal_gpioMode(GPIO_TypeDef *port, uint16_t pin);
+uint32_t fakeHal_gpioRisingEdges(GPIO_TypeDef *port, uint16_t pin);
+
+fake_i2c_device_t *fakeHal_i2cAddDevice(uint8_t addr, uint32_t latencyUs);
+void fakeHal_i2cRemoveDevices(void);
+void fakeHal_i2cSetHz(uint32_t hz);
+const char *fakeHal_i2cLog(void);
+uint32_t fakeHal_i2cBits(void);
+void fakeHal_i2cClearLog(void);
+void fakeHal_i2cFailNext(uint8_t fault, uint8_t transfers, uint8_t releasePulses);
+
+void fakeHal_timClearLog(void);
+uint32_t fakeHal_timWriteCount(void);
+bool fakeHal_timWriteGet(uint32_t index, fake_tim_write_t *out);
+bool fakeHal_pwmFrame(uint8_t channel, uint64_t fromCycle, fake_pwm_frame_t *out);
+
+uint32_t fakeHal_extiTake(void);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __FAKEHAL_H */
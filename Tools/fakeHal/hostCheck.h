@@ -0,0 +1,22 @@
+/*
+ * hostCheck.h
+ *
+ * Pass/fail reporting shared by the host runners in Tools/.  Each check
+ * prints its step and "ok" or "FAIL" on one line and counts the failures;
+ * a runner exits with failures ? 1 : 0.  Include it from the runner's own
+ * source only, as every runner is a single program.
+ */
+
+#ifndef __HOSTCHECK_H
+#define __HOSTCHECK_H
+
+#include <stdio.h>
+
+static int failures;
+
+static void check(const char *step, bool ok) {
+  printf("%-60s %s\n", step, ok ? "ok" : "FAIL");
+  failures += !ok;
+}
+
+#endif /* __HOSTCHECK_H */
@@ -0,0 +1,315 @@
+/*
+ * stm32l4xx_hal.h (host)
+ *
+ * Stands in for the STM32L4 HAL when firmware modules are built on a host by
+ * the runners in Tools/.  Put Tools/fakeHal on the include path ahead of
+ * Core/Inc and the Drivers folders.  Only what the modules under test use is
+ * declared, with the HAL's names and signatures; the behaviour behind it is
+ * in fakeHal.cpp and the runner controls it through fakeHal.h.
+ *
+ * Time is simulated: nothing advances it except the fake peripherals and
+ * every read of DWT, which costs one cycle so that polling loops end.  An
+ * I2C transfer takes its bit times at the bus clock plus the device's
+ * latency.  Register writes, such as TIM2->CCR1, are plain stores; the fake
+ * notices them at the next HAL call or DWT read, which in simulated time is
+ * the moment of the write.
+ *
+ * There is no interrupt controller: a runner calls the handlers of the
+ * modules under test itself, e.g. when fakeHal_extiTake() finds an EXTI
+ * line pending after HAL_PWREx_EnterSTOP2Mode() returns.
+ */
+
+#ifndef __STM32L4xx_HAL_H
+#define __STM32L4xx_HAL_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+  HAL_OK = 0x00,
+  HAL_ERROR = 0x01,
+  HAL_BUSY = 0x02,
+  HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+/* Core */
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+  volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef struct {
+  volatile uint32_t CTRL;
+  volatile uint32_t VAL;
+} SysTick_Type;
+
+typedef enum {
+  EXTI4_IRQn = 10,
+  EXTI15_10_IRQn = 40,
+  LPTIM1_IRQn = 65
+} IRQn_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define DWT (fakeHal_dwt())
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define CoreDebug (&fakeHal_coreDebug)
+#define SysTick_CTRL_ENABLE_Msk (1UL << 0)
+#define SysTick (&fakeHal_sysTick)
+#define MODIFY_REG(REG, CLEARMASK, SETMASK) ((REG) = (((REG) & ~(CLEARMASK)) | (SETMASK)))
+
+extern CoreDebug_Type fakeHal_coreDebug;
+extern SysTick_Type fakeHal_sysTick;
+extern volatile uint32_t uwTick;
+
+extern uint32_t SystemCoreClock;
+extern uint32_t fakeHal_primask;
+
+static inline uint32_t __get_PRIMASK(void) { return fakeHal_primask; }
+static inline void __set_PRIMASK(uint32_t priMask) { fakeHal_primask = priMask; }
+static inline void __disable_irq(void) { fakeHal_primask = 1; }
+static inline void __enable_irq(void) { fakeHal_primask = 0; }
+static inline void __DMB(void) { }
+static inline void __DSB(void) { }
+static inline void __ISB(void) { }
+
+void fakeHal_wfi(void);
+static inline void __WFI(void) { fakeHal_wfi(); }
+
+DWT_Type *fakeHal_dwt(void);
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+void HAL_SuspendTick(void);
+void HAL_ResumeTick(void);
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+
+/* Flash */
+#define FLASH_BASE 0x08000000UL
+#define FLASH_PAGE_SIZE 0x800U
+#define FLASH_TYPEPROGRAM_DOUBLEWORD 0x00U
+#define FLASH_TYPEERASE_PAGES 0x00U
+#define FLASH_BANK_1 0x01U
+#define FLASH_FLAG_ALL_ERRORS 0xC3FAU
+#define __HAL_FLASH_CLEAR_FLAG(__FLAG__) ((void)(__FLAG__))
+
+typedef struct {
+  uint32_t TypeErase;
+  uint32_t Banks;
+  uint32_t Page;
+  uint32_t NbPages;
+} FLASH_EraseInitTypeDef;
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef *pEraseInit, uint32_t *PageError);
+
+/* GPIO */
+typedef struct {
+  uint32_t port;    //0 for GPIOA
+  volatile uint32_t IDR;
+} GPIO_TypeDef;
+
+typedef enum {
+  GPIO_PIN_RESET = 0,
+  GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct {
+  uint32_t Pin;
+  uint32_t Mode;
+  uint32_t Pull;
+  uint32_t Speed;
+  uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+extern GPIO_TypeDef fakeHal_gpioA, fakeHal_gpioB;
+#define GPIOA (&fakeHal_gpioA)
+#define GPIOB (&fakeHal_gpioB)
+
+#define GPIO_PIN_0 0x0001U
+#define GPIO_PIN_1 0x0002U
+#define GPIO_PIN_2 0x0004U
+#define GPIO_PIN_3 0x0008U
+#define GPIO_PIN_4 0x0010U
+#define GPIO_PIN_5 0x0020U
+#define GPIO_PIN_6 0x0040U
+#define GPIO_PIN_7 0x0080U
+#define GPIO_PIN_8 0x0100U
+#define GPIO_PIN_9 0x0200U
+#define GPIO_PIN_10 0x0400U
+#define GPIO_PIN_11 0x0800U
+#define GPIO_PIN_12 0x1000U
+#define GPIO_PIN_13 0x2000U
+#define GPIO_PIN_14 0x4000U
+#define GPIO_PIN_15 0x8000U
+
+#define GPIO_MODE_INPUT 0x00U
+#define GPIO_MODE_OUTPUT_PP 0x01U
+#define GPIO_MODE_OUTPUT_OD 0x11U
+#define GPIO_MODE_AF_OD 0x12U
+#define GPIO_MODE_ANALOG 0x03U
+#define GPIO_NOPULL 0x00U
+#define GPIO_PULLUP 0x01U
+#define GPIO_SPEED_FREQ_LOW 0x00U
+#define GPIO_SPEED_FREQ_HIGH 0x02U
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin);
+
+/* I2C */
+typedef struct {
+  volatile uint32_t ISR;
+} I2C_TypeDef;
+
+typedef struct {
+  uint32_t Timing;
+  uint32_t OwnAddress1;
+  uint32_t AddressingMode;
+} I2C_InitTypeDef;
+
+typedef struct {
+  I2C_TypeDef *Instance;
+  I2C_InitTypeDef Init;
+  volatile uint32_t ErrorCode;
+} I2C_HandleTypeDef;
+
+extern I2C_TypeDef fakeHal_i2c1;
+#define I2C1 (&fakeHal_i2c1)
+
+#define HAL_I2C_ERROR_NONE 0x00U
+#define HAL_I2C_ERROR_BERR 0x01U
+#define HAL_I2C_ERROR_ARLO 0x02U
+#define HAL_I2C_ERROR_AF 0x04U
+#define HAL_I2C_ERROR_OVR 0x08U
+#define HAL_I2C_ERROR_TIMEOUT 0x20U
+#define I2C_FLAG_BUSY (1UL << 15)
+#define I2C_MEMADD_SIZE_8BIT 0x01U
+#define __HAL_I2C_GET_FLAG(__HANDLE__, __FLAG__) \
+  ((((__HANDLE__)->Instance->ISR) & (__FLAG__)) == (__FLAG__))
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef *hi2c);
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef *hi2c);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                          uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                   uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+
+/* TIM */
+typedef struct {
+  volatile uint32_t CR1;
+  volatile uint32_t CCER;
+  volatile uint32_t CNT;
+  volatile uint32_t PSC;
+  volatile uint32_t ARR;
+  volatile uint32_t CCR1;
+  volatile uint32_t CCR2;
+  volatile uint32_t CCR3;
+  volatile uint32_t CCR4;
+} TIM_TypeDef;
+
+typedef struct {
+  TIM_TypeDef *Instance;
+} TIM_HandleTypeDef;
+
+extern TIM_TypeDef fakeHal_tim2;
+#define TIM2 (&fakeHal_tim2)
+
+#define TIM_CHANNEL_1 0x00U
+#define TIM_CHANNEL_2 0x04U
+#define TIM_CHANNEL_3 0x08U
+#define TIM_CHANNEL_4 0x0CU
+#define TIM_CCER_CC1E (1UL << 0)
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef *htim, uint32_t Channel);
+
+/* USART */
+typedef struct {
+  void *Instance;
+} UART_HandleTypeDef;
+
+/* RCC, SYSCFG and EXTI */
+typedef struct {
+  volatile uint32_t CCIPR;
+} RCC_TypeDef;
+
+typedef struct {
+  volatile uint32_t EXTICR[4];
+} SYSCFG_TypeDef;
+
+typedef struct {
+  volatile uint32_t IMR1;
+  volatile uint32_t FTSR1;
+  volatile uint32_t PR1;
+  volatile uint32_t IMR2;
+} EXTI_TypeDef;
+
+extern RCC_TypeDef fakeHal_rcc;
+extern SYSCFG_TypeDef fakeHal_syscfg;
+extern EXTI_TypeDef fakeHal_exti;
+#define RCC (&fakeHal_rcc)
+#define SYSCFG (&fakeHal_syscfg)
+#define EXTI (&fakeHal_exti)
+
+#define __HAL_RCC_LPTIM1_CLK_ENABLE() do { } while (0)
+#define __HAL_RCC_SYSCFG_CLK_ENABLE() do { } while (0)
+#define RCC_CCIPR_LPTIM1SEL (3UL << 18)
+#define SYSCFG_EXTICR2_EXTI4 (7UL << 0)
+#define SYSCFG_EXTICR2_EXTI4_PA 0UL
+#define SYSCFG_EXTICR4_EXTI15 (7UL << 12)
+#define SYSCFG_EXTICR4_EXTI15_PA 0UL
+#define EXTI_IMR1_IM4 (1UL << 4)
+#define EXTI_IMR1_IM15 (1UL << 15)
+#define EXTI_FTSR1_FT4 (1UL << 4)
+#define EXTI_FTSR1_FT15 (1UL << 15)
+#define EXTI_PR1_PIF4 (1UL << 4)
+#define EXTI_PR1_PIF15 (1UL << 15)
+#define EXTI_IMR2_IM32 (1UL << 0)
+
+/* LPTIM */
+typedef struct {
+  volatile uint32_t ISR;
+  volatile uint32_t ICR;
+  volatile uint32_t IER;
+  volatile uint32_t CR;
+  volatile uint32_t CMP;
+  volatile uint32_t ARR;
+  volatile uint32_t CNT;
+} LPTIM_TypeDef;
+
+extern LPTIM_TypeDef fakeHal_lptim1;
+#define LPTIM1 (&fakeHal_lptim1)
+
+#define LPTIM_ISR_CMPM (1UL << 0)
+#define LPTIM_ISR_CMPOK (1UL << 3)
+#define LPTIM_ISR_ARROK (1UL << 4)
+#define LPTIM_ICR_CMPMCF (1UL << 0)
+#define LPTIM_ICR_ARRMCF (1UL << 1)
+#define LPTIM_ICR_CMPOKCF (1UL << 3)
+#define LPTIM_ICR_ARROKCF (1UL << 4)
+#define LPTIM_IER_CMPMIE (1UL << 0)
+#define LPTIM_CR_ENABLE (1UL << 0)
+#define LPTIM_CR_SNGSTRT (1UL << 1)
+
+/* PWR */
+#define PWR_STOPENTRY_WFI 0x01U
+
+void HAL_PWREx_EnterSTOP2Mode(uint8_t STOPEntry);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __STM32L4xx_HAL_H */
@@ -0,0 +1,30 @@
+/*
+ * task.h (host)
+ *
+ * The kernel calls of the tickless idle.  The RTOS tick count is simulated
+ * time, like the HAL tick, so stepping it does nothing, and a sleep is
+ * never aborted since there is only one thread.
+ */
+
+#ifndef __TASK_H
+#define __TASK_H
+
+#ifdef __cplusplus
+  extern "C" {
+#endif
+
+#include "FreeRTOS.h"
+
+typedef enum {
+  eAbortSleep = 0,
+  eStandardSleep
+} eSleepModeStatus;
+
+eSleepModeStatus eTaskConfirmSleepModeStatus(void);
+void vTaskStepTick(TickType_t xTicksToJump);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif /* __TASK_H */
@@ -0,0 +1,135 @@
+/*
+ * Checks the error bounds stated in Core/Inc/fastMath.h against libm in
+ * double precision.  Prints the worst error of every function and exits
+ * with 1 if one is over its bound.
+ *
+ *   g++ -O2 -ICore/Inc -o fastmath_accuracy Tools/fastmath_accuracy.cpp
+ *   ./fastmath_accuracy
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "fastMath.h"
+
+#define STEPS 2000000
+
+static int failures;
+
+static void report(const char *name, double worst, double at, double bound) {
+  bool ok = worst <= bound;
+  printf("%-14s max error %.3g at %.6g (bound %.3g)%s\n", name, worst, at, bound, ok ? "" : "  FAIL");
+  failures += !ok;
+}
+
+//Worst absolute error of f against ref over [low, high].
+static void sweep(const char *name, float (*f)(float), double (*ref)(double),
+                  double low, double high, double bound) {
+  double worst = 0, at = low;
+  for (int i = 0; i <= STEPS; i++) {
+    float x = (float)(low + (high - low) * i / STEPS);
+    double err = fabs((double)f(x) - ref((double)x));
+    if (err > worst) {
+      worst = err;
+      at = x;
+    }
+  }
+  report(name, worst, at, bound);
+}
+
+static void checkAtan2() {
+  double worst = 0, at = 0;
+  for (int i = 0; i <= STEPS; i++) {
+    double angle = -M_PI + 2 * M_PI * i / STEPS;
+    double radius = 1e-3 + 1e3 * (i % 977) / 977.0;
+    float y = (float)(radius * sin(angle)), x = (float)(radius * cos(angle));
+    double err = fabs(fast_atan2f(y, x) - atan2((double)y, (double)x));
+    err = fmin(err, 2 * M_PI - err);   //-pi and pi are the same angle
+    if (err > worst) {
+      worst = err;
+      at = angle;
+    }
+  }
+  report("fast_atan2f", worst, at, FAST_ATAN2_MAX_ERR);
+}
+
+static void checkInvSqrt() {
+  double worst = 0, at = 0;
+  for (int i = 0; i <= STEPS; i++) {
+    float x = (float)pow(10.0, -6 + 12.0 * i / STEPS);
+    double exact = 1 / sqrt((double)x);
+    double err = fabs(fast_invSqrtf(x) - exact) / exact;
+    if (err > worst) {
+      worst = err;
+      at = x;
+    }
+  }
+  report("fast_invSqrtf", worst, at, FAST_INV_SQRT_MAX_REL_ERR);
+}
+
+//Result in range and congruent to the input mod 360.
+static void checkWrap(const char *name, float (*wrap)(float), double low) {
+  double worst = 0, at = 0;
+  for (int i = 0; i <= STEPS; i++) {
+    float x = (float)(-1e4 + 2e4 * i / STEPS);
+    float w = wrap(x);
+    double err = fabs(remainder((double)w - x, 360.0));
+    if (w < low || w >= low + 360) {
+      err = 360;
+    }
+    if (err > worst) {
+      worst = err;
+      at = x;
+    }
+  }
+  report(name, worst, at, 1e-3);
+}
+
+//Away from the pitch singularity, where yaw and roll are ill-conditioned.
+static void checkQuatToEuler() {
+  double worst = 0, at = 0;
+  unsigned seed = 1;
+  for (int i = 0; i < STEPS / 10; i++) {
+    double q[4], norm = 0;
+    for (int c = 0; c < 4; c++) {
+      seed = seed * 1664525u + 1013904223u;
+      q[c] = (seed >> 8) / (double)(1u << 23) - 1;
+      norm += q[c] * q[c];
+    }
+    float qf[4], euler[3];
+    for (int c = 0; c < 4; c++) {
+      q[c] /= sqrt(norm);
+      qf[c] = (float)q[c];
+    }
+    double sinp = 2 * (q[0] * q[2] - q[3] * q[1]);
+    if (fabs(sinp) > 0.999) {
+      continue;
+    }
+    double ref[3] = {
+      atan2(2 * (q[0] * q[3] + q[1] * q[2]), 1 - 2 * (q[2] * q[2] + q[3] * q[3])),
+      asin(sinp),
+      atan2(2 * (q[0] * q[1] + q[2] * q[3]), 1 - 2 * (q[1] * q[1] + q[2] * q[2])),
+    };
+    fast_quatToEuler(qf, euler);
+    for (int c = 0; c < 3; c++) {
+      double err = fabs(remainder(euler[c] - ref[c] * 180 / M_PI, 360.0));
+      if (err > worst) {
+        worst = err;
+        at = i;
+      }
+    }
+  }
+  //float rounding of the arguments adds to the asin error near +-90 degrees
+  report("quatToEuler", worst, at, 10 * FAST_ASIN_MAX_ERR * FAST_RAD_TO_DEG);
+}
+
+int main() {
+  checkAtan2();
+  sweep("fast_asinf", fast_asinf, ::asin, -1, 1, FAST_ASIN_MAX_ERR);
+  sweep("fast_sinf", fast_sinf, ::sin, -4 * M_PI, 4 * M_PI, FAST_SIN_MAX_ERR);
+  sweep("fast_cosf", fast_cosf, ::cos, -4 * M_PI, 4 * M_PI, FAST_SIN_MAX_ERR);
+  checkInvSqrt();
+  checkWrap("fast_wrap180", fast_wrap180, -180);
+  checkWrap("fast_wrap360", fast_wrap360, 0);
+  checkQuatToEuler();
+  return failures ? 1 : 0;
+}
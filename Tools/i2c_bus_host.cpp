@@ -0,0 +1,115 @@
+/*
+ * Runs the I2C transport on a host against the fake bus in Tools/fakeHal
+ * and checks the framing of every kind of transfer, the bus time model
+ * behind i2cbus_stats_t.busBits against the SCL periods the bus actually
+ * saw, and the time a transfer takes at 100 kHz.  Exits with 1 if a check
+ * fails.
+ *
+ *   g++ -O2 -ITools/fakeHal -ICore/Inc -o i2c_bus_host Tools/i2c_bus_host.cpp \
+ *       Tools/fakeHal/fakeHal.cpp -x c Core/Src/i2cBus.c
+ *   ./i2c_bus_host
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "fakeHal.h"
+#include "hostCheck.h"
+#include "i2cBus.h"
+
+#define DEV 0x28
+#define BIT_US (1000000 / I2CBUS_BUS_HZ)
+#define CPU_SLACK_US 1      //the DWT reads of the code under test
+
+static I2C_HandleTypeDef hi2c = { I2C1, { 0, 0, 0 }, 0 };
+
+static void checkLog(const char *step, const char *expected) {
+  bool ok = strcmp(fakeHal_i2cLog(), expected) == 0;
+  check(step, ok);
+  if (!ok) {
+    printf("  bus:      %s\n  expected: %s\n", fakeHal_i2cLog(), expected);
+  }
+}
+
+//Checks a transfer's modelled bits against the bus and its duration against the bits.
+static void checkTiming(uint32_t modelBefore, uint32_t startUs, uint32_t latencyUs) {
+  i2cbus_stats_t stats;
+  i2cbus_getStats(&stats);
+  uint32_t model = stats.busBits - modelBefore;
+  uint32_t expectedUs = fakeHal_i2cBits() * BIT_US + latencyUs;
+  uint32_t us = fakeHal_us() - startUs;
+  char line[96];
+
+  snprintf(line, sizeof(line), "  %u bits modelled, %u on the bus", (unsigned)model,
+           (unsigned)fakeHal_i2cBits());
+  check(line, model == fakeHal_i2cBits());
+  snprintf(line, sizeof(line), "  takes %u us for %u us of bus time", (unsigned)us, (unsigned)expectedUs);
+  check(line, us >= expectedUs && us <= expectedUs + CPU_SLACK_US);
+}
+
+int main() {
+  i2cbus_stats_t stats;
+  uint8_t data[22];
+
+  fakeHal_reset(80000000);
+  fake_i2c_device_t *dev = fakeHal_i2cAddDevice(DEV, 0);
+  for (int reg = 0; reg < 256; reg++) {
+    dev->regs[reg] = (uint8_t)reg;
+  }
+  i2cbus_init(&hi2c);
+
+  //a register read is one transaction with a repeated START
+  fakeHal_i2cClearLog();
+  i2cbus_getStats(&stats);
+  uint32_t start = fakeHal_us();
+  check("read of 6 bytes", i2cbus_writeRead(DEV, 0x1A, data, 6) == I2CBUS_OK);
+  checkLog("  is START, address+W, register, Sr, address+R, data, STOP",
+           "S W28 1A Sr R28 <1A <1B <1C <1D <1E <1F P");
+  check("  returns the registers", data[0] == 0x1A && data[5] == 0x1F);
+  checkTiming(stats.busBits, start, 0);
+  check("  model matches i2cbus_writeReadBits()", i2cbus_writeReadBits(6) == 1 + 9 + 9 + 1 + 9 + 6 * 9 + 1);
+
+  //a write is START, address+W, data, STOP
+  fakeHal_i2cClearLog();
+  i2cbus_getStats(&stats);
+  start = fakeHal_us();
+  const uint8_t mode[2] = { 0x3D, 0x0C };
+  check("write of 2 bytes", i2cbus_write(DEV, mode, 2) == I2CBUS_OK);
+  checkLog("  is START, address+W, data, STOP", "S W28 3D 0C P");
+  check("  sets the register", dev->regs[0x3D] == 0x0C);
+  checkTiming(stats.busBits, start, 0);
+
+  //the 22-byte burst the IMU task reads every cycle
+  for (int reg = 0; reg < 256; reg++) {
+    dev->regs[reg] = (uint8_t)reg;
+  }
+  fakeHal_i2cClearLog();
+  i2cbus_getStats(&stats);
+  start = fakeHal_us();
+  check("read of 22 bytes", i2cbus_writeRead(DEV, 0x08, data, 22) == I2CBUS_OK);
+  checkTiming(stats.busBits, start, 0);
+  check("  fits I2CBUS_TIMEOUT_MS", fakeHal_us() - start < I2CBUS_TIMEOUT_MS * 1000U);
+
+  //clock stretching adds to the bus time but not to the model
+  dev->latencyUs = 150;
+  fakeHal_i2cClearLog();
+  i2cbus_getStats(&stats);
+  start = fakeHal_us();
+  check("read from a device stretching the clock 150 us", i2cbus_writeRead(DEV, 0x1A, data, 6) == I2CBUS_OK);
+  checkTiming(stats.busBits, start, 150);
+  dev->latencyUs = 0;
+
+  //a missing device NACKs its address; each retry is a new transaction, without a recovery
+  i2cbus_newCycle();
+  fakeHal_i2cClearLog();
+  i2cbus_getStats(&stats);
+  uint32_t reinits = stats.reinits;
+  check("read from a missing device", i2cbus_writeRead(0x29, 0x00, data, 6) == I2CBUS_NACK);
+  checkLog("  is retried up to the budget after a STOP each",
+           "S W29! P S W29! P S W29! P");
+  i2cbus_getStats(&stats);
+  check("  without recovering the bus", stats.reinits == reinits);
+  check("  and fails the cycle", !i2cbus_cycleOk());
+  check("  after which transfers are skipped", i2cbus_writeRead(DEV, 0x00, data, 1) == I2CBUS_SKIPPED);
+
+  return failures ? 1 : 0;
+}
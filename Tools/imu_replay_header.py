@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+"""Turn a flight recorder CSV into an IMU replay table.
+
+Reads the CSV written by blackbox_decode.py and writes a C header with an
+imu_replay_sample_t table for ReplayImu (build with IMU_BACKEND set to
+IMU_BACKEND_REPLAY).  The recorded feedback angles are turned back into
+the raw BNO055 Euler angles the IMU task would have read.
+
+  imu_replay_header.py record.csv > Core/Inc/imuReplayData.h
+"""
+
+import csv
+import sys
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+
+    with open(sys.argv[1], newline="") as f:
+        rows = list(csv.DictReader(f))
+    if not rows:
+        sys.exit("no samples")
+
+    out = sys.stdout
+    out.write("/* Generated by Tools/imu_replay_header.py from %s */\n" % sys.argv[1])
+    out.write("#ifndef INC_IMUREPLAYDATA_H_\n#define INC_IMUREPLAYDATA_H_\n\n")
+    out.write('#include "imuSource.h"\n\n')
+    out.write("static const imu_replay_sample_t imuReplaySamples[] = {\n")
+
+    # the recorder keeps the low 16 bits of the tick
+    prev = int(rows[0]["tick"])
+    elapsed = 0
+    for row in rows:
+        tick = int(row["tick"])
+        elapsed += (tick - prev) & 0xFFFF
+        prev = tick
+        # getYaw() unwraps the heading, getPitch() is -z, getRoll() is -y
+        x = float(row["angle_yaw"]) % 360.0
+        y = -float(row["angle_roll"])
+        z = -float(row["angle_pitch"])
+        out.write("  { %u, %.2ff, %.2ff, %.2ff },\n" % (elapsed, x, y, z))
+
+    out.write("};\n\n#endif /* INC_IMUREPLAYDATA_H_ */\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,126 @@
+/*
+ * Runs the tickless idle and the button debouncer on a host against the
+ * fake HAL in Tools/fakeHal, at CLOCK_LOW with STOP2 allowed as in OFF, and
+ * checks that a press of the on/off button that wakes the chip from STOP2
+ * is debounced, that its release is seen before STOP2 is entered again,
+ * and that a glitch on the pin does not keep the chip out of STOP2.  The
+ * runner stands in for the interrupts: it samples the debouncer for every
+ * HAL tick the chip was not stopped and handles a pending EXTI4.  Exits
+ * with 1 if a check fails.
+ *
+ *   g++ -O2 -DRAMFUNC_ENABLED=0 -ITools/fakeHal -ICore/Inc -o low_power_host \
+ *       Tools/low_power_host.cpp Tools/fakeHal/fakeHal.cpp -x c Core/Src/lowPower.c \
+ *       -x c Core/Src/debouncer.c -x c Core/Src/inputEvents.c
+ *   ./low_power_host
+ */
+
+#include <stdio.h>
+#include "clockGovernor.h"
+#include "debouncer.h"
+#include "eventHandler.h"
+#include "fakeHal.h"
+#include "hostCheck.h"
+#include "inputEvents.h"
+#include "lowPower.h"
+#include "main.h"
+#include "task.h"
+
+#define CORE_HZ 4000000     //CLOCK_LOW, MSI 4 MHz
+#define NEVER UINT32_MAX
+
+extern "C" void vPortSuppressTicksAndSleep(TickType_t xExpectedIdleTime);
+
+osEventFlagsId_t setPointButtonEvents;
+
+//What the idle task's neighbours report in OFF.
+extern "C" uint8_t clock_profile(void) { return CLOCK_LOW; }
+extern "C" bool tuning_sessionActive(void) { return false; }
+extern "C" void analogMonitor_suspend(void) { }
+extern "C" void analogMonitor_resume(void) { }
+
+typedef struct {
+  uint32_t pressMs;
+  uint32_t releaseMs;
+  uint32_t lastStopMs;    //when STOP2 was last entered
+} idle_log_t;
+
+/*
+ * Lets the idle task run with every other task blocked until a given tick,
+ * and logs the on/off button's events and the STOP2 entries.
+ */
+static void idleUntil(uint32_t untilMs, idle_log_t *log) {
+  lowpower_stats_t before, after;
+  input_event_t ev;
+
+  while (HAL_GetTick() < untilMs) {
+    uint32_t from = HAL_GetTick();
+    lowPower_getStats(&before);
+    vPortSuppressTicksAndSleep(LOWPOWER_MAX_STOP_TICKS);
+    lowPower_getStats(&after);
+    if (fakeHal_extiTake() & EXTI_PR1_PIF4) {
+      lowPower_extiIrq();
+    }
+    if (after.stopEntries != before.stopEntries) {
+      log->lastStopMs = from;
+    }
+    else {
+      for (uint32_t tick = from; tick < HAL_GetTick(); tick++) {
+        debouncer_sample();   //TIM6 update
+      }
+    }
+    while (inputEvents_pop(&ev)) {
+      if (ev.button == BUTTON_MODE && ev.edge == EDGE_PRESS) {
+        log->pressMs = HAL_GetTick();
+      }
+      else if (ev.button == BUTTON_MODE && ev.edge == EDGE_RELEASE) {
+        log->releaseMs = HAL_GetTick();
+      }
+    }
+  }
+}
+
+int main() {
+  GPIO_InitTypeDef buttons = { on_off_mode_Pin, GPIO_MODE_INPUT, GPIO_PULLUP, 0, 0 };
+  idle_log_t log = { NEVER, NEVER, NEVER };
+  lowpower_stats_t stats;
+  char line[96];
+
+  fakeHal_reset(CORE_HZ);
+  HAL_GPIO_Init(on_off_mode_GPIO_Port, &buttons);
+  inputEvents_init();
+  lowPower_init();
+  debouncer_init();
+  lowPower_allowStop(true);
+
+  printf("press held 150 ms while stopped\n");
+  fakeHal_gpioScript(on_off_mode_GPIO_Port, on_off_mode_Pin, 1000300, true);
+  fakeHal_gpioScript(on_off_mode_GPIO_Port, on_off_mode_Pin, 1150300, false);
+  idleUntil(1000, &log);
+  check("  stopped before the press", log.lastStopMs != NEVER);
+  idleUntil(3000, &log);
+  lowPower_getStats(&stats);
+  check("  the press wakes the chip", stats.buttonWakes == 1);
+  snprintf(line, sizeof(line), "  press debounced %d ms after the wake (at most %d)",
+           log.pressMs == NEVER ? -1 : (int)(log.pressMs - 1000), LOWPOWER_BUTTON_WAKE_MS);
+  check(line, log.pressMs != NEVER && log.pressMs - 1000 <= LOWPOWER_BUTTON_WAKE_MS);
+  snprintf(line, sizeof(line), "  release debounced %d ms after it (at most %d)",
+           log.releaseMs == NEVER ? -1 : (int)(log.releaseMs - 1150), LOWPOWER_BUTTON_WAKE_MS);
+  check(line, log.releaseMs != NEVER && log.releaseMs - 1150 <= LOWPOWER_BUTTON_WAKE_MS);
+  check("  stopped again after the release",
+        log.lastStopMs != NEVER && log.releaseMs != NEVER && log.lastStopMs >= log.releaseMs);
+
+  printf("1 ms glitch while stopped\n");
+  log = { NEVER, NEVER, NEVER };
+  fakeHal_gpioScript(on_off_mode_GPIO_Port, on_off_mode_Pin, 4000300, true);
+  fakeHal_gpioScript(on_off_mode_GPIO_Port, on_off_mode_Pin, 4001300, false);
+  idleUntil(4001, &log);
+  idleUntil(4000 + LOWPOWER_BUTTON_WAKE_MS + 2, &log);
+  lowPower_getStats(&stats);
+  check("  the glitch wakes the chip", stats.buttonWakes == 2);
+  check("  no press", log.pressMs == NEVER && log.releaseMs == NEVER);
+  snprintf(line, sizeof(line), "  stopped again %d ms after the wake (at most %d)",
+           log.lastStopMs == NEVER ? -1 : (int)(log.lastStopMs - 4000), LOWPOWER_BUTTON_WAKE_MS + 1);
+  check(line, log.lastStopMs != NEVER && log.lastStopMs - 4000 <= LOWPOWER_BUTTON_WAKE_MS + 1);
+
+  return failures ? 1 : 0;
+}
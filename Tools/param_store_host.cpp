@@ -0,0 +1,234 @@
+/*
+ * Runs the parameter store and the gimbal parameter checks on a host,
+ * against a file-backed image of the PARAMS flash region (see
+ * Tools/fakeHal/fakeHal.h), and checks what survives a reset: defaults on a
+ * blank part, values across re-inits, page rotation, power lost at every
+ * step of a compaction, corrupted records and out-of-range values.  A
+ * reset is a new params_init() on the same image.  Exits with 1 if a check
+ * fails.
+ *
+ *   g++ -O2 -no-pie -Wl,--defsym,_sparams=0x0803F000 -ITools/fakeHal -ICore/Inc \
+ *       -o param_store_host Tools/param_store_host.cpp Tools/fakeHal/fakeHal.cpp \
+ *       -x c Core/Src/paramStore.c -x c Core/Src/gimbalParams.c
+ *   ./param_store_host [image]
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "fakeHal.h"
+#include "gimbalParams.h"
+#include "hostCheck.h"
+#include "paramStore.h"
+
+#define PAGE_SLOTS (FLASH_PAGE_SIZE / 8)
+
+static const char *imagePath = "param_store_host.img";
+static uint32_t defaults[PARAM_COUNT];
+
+static uint32_t floatBits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static void reset() {
+  fakeHal_flashFailAfter(-1);
+  params_init(defaults, PARAM_COUNT);
+}
+
+static bool matchesDefaults() {
+  for (uint8_t key = 0; key < PARAM_COUNT; key++) {
+    if (params_get(key) != defaults[key]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//The image is read through a second descriptor, like a programmer would.
+static std::vector<uint8_t> snapshot() {
+  std::vector<uint8_t> image(FAKE_PARAMS_SIZE);
+  int fd = open(imagePath, O_RDONLY);
+  ssize_t n = pread(fd, image.data(), image.size(), 0);
+  close(fd);
+  return n == (ssize_t)image.size() ? image : std::vector<uint8_t>();
+}
+
+static void restore(const std::vector<uint8_t> &image) {
+  int fd = open(imagePath, O_WRONLY);
+  if (pwrite(fd, image.data(), image.size(), 0) != (ssize_t)image.size()) {
+    failures++;
+  }
+  close(fd);
+}
+
+//The page with a header and the newest sequence number, as params_init() picks it.
+static uint32_t activePage() {
+  std::vector<uint8_t> image = snapshot();
+  uint32_t magic[2], seq[2];
+  for (uint32_t page = 0; page < 2; page++) {
+    memcpy(&magic[page], &image[page * FLASH_PAGE_SIZE], 4);
+    memcpy(&seq[page], &image[page * FLASH_PAGE_SIZE + 4], 4);
+  }
+  if (magic[0] != magic[1]) {
+    return magic[1] == 0x4D524150 ? 1 : 0;
+  }
+  return (int32_t)(seq[1] - seq[0]) > 0 ? 1 : 0;
+}
+
+static void flipBit(uint32_t offset, uint8_t mask) {
+  std::vector<uint8_t> image = snapshot();
+  image[offset] ^= mask;
+  restore(image);
+}
+
+int main(int argc, char **argv) {
+  param_store_stats_t stats;
+  fake_flash_stats_t flash, before;
+
+  if (argc > 1) {
+    imagePath = argv[1];
+  }
+  for (uint8_t key = PARAM_KP_YAW; key <= PARAM_KD_ROLL; key++) {
+    defaults[key] = floatBits(1.0f + key);
+  }
+  defaults[PARAM_PWM_LOW] = 6500;
+  defaults[PARAM_PWM_HIGH] = 20315;
+  defaults[PARAM_PWM_LOW_YAW] = 8000;
+  defaults[PARAM_PWM_HIGH_YAW] = 18000;
+  defaults[PARAM_CONTROL_PERIOD] = 3;
+  defaults[PARAM_IMU_PERIOD] = 3;
+  defaults[PARAM_CINEMATIC_PERIOD] = 10;
+  defaults[PARAM_CINEMATIC_PITCH] = (uint32_t)-1500;
+  defaults[PARAM_CINEMATIC_ROLL] = 1300;
+
+  fakeHal_reset(80000000);
+  if (!fakeHal_flashOpen(imagePath, true)) {
+    printf("cannot map %s at 0x%08lX\n", imagePath, FAKE_PARAMS_BASE);
+    return 1;
+  }
+
+  //a blank part
+  reset();
+  params_getStats(&stats);
+  check("blank image loads the defaults", matchesDefaults() && stats.records == 0);
+  check("the defaults are in range", gimbalParams_sanitize(defaults) == 0 && matchesDefaults());
+
+  //the first write starts a page: one erase, the record and the header
+  uint32_t start = fakeHal_us();
+  check("first write", params_set(PARAM_CONTROL_PERIOD, 5));
+  fakeHal_flashGetStats(&flash);
+  check("  starts a page with one erase and two programs", flash.erases == 1 && flash.programs == 2);
+  check("  takes an erase and two programs",
+        fakeHal_us() - start >= FAKE_FLASH_ERASE_US + 2 * FAKE_FLASH_PROGRAM_US);
+  start = fakeHal_us();
+  check("second write", params_set(PARAM_IMU_PERIOD, 4));
+  check("  appends one record without an erase", fakeHal_us() - start < 2 * FAKE_FLASH_PROGRAM_US);
+  reset();
+  check("writes survive a reset", params_get(PARAM_CONTROL_PERIOD) == 5 && params_get(PARAM_IMU_PERIOD) == 4);
+
+  //a value that is already stored costs no write
+  fakeHal_flashGetStats(&before);
+  check("rewriting the stored value", params_set(PARAM_CONTROL_PERIOD, 5));
+  fakeHal_flashGetStats(&flash);
+  check("  does not program flash", flash.programs == before.programs);
+
+  //a staged value is lost at reset unless committed
+  params_stage(PARAM_CINEMATIC_PERIOD, 20);
+  reset();
+  check("a staged value reverts at reset", params_get(PARAM_CINEMATIC_PERIOD) == 10);
+  params_stage(PARAM_CINEMATIC_PERIOD, 20);
+  check("committing a staged value", params_commit());
+  reset();
+  check("  makes it survive a reset", params_get(PARAM_CINEMATIC_PERIOD) == 20);
+
+  //filling the page compacts into the other one, and then back
+  uint32_t value = 100;
+  fakeHal_flashGetStats(&before);
+  for (uint32_t i = 0; i < 2 * PAGE_SLOTS; i++) {
+    params_set(PARAM_CINEMATIC_PERIOD, ++value);
+  }
+  params_getStats(&stats);
+  fakeHal_flashGetStats(&flash);
+  check("two pages of writes compact twice", stats.compactions == 2 && stats.writeErrors == 0);
+  check("  and erase each page twice", flash.erases - before.erases == 4);
+  reset();
+  check("  keep every value across a reset",
+        params_get(PARAM_CINEMATIC_PERIOD) == value && params_get(PARAM_CONTROL_PERIOD) == 5 &&
+        params_get(PARAM_IMU_PERIOD) == 4);
+
+  //fill the page to the last slot, then lose the power at every step of the compaction
+  params_getStats(&stats);
+  for (uint32_t i = stats.records + 1; i < PAGE_SLOTS; i++) {
+    params_set(PARAM_CINEMATIC_PERIOD, ++value);
+  }
+  std::vector<uint8_t> full = snapshot();
+  bool survived = true, recovered = true;
+  uint32_t operations;
+  for (int32_t steps = 0;; steps++) {
+    restore(full);
+    reset();
+    fakeHal_flashFailAfter(steps);
+    fakeHal_flashGetStats(&before);
+    bool done = params_set(PARAM_PWM_LOW, 6000);
+    fakeHal_flashGetStats(&flash);
+    operations = flash.programs + flash.erases - before.programs - before.erases;
+    reset();
+    survived &= params_get(PARAM_CINEMATIC_PERIOD) == value && params_get(PARAM_CONTROL_PERIOD) == 5 &&
+                params_get(PARAM_IMU_PERIOD) == 4;
+    survived &= params_get(PARAM_PWM_LOW) == (done ? 6000U : defaults[PARAM_PWM_LOW]);
+    recovered &= params_set(PARAM_PWM_LOW, 6100);
+    reset();
+    recovered &= params_get(PARAM_PWM_LOW) == 6100;
+    if (operations < (uint32_t)steps) {
+      break;    //the power lasted the whole compaction
+    }
+  }
+  printf("compaction of a full page takes %u flash operations\n", (unsigned)operations);
+  check("power lost during compaction keeps the old or new values", survived);
+  check("  and the next write after it succeeds", recovered);
+
+  //a corrupted record is skipped and the one before it used again
+  params_set(PARAM_CONTROL_PERIOD, 6);
+  params_set(PARAM_CONTROL_PERIOD, 7);
+  params_getStats(&stats);
+  flipBit(activePage() * FLASH_PAGE_SIZE + stats.records * 8 + 4, 0x01);
+  reset();
+  params_getStats(&stats);
+  check("a corrupted record counts as bad", stats.badRecords == 1);
+  check("  and the value before it is used", params_get(PARAM_CONTROL_PERIOD) == 6);
+
+  //stored values out of range fall back to the defaults
+  params_setFloat(PARAM_KP_PITCH, NAN);
+  params_setFloat(PARAM_KD_ROLL, -1.0f);
+  params_setFloat(PARAM_KI_YAW, 0.02f);
+  params_set(PARAM_IMU_PERIOD, 0);
+  params_set(PARAM_CINEMATIC_PITCH, (uint32_t)-9000);
+  params_set(PARAM_PWM_LOW_YAW, 19000);
+  params_set(PARAM_PWM_HIGH, 30000);
+  reset();
+  uint8_t replaced = gimbalParams_sanitize(defaults);
+  check("out-of-range values are replaced", replaced == 7);
+  check("  by their defaults",
+        params_get(PARAM_KP_PITCH) == defaults[PARAM_KP_PITCH] &&
+        params_get(PARAM_KD_ROLL) == defaults[PARAM_KD_ROLL] &&
+        params_get(PARAM_IMU_PERIOD) == defaults[PARAM_IMU_PERIOD] &&
+        params_get(PARAM_CINEMATIC_PITCH) == defaults[PARAM_CINEMATIC_PITCH] &&
+        params_get(PARAM_PWM_HIGH) == defaults[PARAM_PWM_HIGH]);
+  check("  and an inverted range by both defaults",
+        params_get(PARAM_PWM_LOW_YAW) == defaults[PARAM_PWM_LOW_YAW] &&
+        params_get(PARAM_PWM_HIGH_YAW) == defaults[PARAM_PWM_HIGH_YAW]);
+  check("  leaving valid values alone",
+        params_getFloat(PARAM_KI_YAW) == 0.02f && params_get(PARAM_CONTROL_PERIOD) == 6);
+  fakeHal_flashGetStats(&before);
+  gimbalParams_sanitize(defaults);
+  fakeHal_flashGetStats(&flash);
+  check("  without writing flash", flash.programs == before.programs && flash.erases == before.erases);
+
+  fakeHal_flashClose();
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Drives the gimbal transition table through the state machine engine on a
+ * host and checks the resulting states and the order of the entry, exit,
+ * guard and transition actions.  The actions are stubs that append their
+ * name to a log.  Exits with 1 if a check fails.
+ *
+ *   g++ -O2 -ITools/fakeHal -ICore/Inc -o state_machine_host Tools/state_machine_host.cpp \
+ *       -x c Core/Src/stateMachine.c -x c Core/Src/gimbalStates.c
+ *   ./state_machine_host
+ */
+
+#include <stdio.h>
+#include <string>
+#include "gimbalStates.h"
+#include "hostCheck.h"
+
+static const char *stateNames[GIMBAL_NUM_STATES] = {
+  "OFF", "ACTIVE", "BOOTING", "STABILIZE", "CINEMATIC", "FAULT"
+};
+static const char *eventNames[EV_NUM_EVENTS] = {
+  "MODE_BUTTON", "LOW_BATTERY", "IMU_FAULT", "CALIBRATION_DONE", "DEADLINE_MISS"
+};
+
+static std::string actions;
+static bool modeChangeOk = true;
+static sm_machine_t sm;
+
+static void log(const char *action) {
+  actions += actions.empty() ? "" : " ";
+  actions += action;
+}
+
+void enterOFF() { log("enterOFF"); }
+void enterACTIVE() { log("enterACTIVE"); }
+void exitACTIVE() { log("exitACTIVE"); }
+void enterBOOTING() { log("enterBOOTING"); }
+void exitBOOTING() { log("exitBOOTING"); }
+void enterSTABILIZE() { log("enterSTABILIZE"); }
+void exitSTABILIZE() { log("exitSTABILIZE"); }
+void enterCINEMATIC() { log("enterCINEMATIC"); }
+void exitCINEMATIC() { log("exitCINEMATIC"); }
+void enterFAULT() { log("enterFAULT"); }
+bool modeChangeAllowed() { log("modeChangeAllowed"); return modeChangeOk; }
+void markModeChange() { log("markModeChange"); }
+
+//Checks that the machine is in state and ran exactly the actions expected.
+static void expect(const char *step, int8_t state, bool handled, bool expectHandled, const char *expected) {
+  bool ok = sm.current == state && handled == expectHandled && actions == expected;
+  char line[128];
+
+  snprintf(line, sizeof(line), "%-32s %s", step, stateNames[sm.current]);
+  check(line, ok);
+  if (!actions.empty()) {
+    printf("  %s\n", actions.c_str());
+  }
+  if (!ok) {
+    printf("  expected %s, %s: %s\n", stateNames[state], expectHandled ? "handled" : "ignored", expected);
+  }
+  actions.clear();
+}
+
+static void send(uint8_t event, int8_t state, bool expectHandled, const char *expected) {
+  char step[64];
+  snprintf(step, sizeof(step), "%s in %s", eventNames[event], stateNames[sm.current]);
+  bool handled = sm_dispatch(&sm, event);
+  expect(step, state, handled, expectHandled, expected);
+}
+
+static void start(int8_t state, const char *expected) {
+  actions.clear();
+  sm_init(&sm, gimbalStates, &gimbalTransitions[0][0], GIMBAL_NUM_STATES, EV_NUM_EVENTS, state);
+  expect("init", state, true, true, expected);
+}
+
+int main() {
+  //the mode button cycle, through the parent ACTIVE state
+  start(GIMBAL_OFF, "enterOFF");
+  send(EV_MODE_BUTTON, GIMBAL_BOOTING, true, "modeChangeAllowed markModeChange enterACTIVE enterBOOTING");
+  send(EV_CALIBRATION_DONE, GIMBAL_STABILIZE, true, "exitBOOTING enterSTABILIZE");
+  send(EV_CALIBRATION_DONE, GIMBAL_STABILIZE, false, "");
+  send(EV_MODE_BUTTON, GIMBAL_CINEMATIC, true, "modeChangeAllowed exitSTABILIZE markModeChange enterCINEMATIC");
+  send(EV_MODE_BUTTON, GIMBAL_OFF, true, "modeChangeAllowed exitCINEMATIC exitACTIVE markModeChange enterOFF");
+
+  //the guard holds off a press that comes too soon
+  modeChangeOk = false;
+  send(EV_MODE_BUTTON, GIMBAL_OFF, false, "modeChangeAllowed");
+  modeChangeOk = true;
+
+  //events only the ACTIVE parent handles are ignored outside it
+  send(EV_LOW_BATTERY, GIMBAL_OFF, false, "");
+  send(EV_IMU_FAULT, GIMBAL_OFF, false, "");
+  send(EV_DEADLINE_MISS, GIMBAL_OFF, false, "");
+
+  //and reach every sub-state through the parent's row
+  start(GIMBAL_BOOTING, "enterACTIVE enterBOOTING");
+  send(EV_MODE_BUTTON, GIMBAL_CINEMATIC, true, "modeChangeAllowed exitBOOTING markModeChange enterCINEMATIC");
+  send(EV_LOW_BATTERY, GIMBAL_OFF, true, "exitCINEMATIC exitACTIVE enterOFF");
+  start(GIMBAL_STABILIZE, "enterACTIVE enterSTABILIZE");
+  send(EV_IMU_FAULT, GIMBAL_FAULT, true, "exitSTABILIZE exitACTIVE enterFAULT");
+  send(EV_IMU_FAULT, GIMBAL_FAULT, false, "");
+  send(EV_LOW_BATTERY, GIMBAL_FAULT, false, "");
+  send(EV_MODE_BUTTON, GIMBAL_OFF, true, "modeChangeAllowed markModeChange enterOFF");
+  start(GIMBAL_BOOTING, "enterACTIVE enterBOOTING");
+  send(EV_DEADLINE_MISS, GIMBAL_FAULT, true, "exitBOOTING exitACTIVE enterFAULT");
+
+  //an event id past the table is rejected
+  bool handled = sm_dispatch(&sm, EV_NUM_EVENTS);
+  expect("event out of range", GIMBAL_FAULT, handled, false, "");
+
+  return failures ? 1 : 0;
+}